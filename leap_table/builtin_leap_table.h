@@ -0,0 +1,33 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LEAP_TABLE_BUILTIN_LEAP_TABLE_H
+#define LEAP_TABLE_BUILTIN_LEAP_TABLE_H
+
+#include "unsmear/unsmear.h"
+
+namespace unsmear {
+
+// Returns the leap table in leap_table.textpb as of when this binary was built.
+// It is compiled into the binary as constant data, so no file needs to be read
+// or parsed, and no memory is allocated.
+//
+// Binaries that run for a long time, or are rebuilt rarely, should prefer to
+// load a current leap table at runtime.  This table expires, and will not know
+// about leap seconds announced after it was built.
+const LeapTable& BuiltinLeapTable();
+
+}  // namespace unsmear
+
+#endif  // LEAP_TABLE_BUILTIN_LEAP_TABLE_H
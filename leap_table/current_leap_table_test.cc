@@ -17,6 +17,8 @@
 #include <fstream>
 
 #include "gtest/gtest.h"
+#include "leap_table/builtin_leap_table.h"
+#include "unsmear/unsmear_proto.h"
 
 namespace unsmear {
 namespace {
@@ -55,11 +57,17 @@ void ExpectPrecise(const LeapTable& lt, absl::Time utc, TaiTime tai,
   EXPECT_EQ(lt.FutureProofSmear(gps), std::make_pair(utc, utc)) << gps;
 }
 
-TEST(CurrentLeapTableTest, CurrentLeapTable) {
+std::unique_ptr<LeapTable> CurrentLeapTable() {
   LeapTableProto pb;
   std::ifstream input("leap_table/leap_table.pb");
-  ASSERT_TRUE(pb.ParseFromIstream(&input));
-  auto lt = NewLeapTableFromProto(pb);
+  if (!pb.ParseFromIstream(&input)) {
+    return nullptr;
+  }
+  return NewLeapTableFromProto(pb);
+}
+
+TEST(CurrentLeapTableTest, CurrentLeapTable) {
+  auto lt = CurrentLeapTable();
   ASSERT_TRUE(lt != nullptr);
 
   // A time not during a leap smear: the start time of Dr. Emmett Brown's first
@@ -80,5 +88,18 @@ TEST(CurrentLeapTableTest, CurrentLeapTable) {
   ExpectPrecise(*lt, utc, tai, gps);
 }
 
+TEST(CurrentLeapTableTest, BuiltinLeapTable) {
+  auto lt = CurrentLeapTable();
+  ASSERT_TRUE(lt != nullptr);
+  EXPECT_EQ(BuiltinLeapTable(), *lt);
+  EXPECT_EQ(BuiltinLeapTable().DebugString(), lt->DebugString());
+
+  // The builtin table can be copied and converts like any other.
+  LeapTable copy = BuiltinLeapTable();
+  EXPECT_EQ(copy, *lt);
+  auto utc = Noon(2016, 12, 31) + absl::Hours(6);
+  ExpectPrecise(copy, utc, *lt->Unsmear(utc), *lt->UnsmearToGps(utc));
+}
+
 }  // namespace
 }  // namespace unsmear
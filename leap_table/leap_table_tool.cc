@@ -12,7 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-// Simple tool to convert the text proto leap_table.pb to other formats.
+// Simple tool to convert the text proto leap_table.pb to other formats,
+// including C++ source defining BuiltinLeapTable(), and the flat binary format
+// read by NewLeapTableFromFlatFile().
+//
+// With --convert, it instead converts a stream of times with the leap table,
+// such as the timestamps of a trace, from smeared UTC to TAI or GPST or the
+// reverse.
 
 #include <fcntl.h>
 #include <string.h>
@@ -20,9 +26,16 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
 #include <cstring>
+#include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "absl/flags/flag.h"
@@ -37,17 +50,40 @@
 #include "google/protobuf/util/json_util.h"
 #include "unsmear/leap_table.pb.h"
 #include "unsmear/unsmear.h"
+#include "unsmear/unsmear_proto.h"
 
 namespace {
 
-constexpr char kUsage[] = "Usage: leap_table_tool FILENAME\n";
+constexpr char kUsage[] =
+    "Usage: leap_table_tool FILENAME\n"
+    "       leap_table_tool --convert=CONVERSION FILENAME [TIMES_FILENAME]\n";
+
+enum class Format { kProto, kTextProto, kJson, kDebug, kCc, kFlat };
+
+enum class Conversion { kNone, kUtcToTai, kUtcToGps, kTaiToUtc, kGpsToUtc };
 
-enum class Format { kProto, kTextProto, kJson, kDebug };
+enum class Times { kText, kInt64, kCsv };
 
 }  // namespace
 
 ABSL_FLAG(Format, input, Format::kTextProto, "input format");
 ABSL_FLAG(Format, output, Format::kProto, "output format");
+ABSL_FLAG(Conversion, convert, Conversion::kNone,
+          "convert times read from TIMES_FILENAME, or from stdin, with the "
+          "leap table in FILENAME, and write them to stdout: utc_to_tai, "
+          "utc_to_gps, tai_to_utc, or gps_to_utc");
+ABSL_FLAG(Times, times, Times::kText,
+          "format of the times to convert: text, one per line; int64, raw "
+          "little-endian nanoseconds since the epoch of the timescale, with "
+          "INT64_MIN output for times that cannot be converted; or csv, a "
+          "column of text times in comma-separated lines without quoting");
+ABSL_FLAG(std::string, time_format, "",
+          "format of text times, as for absl::FormatTime(), with %Z the name "
+          "of the timescale; empty for the default format");
+ABSL_FLAG(int, csv_column, 0, "zero-based column of times in csv lines");
+ABSL_FLAG(bool, csv_header, false, "copy the first csv line unchanged");
+ABSL_FLAG(int, threads, 0,
+          "threads converting times; 0 for the number of processors");
 
 namespace {
 
@@ -68,7 +104,15 @@ bool AbslParseFlag(absl::string_view text, Format* format, std::string* error) {
     *format = Format::kDebug;
     return true;
   }
-  *error = "unknown format; must be proto, textproto, json, or debug";
+  if (text == "cc") {
+    *format = Format::kCc;
+    return true;
+  }
+  if (text == "flat") {
+    *format = Format::kFlat;
+    return true;
+  }
+  *error = "unknown format; must be proto, textproto, json, debug, cc, or flat";
   return false;
 }
 
@@ -82,10 +126,87 @@ std::string AbslUnparseFlag(Format format) {
       return "json";
     case Format::kDebug:
       return "debug";
+    case Format::kCc:
+      return "cc";
+    case Format::kFlat:
+      return "flat";
   }
   return absl::StrCat(format);
 }
 
+bool AbslParseFlag(absl::string_view text, Conversion* conversion,
+                   std::string* error) {
+  if (text == "none") {
+    *conversion = Conversion::kNone;
+    return true;
+  }
+  if (text == "utc_to_tai") {
+    *conversion = Conversion::kUtcToTai;
+    return true;
+  }
+  if (text == "utc_to_gps") {
+    *conversion = Conversion::kUtcToGps;
+    return true;
+  }
+  if (text == "tai_to_utc") {
+    *conversion = Conversion::kTaiToUtc;
+    return true;
+  }
+  if (text == "gps_to_utc") {
+    *conversion = Conversion::kGpsToUtc;
+    return true;
+  }
+  *error =
+      "unknown conversion; must be none, utc_to_tai, utc_to_gps, tai_to_utc, "
+      "or gps_to_utc";
+  return false;
+}
+
+std::string AbslUnparseFlag(Conversion conversion) {
+  switch (conversion) {
+    case Conversion::kNone:
+      return "none";
+    case Conversion::kUtcToTai:
+      return "utc_to_tai";
+    case Conversion::kUtcToGps:
+      return "utc_to_gps";
+    case Conversion::kTaiToUtc:
+      return "tai_to_utc";
+    case Conversion::kGpsToUtc:
+      return "gps_to_utc";
+  }
+  return absl::StrCat(conversion);
+}
+
+bool AbslParseFlag(absl::string_view text, Times* times, std::string* error) {
+  if (text == "text") {
+    *times = Times::kText;
+    return true;
+  }
+  if (text == "int64") {
+    *times = Times::kInt64;
+    return true;
+  }
+  if (text == "csv") {
+    *times = Times::kCsv;
+    return true;
+  }
+  *error = "unknown times format; must be text, int64, or csv";
+  return false;
+}
+
+std::string AbslUnparseFlag(Times times) {
+  switch (times) {
+    case Times::kText:
+      return "text";
+    case Times::kInt64:
+      return "int64";
+    case Times::kCsv:
+      return "csv";
+  }
+  return absl::StrCat(times);
+}
+
 bool OutputProto(const unsmear::LeapTableProto& pb) {
   return pb.SerializeToFileDescriptor(STDOUT_FILENO);
 }
@@ -119,13 +240,387 @@ bool OutputDebug(const unsmear::LeapTableProto& pb) {
   return true;
 }
 
+// Appends the definition of an array holding a day index, which has far too
+// many entries to list one per line.
+void AppendIndex(absl::string_view name, absl::Span<const uint32_t> index,
+                 std::string* s) {
+  absl::StrAppend(s, "\nconstexpr uint32_t ", name, "[] = {");
+  for (size_t i = 0; i < index.size(); ++i) {
+    absl::StrAppend(s, i % 16 == 0 ? "\n   " : "", " ", index[i], ",");
+  }
+  absl::StrAppend(s, "\n};\n");
+}
+
+// Writes C++ source defining unsmear::BuiltinLeapTable(), declared in
+// leap_table/builtin_leap_table.h.  The table is validated here, so the
+// generated code only needs to refer to static arrays.
+bool OutputCc(const unsmear::LeapTableProto& pb) {
+  auto lt = unsmear::NewLeapTableFromProto(pb);
+  if (lt == nullptr) {
+    LOG(ERROR) << "Failed to construct leap table from proto";
+    return false;
+  }
+  const unsmear::internal::LeapTableData data =
+      unsmear::internal::GetLeapTableData(*lt);
+
+  std::string s = R"(// Generated by leap_table_tool --output=cc.  Do not edit.
+
+#include "leap_table/builtin_leap_table.h"
+
+#include <cstdint>
+
+namespace unsmear {
+namespace {
+
+)";
+  absl::StrAppend(&s, "constexpr int64_t kUtcSeconds[] = {\n");
+  for (int64_t t : data.utc_seconds) {
+    absl::StrAppend(&s, "    ", t, ",  // ",
+                    unsmear::FormatTime(absl::FromUnixSeconds(t)), "\n");
+  }
+  absl::StrAppend(&s, "};\n\nconstexpr int64_t kTaiSeconds[] = {\n");
+  for (int64_t t : data.tai_seconds) {
+    absl::StrAppend(
+        &s, "    ", t, ",  // ",
+        unsmear::FormatTime(unsmear::TaiEpoch() + unsmear::Seconds(t)), "\n");
+  }
+  absl::StrAppend(&s, "};\n\nconstexpr int8_t kSmears[] = {\n");
+  for (int smear : data.smears) {
+    absl::StrAppend(&s, "    ", smear, ",\n");
+  }
+  absl::StrAppend(&s, "};\n");
+  AppendIndex("kUtcDayIndex", data.utc_day_index, &s);
+  AppendIndex("kTaiDayIndex", data.tai_day_index, &s);
+  absl::StrAppend(&s, R"(
+}  // namespace
+
+const LeapTable& BuiltinLeapTable() {
+  static const LeapTable lt = internal::LeapTableFromStaticData(
+      {kUtcSeconds, kTaiSeconds, kSmears, kUtcDayIndex, kTaiDayIndex});
+  return lt;
+}
+
+}  // namespace unsmear
+)");
+  std::cout << s;
+  return true;
+}
+
+// Writes the flat binary format, for use with NewLeapTableFromFlatFile().
+bool OutputFlat(const unsmear::LeapTableProto& pb) {
+  auto lt = unsmear::NewLeapTableFromProto(pb);
+  if (lt == nullptr) {
+    LOG(ERROR) << "Failed to construct leap table from proto";
+    return false;
+  }
+  std::string s;
+  lt->ToFlat(&s);
+  std::cout << s;
+  return static_cast<bool>(std::cout.flush());
+}
+
+// Converts times with a leap table, in chunks of input that hold whole
+// records.  It is thread-safe.
+class TimeConverter {
+ public:
+  TimeConverter(const unsmear::LeapTable& lt, Conversion conversion,
+                Times times, const std::string& time_format, int csv_column)
+      : lt_(lt),
+        conversion_(conversion),
+        times_(times),
+        format_(time_format.empty() ? unsmear::TimeFormat()
+                                    : unsmear::TimeFormat(time_format)),
+        csv_column_(csv_column) {}
+
+  // Returns the size of the prefix of the input holding whole records.
+  size_t WholeRecords(absl::string_view in) const {
+    if (times_ == Times::kInt64) {
+      return in.size() - in.size() % sizeof(int64_t);
+    }
+    size_t newline = in.rfind('\n');
+    return newline == absl::string_view::npos ? 0 : newline + 1;
+  }
+
+  // Splits whole records into at most n pieces of similar size.
+  std::vector<absl::string_view> Split(absl::string_view in, size_t n) const {
+    std::vector<absl::string_view> pieces;
+    for (; n > 0 && !in.empty(); --n) {
+      size_t size = in.size();
+      if (n > 1) {
+        size /= n;
+        if (times_ == Times::kInt64) {
+          size -= size % sizeof(int64_t);
+        } else {
+          size_t newline = in.find('\n', size);
+          size = newline == absl::string_view::npos ? in.size() : newline + 1;
+        }
+      }
+      if (size == 0) continue;
+      pieces.push_back(in.substr(0, size));
+      in.remove_prefix(size);
+    }
+    return pieces;
+  }
+
+  Times times() const { return times_; }
+
+  // Converts whole records, appending them to out, and returns the number of
+  // times that could not be converted.  For text and csv, those are output as
+  // empty lines or fields.
+  size_t Convert(absl::string_view in, std::string* out) const {
+    size_t failed = 0;
+    if (times_ == Times::kInt64) {
+      out->reserve(out->size() + in.size());
+      for (size_t i = 0; i + sizeof(int64_t) <= in.size();
+           i += sizeof(int64_t)) {
+        int64_t t = std::numeric_limits<int64_t>::min();
+        if (!ConvertNanos(LoadInt64(in.data() + i), &t)) ++failed;
+        AppendInt64(t, out);
+      }
+      return failed;
+    }
+
+    unsmear::LeapTable::Cursor cursor(lt_);
+    out->reserve(out->size() + in.size() + in.size() / 4);
+    while (!in.empty()) {
+      size_t newline = in.find('\n');
+      absl::string_view line = in.substr(0, newline);
+      in.remove_prefix(newline == absl::string_view::npos ? in.size()
+                                                          : newline + 1);
+      if (times_ == Times::kText) {
+        if (!ConvertText(line, &cursor, out)) ++failed;
+      } else if (!ConvertCsv(line, &cursor, out)) {
+        ++failed;
+      }
+      out->push_back('\n');
+    }
+    return failed;
+  }
+
+ private:
+  static int64_t LoadInt64(const char* p) {
+    uint64_t v = 0;
+    for (int i = sizeof(v) - 1; i >= 0; --i) {
+      v = v << 8 | static_cast<unsigned char>(p[i]);
+    }
+    return static_cast<int64_t>(v);
+  }
+
+  static void AppendInt64(int64_t t, std::string* out) {
+    char buf[sizeof(t)];
+    uint64_t v = static_cast<uint64_t>(t);
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      buf[i] = static_cast<char>(v >> (8 * i));
+    }
+    out->append(buf, sizeof(buf));
+  }
+
+  bool ConvertNanos(int64_t in, int64_t* out) const {
+    switch (conversion_) {
+      case Conversion::kUtcToTai:
+        return lt_.UnsmearNanos(in, out);
+      case Conversion::kUtcToGps:
+        return lt_.UnsmearToGpsNanos(in, out);
+      case Conversion::kTaiToUtc:
+        return lt_.SmearTaiNanos(in, out);
+      case Conversion::kGpsToUtc:
+        return lt_.SmearGpsNanos(in, out);
+      case Conversion::kNone:
+        break;
+    }
+    return false;
+  }
+
+  // Converts one text time, appending it to out.
+  bool ConvertText(absl::string_view in, unsmear::LeapTable::Cursor* cursor,
+                   std::string* out) const {
+    switch (conversion_) {
+      case Conversion::kUtcToTai:
+      case Conversion::kUtcToGps: {
+        absl::Time utc;
+        if (!format_.Parse(in, &utc, nullptr)) return false;
+        if (conversion_ == Conversion::kUtcToTai) {
+          auto tai = cursor->Unsmear(utc);
+          if (!tai.has_value()) return false;
+          format_.AppendTo(*tai, out);
+        } else {
+          auto gps = cursor->UnsmearToGps(utc);
+          if (!gps.has_value()) return false;
+          format_.AppendTo(*gps, out);
+        }
+        return true;
+      }
+      case Conversion::kTaiToUtc: {
+        unsmear::TaiTime tai;
+        if (!format_.Parse(in, &tai, nullptr)) return false;
+        auto utc = cursor->Smear(tai);
+        if (!utc.has_value()) return false;
+        format_.AppendTo(*utc, out);
+        return true;
+      }
+      case Conversion::kGpsToUtc: {
+        unsmear::GpsTime gps;
+        if (!format_.Parse(in, &gps, nullptr)) return false;
+        auto utc = cursor->Smear(gps);
+        if (!utc.has_value()) return false;
+        format_.AppendTo(*utc, out);
+        return true;
+      }
+      case Conversion::kNone:
+        break;
+    }
+    return false;
+  }
+
+  // Converts the time in one column of a csv line, appending the line to out.
+  bool ConvertCsv(absl::string_view line, unsmear::LeapTable::Cursor* cursor,
+                  std::string* out) const {
+    size_t begin = 0;
+    for (int i = 0; i < csv_column_ && begin != absl::string_view::npos; ++i) {
+      begin = line.find(',', begin);
+      if (begin != absl::string_view::npos) ++begin;
+    }
+    if (begin == absl::string_view::npos) {
+      out->append(line.data(), line.size());
+      return false;
+    }
+    size_t end = std::min(line.find(',', begin), line.size());
+    out->append(line.data(), begin);
+    bool converted =
+        ConvertText(line.substr(begin, end - begin), cursor, out);
+    out->append(line.data() + end, line.size() - end);
+    return converted;
+  }
+
+  const unsmear::LeapTable& lt_;
+  const Conversion conversion_;
+  const Times times_;
+  const unsmear::TimeFormat format_;
+  const int csv_column_;
+};
+
+bool WriteAll(int fd, absl::string_view s) {
+  while (!s.empty()) {
+    ssize_t n = write(fd, s.data(), s.size());
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      PLOG(ERROR) << "Failed writing converted times";
+      return false;
+    }
+    s.remove_prefix(n);
+  }
+  return true;
+}
+
+// Converts the times read from in_fd, writing them to stdout in the same
+// order.  Input is read in large chunks, each chunk is split among threads
+// that convert their pieces concurrently, and each chunk's output is written
+// while the next chunk is converted.  Returns false on errors reading or
+// writing, or if any time could not be converted.
+bool ConvertTimes(const TimeConverter& converter, int in_fd, bool csv_header,
+                  int threads) {
+  constexpr size_t kChunkSize = 16 << 20;
+  std::string buffer;
+  std::vector<std::string> outputs(threads);
+  std::vector<std::string> writing(threads);
+  std::thread writer;
+  std::atomic<bool> write_ok(true);
+  size_t failed = 0;
+  bool header = csv_header;
+  bool eof = false;
+  bool ok = true;
+
+  while (!eof && ok) {
+    // Read a chunk holding at least one whole record, unless it's the end.
+    size_t records = 0;
+    while (!eof && (buffer.size() < kChunkSize || records == 0)) {
+      size_t size = buffer.size();
+      buffer.resize(std::max(size + kChunkSize / 4, kChunkSize));
+      ssize_t n = read(in_fd, &buffer[size], buffer.size() - size);
+      if (n < 0 && errno == EINTR) {
+        buffer.resize(size);
+        continue;
+      }
+      if (n < 0) {
+        PLOG(ERROR) << "Failed reading times";
+        buffer.resize(size);
+        ok = false;
+        break;
+      }
+      buffer.resize(size + n);
+      eof = n == 0;
+      records = converter.WholeRecords(buffer);
+    }
+    absl::string_view chunk(buffer);
+    chunk = chunk.substr(0, eof ? chunk.size() : records);
+    if (eof && converter.times() == Times::kInt64 &&
+        converter.WholeRecords(chunk) != chunk.size()) {
+      LOG(ERROR) << "Input ends with a partial int64 time";
+      ok = false;
+    }
+
+    std::string header_line;
+    if (header) {
+      size_t newline = chunk.find('\n');
+      size_t size = newline == absl::string_view::npos ? chunk.size()
+                                                       : newline + 1;
+      header_line = std::string(chunk.substr(0, size));
+      chunk.remove_prefix(size);
+      header = false;
+    }
+
+    // Convert the pieces of the chunk concurrently.
+    std::vector<absl::string_view> pieces = converter.Split(chunk, threads);
+    std::vector<size_t> piece_failed(pieces.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < pieces.size(); ++i) {
+      outputs[i].clear();
+      workers.emplace_back([&, i] {
+        piece_failed[i] = converter.Convert(pieces[i], &outputs[i]);
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    for (size_t n : piece_failed) {
+      failed += n;
+    }
+    buffer.erase(0, header_line.size() + chunk.size());
+
+    // Write this chunk's output while converting the next one.
+    if (writer.joinable()) writer.join();
+    if (!write_ok) {
+      ok = false;
+      break;
+    }
+    std::swap(outputs, writing);
+    const size_t num_pieces = pieces.size();
+    writer = std::thread([&writing, &write_ok, num_pieces, header_line] {
+      bool ok = WriteAll(STDOUT_FILENO, header_line);
+      for (size_t i = 0; ok && i < num_pieces; ++i) {
+        ok = WriteAll(STDOUT_FILENO, writing[i]);
+      }
+      if (!ok) write_ok = false;
+    });
+  }
+  if (writer.joinable()) writer.join();
+  ok = ok && write_ok;
+
+  if (failed > 0) {
+    LOG(ERROR) << failed << " times could not be converted";
+  }
+  return ok && failed == 0;
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
   std::vector<char*> args = absl::ParseCommandLine(argc, argv);
   absl::InitializeLog();
 
-  if (args.size() != 2) {
+  const Conversion conversion = absl::GetFlag(FLAGS_convert);
+  if (args.size() != 2 &&
+      (conversion == Conversion::kNone || args.size() != 3)) {
     LOG(QFATAL) << kUsage;
   }
   const auto& filename = args[1];
@@ -146,11 +641,42 @@ int main(int argc, char** argv) {
           << absl::StrCat("Couldn't parse text proto from ", filename);
       break;
     }
+    case Format::kFlat: {
+      auto lt = unsmear::NewLeapTableFromFlatFile(filename);
+      CHECK(lt != nullptr)
+          << absl::StrCat("Couldn't read flat leap table from ", filename);
+      unsmear::LeapTableToProto(*lt, &pb);
+      break;
+    }
     case Format::kJson:
     case Format::kDebug:
+    case Format::kCc:
       LOG(QFATAL) << "Unsupported --input";
   }
 
+  if (conversion != Conversion::kNone) {
+    auto lt = unsmear::NewLeapTableFromProto(pb);
+    CHECK(lt != nullptr) << absl::StrCat("Invalid leap table in ", filename);
+    int in_fd = STDIN_FILENO;
+    if (args.size() == 3 && strcmp(args[2], "-") != 0) {
+      in_fd = open(args[2], O_RDONLY);
+      if (in_fd < 0) {
+        PLOG(FATAL) << absl::StrCat("Couldn't open ", args[2]);
+      }
+    }
+    int threads = absl::GetFlag(FLAGS_threads);
+    if (threads <= 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    TimeConverter converter(*lt, conversion, absl::GetFlag(FLAGS_times),
+                            absl::GetFlag(FLAGS_time_format),
+                            absl::GetFlag(FLAGS_csv_column));
+    return ConvertTimes(converter, in_fd, absl::GetFlag(FLAGS_csv_header),
+                        threads)
+               ? 0
+               : 1;
+  }
+
   switch (absl::GetFlag(FLAGS_output)) {
     case Format::kProto:
       CHECK(OutputProto(pb));
@@ -164,5 +690,11 @@ int main(int argc, char** argv) {
     case Format::kDebug:
       CHECK(OutputDebug(pb));
       break;
+    case Format::kCc:
+      CHECK(OutputCc(pb));
+      break;
+    case Format::kFlat:
+      CHECK(OutputFlat(pb));
+      break;
   }
 }
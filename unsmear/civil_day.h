@@ -0,0 +1,86 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Calendar arithmetic for the implementation of unsmear.  Not part of the
+// public API.
+
+#ifndef UNSMEAR_CIVIL_DAY_H
+#define UNSMEAR_CIVIL_DAY_H
+
+#include <cstdint>
+#include <utility>
+#include "absl/time/time.h"
+
+namespace unsmear {
+namespace internal {
+
+// A day of the proleptic Gregorian calendar.
+struct CivilDay {
+  int64_t year;
+  int month;  // [1, 12]
+  int day;    // [1, 31]
+};
+
+// Returns the date of a count of days since 1970-01-01.  This is the
+// closed-form civil_from_days() algorithm from
+// http://howardhinnant.github.io/date_algorithms.html, and is much faster than
+// going through absl::ToTM().
+inline CivilDay CivilFromDays(int64_t days) {
+  days += 719468;  // Shift the epoch to 0000-03-01.
+  const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const int64_t doe = days - era * 146097;  // [0, 146096]
+  const int64_t yoe =
+      (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
+  const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);  // [0, 365]
+  const int64_t mp = (5 * doy + 2) / 153;  // [0, 11], starting in March
+  const int month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+  return {yoe + era * 400 + (month <= 2), month,
+          static_cast<int>(doy - (153 * mp + 2) / 5 + 1)};
+}
+
+// Returns the count of days since 1970-01-01 of a date.  This is the inverse of
+// CivilFromDays(), from the same source.
+inline int64_t DaysFromCivil(int64_t year, int month, int day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t yoe = year - era * 400;  // [0, 399]
+  const int64_t mp = month > 2 ? month - 3 : month + 9;  // [0, 11]
+  const int64_t doy = (153 * mp + 2) / 5 + day - 1;      // [0, 365]
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;  // [0, 146096]
+  return era * 146097 + doe - 719468;
+}
+
+// Returns the number of days in a month.
+inline int DaysInMonth(int64_t year, int month) {
+  constexpr int kDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) {
+    return 29;
+  }
+  return kDays[month - 1];
+}
+
+// Returns the number of whole days and the remaining seconds since the Unix
+// epoch, flooring toward the infinite past.  Infinities saturate as in
+// absl::ToUnixSeconds(), so callers must check for them separately.
+inline std::pair<int64_t, int64_t> ToUnixDays(absl::Time t) {
+  const int64_t s = absl::ToUnixSeconds(t);
+  const int64_t second = s % 86400;
+  if (second < 0) return {s / 86400 - 1, second + 86400};
+  return {s / 86400, second};
+}
+
+}  // namespace internal
+}  // namespace unsmear
+
+#endif  // UNSMEAR_CIVIL_DAY_H
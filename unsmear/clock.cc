@@ -0,0 +1,69 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/clock.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+namespace unsmear {
+
+std::pair<TaiTime, TaiTime> Clock::Refresh(int64_t utc) const {
+  // A table from the holder is kept alive until the conversion is done.
+  std::shared_ptr<const LeapTable> snapshot;
+  if (lt_ == nullptr) {
+    snapshot = holder_->Get();
+  }
+  const LeapTable& lt = lt_ != nullptr ? *lt_ : *snapshot;
+  absl::Time t = absl::FromUnixNanos(utc);
+  auto segment = lt.SegmentAt(t);
+  if (!segment.has_value()) {
+    return lt.FutureProofUnsmear(t);
+  }
+
+  Segment s;
+  s.begin = absl::ToUnixNanos(segment->utc_begin());
+  s.end = absl::ToUnixNanos(segment->utc_end());
+  s.offset = absl::ToInt64Nanoseconds(
+      internal::GetRep(segment->tai_end() - TaiEpoch()) -
+      (segment->utc_end() - absl::UnixEpoch()));
+  s.smear = segment->smear();
+
+  // Unsmeared times are counted in nanoseconds since the TAI epoch, so they
+  // overflow about 12 years before smeared times do, in 2250.  Segments that
+  // end after that are cached only up to it, if their end does not affect the
+  // interpolation, and otherwise not at all.
+  const int64_t max_end = std::numeric_limits<int64_t>::max() - s.offset;
+  if (utc > max_end || (s.end > max_end && s.smear != 0)) {
+    return lt.FutureProofUnsmear(t);
+  }
+  s.end = std::min(s.end, max_end);
+
+  // Publish the segment, unless another thread is already publishing one.
+  uint64_t seq = seq_.load(std::memory_order_relaxed);
+  if (seq % 2 == 0 && seq_.compare_exchange_strong(
+                          seq, seq + 1, std::memory_order_acquire)) {
+    std::atomic_thread_fence(std::memory_order_release);
+    begin_.store(s.begin, std::memory_order_relaxed);
+    end_.store(s.end, std::memory_order_relaxed);
+    offset_.store(s.offset, std::memory_order_relaxed);
+    smear_.store(s.smear, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+  TaiTime tai = Interpolate(s, utc);
+  return {tai, tai};
+}
+
+}  // namespace unsmear
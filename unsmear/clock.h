@@ -0,0 +1,164 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_CLOCK_H
+#define UNSMEAR_CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include "absl/time/clock.h"
+#include "absl/types/optional.h"
+#include "unsmear/conversion_stats.h"
+#include "unsmear/leap_table_holder.h"
+#include "unsmear/unsmear.h"
+
+namespace unsmear {
+
+// A Clock reads the current time from a smeared system clock and unsmears it,
+// for callers such as tracing and logging that stamp events at a high rate.
+//
+// It caches the segment of the leap table, between consecutive smear changes,
+// that contains the current time.  Since segments last from a day to years,
+// nearly every reading is within the cached segment, and costs a read of the
+// system clock, a bounds check and an integer interpolation.  Results are
+// identical to those of LeapTable::Unsmear() at the time read.
+//
+// A Clock is thread-safe, and is meant to be shared by every thread of a
+// process.  The cache is guarded by a sequence lock, so readers never block
+// or write shared memory, and only the first reading in a new segment updates
+// it.
+//
+// A Clock bound to a LeapTableHolder converts with the holder's current table,
+// so that it keeps working past the expiration of the table it started with.
+// Updates to the holder extend its table, so the cached segment remains valid
+// across them.
+//
+// Example:
+//   static const Clock* clock = new Clock(holder);
+//   absl::optional<TaiTime> tai = clock->NowTai();
+class Clock {
+ public:
+  // Returns the current smeared time in nanoseconds since the Unix epoch.
+  using NowNanosFunction = int64_t (*)();
+
+  // A Clock must not outlive its LeapTable or LeapTableHolder.  The time source
+  // may be replaced, such as by a fake clock in tests.
+  explicit Clock(const LeapTable& lt,
+                 NowNanosFunction now = &absl::GetCurrentTimeNanos)
+      : lt_(&lt), now_(now) {}
+  explicit Clock(const LeapTableHolder& holder,
+                 NowNanosFunction now = &absl::GetCurrentTimeNanos)
+      : holder_(&holder), now_(now) {}
+
+  Clock(const Clock&) = delete;
+  Clock& operator=(const Clock&) = delete;
+
+  // Returns the current time, if it is within the validity range of the leap
+  // table.
+  absl::optional<TaiTime> NowTai() const;
+  absl::optional<GpsTime> NowGps() const;
+
+  // Returns the earliest and latest possible current time, as
+  // LeapTable::FutureProofUnsmear() does.  The times are equal within the
+  // validity range of the leap table.
+  std::pair<TaiTime, TaiTime> NowTaiInterval() const;
+
+ private:
+  // The cached segment, as a closed interval of smeared times in nanoseconds
+  // since the Unix epoch.  Within it, the unsmeared time in nanoseconds since
+  // the TAI epoch is
+  //   utc + offset - smear * ((end - utc) / 86400)
+  // which is the integer interpolation LeapTable::Unsmear() uses.
+  struct Segment {
+    int64_t begin;
+    int64_t end;
+    int64_t offset;
+    int64_t smear;
+  };
+
+  // Converts utc within the segment, counting the conversion.
+  static TaiTime Interpolate(const Segment& s, int64_t utc) {
+    internal::CountConversion(s.smear != 0
+                                  ? internal::ConversionPath::kSmear
+                                  : internal::ConversionPath::kPrecise);
+    return TaiEpoch() +
+           Nanoseconds(utc + s.offset - s.smear * ((s.end - utc) / 86400));
+  }
+
+  // Reads the cached segment into s, and returns true if it was read
+  // consistently and contains utc.
+  bool Lookup(int64_t utc, Segment* s) const {
+    uint64_t seq = seq_.load(std::memory_order_acquire);
+    s->begin = begin_.load(std::memory_order_relaxed);
+    s->end = end_.load(std::memory_order_relaxed);
+    s->offset = offset_.load(std::memory_order_relaxed);
+    s->smear = smear_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq % 2 == 0 && seq == seq_.load(std::memory_order_relaxed) &&
+           utc >= s->begin && utc <= s->end;
+  }
+
+  // Converts utc with the leap table, and caches its segment if it is within
+  // the precise range of the table.
+  std::pair<TaiTime, TaiTime> Refresh(int64_t utc) const;
+
+  const LeapTable* lt_ = nullptr;
+  const LeapTableHolder* holder_ = nullptr;
+  NowNanosFunction now_;
+
+  // The sequence number is odd while the segment is being written.  The
+  // segment starts empty.
+  mutable std::atomic<uint64_t> seq_{0};
+  mutable std::atomic<int64_t> begin_{1};
+  mutable std::atomic<int64_t> end_{0};
+  mutable std::atomic<int64_t> offset_{0};
+  mutable std::atomic<int64_t> smear_{0};
+};
+
+inline absl::optional<TaiTime> Clock::NowTai() const {
+  int64_t utc = now_();
+  Segment s;
+  if (Lookup(utc, &s)) {
+    return Interpolate(s, utc);
+  }
+  auto interval = Refresh(utc);
+  if (interval.first != interval.second) {
+    return absl::nullopt;
+  }
+  return interval.first;
+}
+
+inline absl::optional<GpsTime> Clock::NowGps() const {
+  auto tai = NowTai();
+  if (!tai || *tai < ToTaiTime(GpsEpoch())) {
+    // It's not valid to unsmear times before the GPST epoch.
+    return absl::nullopt;
+  }
+  return ToGpsTime(*tai);
+}
+
+inline std::pair<TaiTime, TaiTime> Clock::NowTaiInterval() const {
+  int64_t utc = now_();
+  Segment s;
+  if (Lookup(utc, &s)) {
+    TaiTime tai = Interpolate(s, utc);
+    return {tai, tai};
+  }
+  return Refresh(utc);
+}
+
+}  // namespace unsmear
+
+#endif  // UNSMEAR_CLOCK_H
@@ -0,0 +1,166 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/clock.h"
+
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "unsmear/unsmear_proto.h"
+
+namespace unsmear {
+namespace {
+
+// The time returned by FakeNow(), separately for each thread.
+thread_local int64_t fake_now = 0;
+
+int64_t FakeNow() { return fake_now; }
+
+void SetFakeNow(absl::Time t) { fake_now = absl::ToUnixNanos(t); }
+
+// Returns an absl::Time at UTC noon.
+absl::Time Noon(int64_t y, int m, int d) {
+  return absl::FromDateTime(y, m, d, 12, 0, 0, absl::UTCTimeZone());
+}
+
+LeapTable TestLeapTable() {
+  LeapTableProto proto;
+  proto.add_positive_leaps(2441499);  // 1972-06-30 12:00:00 UTC
+  proto.add_negative_leaps(2441864);  // 1973-06-30 12:00:00 UTC
+  proto.add_positive_leaps(2444786);  // 1981-06-30 12:00:00 UTC
+  proto.set_end_jdn(2444969);         // 1981-12-30 12:00:00 UTC
+  return *NewLeapTableFromProto(proto);
+}
+
+class ClockTest : public ::testing::Test {
+ protected:
+  // Expects the clock to give the same results as the leap table at t.
+  void ExpectNow(const Clock& clock, absl::Time t) {
+    SetFakeNow(t);
+    EXPECT_EQ(clock.NowTai(), lt_.Unsmear(t)) << t;
+    EXPECT_EQ(clock.NowGps(), lt_.UnsmearToGps(t)) << t;
+    EXPECT_EQ(clock.NowTaiInterval(), lt_.FutureProofUnsmear(t)) << t;
+  }
+
+  LeapTable lt_ = TestLeapTable();
+};
+
+TEST_F(ClockTest, MatchesLeapTable) {
+  Clock clock(lt_, &FakeNow);
+  // Step through the whole table, and through each smear in finer steps.
+  for (absl::Time t = ModernUtcEpoch(); t <= lt_.expiration();
+       t += absl::Hours(1) + absl::Nanoseconds(12345)) {
+    ExpectNow(clock, t);
+  }
+  for (absl::Time smear :
+       {Noon(1972, 6, 30), Noon(1973, 6, 30), Noon(1981, 6, 30)}) {
+    for (absl::Time t = smear - absl::Hours(1);
+         t <= smear + absl::Hours(25); t += absl::Seconds(7.654321)) {
+      ExpectNow(clock, t);
+    }
+  }
+}
+
+TEST_F(ClockTest, SegmentBoundaries) {
+  Clock clock(lt_, &FakeNow);
+  for (absl::Time t :
+       {ModernUtcEpoch(), Noon(1972, 6, 30), Noon(1972, 7, 1),
+        Noon(1973, 6, 30), Noon(1973, 7, 1), Noon(1981, 6, 30),
+        Noon(1981, 7, 1), lt_.expiration()}) {
+    for (absl::Duration d :
+         {absl::Nanoseconds(-1), absl::ZeroDuration(), absl::Nanoseconds(1)}) {
+      ExpectNow(clock, t + d);
+    }
+    // Jump back and forth across the boundary.
+    ExpectNow(clock, t - absl::Hours(1));
+    ExpectNow(clock, t + absl::Hours(1));
+    ExpectNow(clock, t - absl::Hours(1));
+  }
+}
+
+TEST_F(ClockTest, OutsidePreciseRange) {
+  Clock clock(lt_, &FakeNow);
+  for (absl::Time t : {ModernUtcEpoch() - absl::Nanoseconds(1),
+                       lt_.expiration() + absl::Nanoseconds(1),
+                       Noon(1990, 1, 1), absl::UnixEpoch()}) {
+    SetFakeNow(t);
+    EXPECT_EQ(clock.NowTai(), absl::nullopt) << t;
+    EXPECT_EQ(clock.NowGps(), absl::nullopt) << t;
+    EXPECT_EQ(clock.NowTaiInterval(), lt_.FutureProofUnsmear(t)) << t;
+  }
+}
+
+TEST_F(ClockTest, FarFuture) {
+  // Unsmeared times after 2250 cannot be counted in nanoseconds since the TAI
+  // epoch, but are still converted.
+  LeapTableProto proto;
+  LeapTableToProto(lt_, &proto);
+  proto.set_end_jdn(2561116);  // 2299-12-30 12:00:00 UTC
+  lt_ = *NewLeapTableFromProto(proto);
+  Clock clock(lt_, &FakeNow);
+  for (int64_t year : {2000, 2249, 2250, 2251, 2262, 2251, 2000}) {
+    ExpectNow(clock, Noon(year, 1, 1));
+  }
+  ExpectNow(clock, absl::FromUnixNanos(std::numeric_limits<int64_t>::max()));
+}
+
+TEST_F(ClockTest, Holder) {
+  LeapTableProto proto;
+  LeapTableToProto(lt_, &proto);
+  LeapTableHolder holder(lt_);
+  Clock clock(holder, &FakeNow);
+  absl::Time t = Noon(1982, 6, 1);
+  ExpectNow(clock, lt_.expiration());
+  SetFakeNow(t);
+  EXPECT_EQ(clock.NowTai(), absl::nullopt);
+
+  proto.set_end_jdn(2445150);  // 1982-06-29 12:00:00 UTC
+  ASSERT_TRUE(holder.Update(*NewLeapTableFromProto(proto)));
+  lt_ = *holder.Get();
+  ExpectNow(clock, t);
+  ExpectNow(clock, Noon(1981, 6, 1));
+}
+
+TEST_F(ClockTest, SystemTime) {
+  Clock clock(lt_);
+  absl::Time before = absl::Now();
+  auto interval = clock.NowTaiInterval();
+  absl::Time after = absl::Now();
+  EXPECT_LE(interval.first, lt_.FutureProofUnsmear(after).second);
+  EXPECT_GE(interval.second, lt_.FutureProofUnsmear(before).first);
+}
+
+TEST_F(ClockTest, ConcurrentReaders) {
+  Clock clock(lt_, &FakeNow);
+  // Each thread moves between segments at different times, so they race to
+  // update the cached segment.
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([this, &clock, i] {
+      for (absl::Time t = ModernUtcEpoch() + absl::Minutes(i);
+           t <= lt_.expiration(); t += absl::Hours(7)) {
+        SetFakeNow(t);
+        ASSERT_EQ(clock.NowTai(), lt_.Unsmear(t)) << t;
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+}
+
+}  // namespace
+}  // namespace unsmear
@@ -0,0 +1,90 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/conversion_stats.h"
+
+#include <atomic>
+#include <cstddef>
+
+namespace unsmear {
+namespace {
+
+// Each thread counts in one of several shards, on its own cache line, so that
+// threads converting concurrently rarely contend.  The shards are constant
+// initialized, so conversions by static initializers are counted.
+constexpr size_t kNumShards = 16;
+
+struct alignas(64) Shard {
+  std::atomic<uint64_t> counts[internal::kNumConversionPaths];
+};
+
+Shard shards[kNumShards];
+
+#ifdef UNSMEAR_CONVERSION_STATS
+Shard& ThisThreadShard() {
+  static std::atomic<size_t> next_shard(0);
+  thread_local Shard& shard =
+      shards[next_shard.fetch_add(1, std::memory_order_relaxed) % kNumShards];
+  return shard;
+}
+#endif
+
+}  // namespace
+
+bool ConversionStatsEnabled() {
+#ifdef UNSMEAR_CONVERSION_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+ConversionStats GetConversionStats() {
+  uint64_t counts[internal::kNumConversionPaths] = {};
+  for (const Shard& shard : shards) {
+    for (int i = 0; i < internal::kNumConversionPaths; ++i) {
+      counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+    }
+  }
+  auto count = [&counts](internal::ConversionPath path) {
+    return counts[static_cast<int>(path)];
+  };
+  ConversionStats stats;
+  stats.smear = count(internal::ConversionPath::kSmear);
+  stats.precise = count(internal::ConversionPath::kPrecise) + stats.smear;
+  stats.future = count(internal::ConversionPath::kFuture);
+  stats.before_epoch = count(internal::ConversionPath::kBeforeEpoch);
+  stats.infinite = count(internal::ConversionPath::kInfinite);
+  return stats;
+}
+
+void ResetConversionStats() {
+  for (Shard& shard : shards) {
+    for (auto& count : shard.counts) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+namespace internal {
+
+#ifdef UNSMEAR_CONVERSION_STATS
+void CountConversion(ConversionPath path) {
+  ThisThreadShard().counts[static_cast<int>(path)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+#endif
+
+}  // namespace internal
+}  // namespace unsmear
@@ -0,0 +1,88 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_CONVERSION_STATS_H
+#define UNSMEAR_CONVERSION_STATS_H
+
+#include <cstdint>
+
+namespace unsmear {
+
+// Counts of the conversions done by every LeapTable in the process, by the
+// path they took, for exporting to a monitoring system.
+//
+// The counts are only recorded when the library is built with
+// UNSMEAR_CONVERSION_STATS defined, as with
+//   bazel build --define unsmear_conversion_stats=true ...
+// and are otherwise always zero, with no cost to conversions.  When recorded,
+// each conversion costs a relaxed atomic increment of a counter shared with
+// few other threads.
+//
+// Conversions of finite times past the expiration of the table are imprecise,
+// and take a slower path that computes hypothetical future leap seconds; they
+// are counted in future.  Conversions of times before 1972, or before the GPST
+// epoch, fail and are counted in before_epoch.  A growing future count means
+// that a table needs updating, and a growing before_epoch count means that
+// callers are converting times that they should not.
+struct ConversionStats {
+  // Conversions within the validity range of the leap table,
+  uint64_t precise = 0;
+  // of which this many were during a smear.
+  uint64_t smear = 0;
+  // Conversions of finite times past the expiration of the leap table, which
+  // are imprecise.
+  uint64_t future = 0;
+  // Conversions of finite times that cannot be converted: smeared times before
+  // 1972, and times before the GPST epoch when converting to or from GPST.
+  uint64_t before_epoch = 0;
+  // Conversions of infinite times.
+  uint64_t infinite = 0;
+};
+
+// Returns whether conversion statistics are recorded.
+bool ConversionStatsEnabled();
+
+// Returns the counts of conversions since the start of the process, or since
+// the last ResetConversionStats().  Counts from concurrent conversions may or
+// may not be included.
+ConversionStats GetConversionStats();
+
+// Sets the counts back to zero, such as in tests.  Conversions concurrent with
+// it may or may not be counted.
+void ResetConversionStats();
+
+namespace internal {
+
+// The path taken by a conversion.  Each conversion counts one path, and
+// kPrecise excludes conversions during a smear.
+enum class ConversionPath {
+  kPrecise,
+  kSmear,
+  kFuture,
+  kBeforeEpoch,
+  kInfinite,
+};
+
+constexpr int kNumConversionPaths = 5;
+
+#ifdef UNSMEAR_CONVERSION_STATS
+void CountConversion(ConversionPath path);
+#else
+inline void CountConversion(ConversionPath path) {}
+#endif
+
+}  // namespace internal
+}  // namespace unsmear
+
+#endif  // UNSMEAR_CONVERSION_STATS_H
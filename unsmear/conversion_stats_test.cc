@@ -0,0 +1,134 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/conversion_stats.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "unsmear/clock.h"
+#include "unsmear/unsmear.h"
+#include "unsmear/unsmear_proto.h"
+
+namespace unsmear {
+namespace {
+
+// Expects the stats to be as given, if they are recorded, and zero otherwise.
+void ExpectStats(uint64_t precise, uint64_t smear, uint64_t future,
+                 uint64_t before_epoch, uint64_t infinite) {
+  ConversionStats stats = GetConversionStats();
+  if (!ConversionStatsEnabled()) {
+    precise = smear = future = before_epoch = infinite = 0;
+  }
+  EXPECT_EQ(stats.precise, precise);
+  EXPECT_EQ(stats.smear, smear);
+  EXPECT_EQ(stats.future, future);
+  EXPECT_EQ(stats.before_epoch, before_epoch);
+  EXPECT_EQ(stats.infinite, infinite);
+}
+
+absl::Time Noon(int64_t y, int m, int d) {
+  return absl::FromDateTime(y, m, d, 12, 0, 0, absl::UTCTimeZone());
+}
+
+class ConversionStatsTest : public ::testing::Test {
+ protected:
+  ConversionStatsTest() {
+    LeapTableProto proto;
+    proto.add_positive_leaps(2441499);  // 1972-06-30 12:00:00 UTC
+    proto.set_end_jdn(2444969);         // 1981-12-30 12:00:00 UTC
+    lt_ = NewLeapTableFromProto(proto);
+    ResetConversionStats();
+  }
+
+  std::unique_ptr<LeapTable> lt_;
+};
+
+TEST_F(ConversionStatsTest, Paths) {
+  const absl::Time smear = Noon(1972, 6, 30) + absl::Hours(1);
+  const absl::Time future = lt_->expiration() + absl::Hours(1);
+  lt_->Unsmear(Noon(1975, 1, 1));
+  lt_->Unsmear(smear);
+  lt_->Smear(*lt_->Unsmear(smear));
+  ExpectStats(4, 3, 0, 0, 0);
+
+  lt_->Unsmear(future);
+  lt_->FutureProofSmear(lt_->FutureProofUnsmear(future).first);
+  ExpectStats(4, 3, 3, 0, 0);
+
+  lt_->Unsmear(ModernUtcEpoch() - absl::Nanoseconds(1));
+  lt_->UnsmearToGps(Noon(1975, 1, 1));
+  lt_->Smear(GpsEpoch() - Seconds(1));
+  lt_->Smear(TaiEpoch());
+  ExpectStats(4, 3, 3, 4, 0);
+
+  lt_->Unsmear(absl::InfiniteFuture());
+  lt_->UnsmearToGps(absl::InfinitePast());
+  lt_->Smear(TaiInfiniteFuture());
+  ExpectStats(4, 3, 3, 4, 3);
+
+  ResetConversionStats();
+  ExpectStats(0, 0, 0, 0, 0);
+}
+
+TEST_F(ConversionStatsTest, Nanos) {
+  int64_t out;
+  lt_->UnsmearNanos(absl::ToUnixNanos(Noon(1975, 1, 1)), &out);
+  lt_->UnsmearToGpsNanos(absl::ToUnixNanos(Noon(1981, 1, 1)), &out);
+  lt_->UnsmearNanos(absl::ToUnixNanos(Noon(1972, 6, 30) + absl::Hours(1)),
+                    &out);
+  lt_->SmearTaiNanos(out, &out);
+  ExpectStats(4, 2, 0, 0, 0);
+
+  lt_->UnsmearNanos(absl::ToUnixNanos(lt_->expiration()) + 1, &out);
+  lt_->UnsmearNanos(0, &out);
+  lt_->UnsmearToGpsNanos(absl::ToUnixNanos(Noon(1975, 1, 1)), &out);
+  lt_->SmearGpsNanos(-1, &out);
+  ExpectStats(4, 2, 1, 3, 0);
+}
+
+TEST_F(ConversionStatsTest, CursorAndClock) {
+  LeapTable::Cursor cursor(*lt_);
+  for (int64_t year = 1973; year < 1980; ++year) {
+    cursor.Unsmear(Noon(year, 1, 1));
+  }
+  cursor.Unsmear(absl::InfinitePast());
+  ExpectStats(7, 0, 0, 0, 1);
+
+  Clock clock(*lt_, [] {
+    return absl::ToUnixNanos(Noon(1972, 6, 30) + absl::Hours(2));
+  });
+  clock.NowTai();
+  clock.NowTai();
+  ExpectStats(9, 2, 0, 0, 1);
+}
+
+TEST_F(ConversionStatsTest, Threads) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([this] {
+      for (int j = 0; j < 1000; ++j) {
+        lt_->Unsmear(Noon(1975, 1, 1));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ExpectStats(8000, 0, 0, 0, 0);
+}
+
+}  // namespace
+}  // namespace unsmear
@@ -12,8 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <vector>
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "unsmear/civil_day.h"
 #include "unsmear/unsmear.h"
 
 namespace unsmear {
@@ -48,71 +55,42 @@ const std::string& ZoneName(GpsTime t) {
   return *s;
 }
 
-const std::string& DefaultFormat(TaiTime t) {
-  static auto* s = new std::string("%Y-%m-%d %H:%M:%E*S TAI");
-  return *s;
-}
-const std::string& DefaultFormat(GpsTime t) {
-  static auto* s = new std::string("%Y-%m-%d %H:%M:%E*S GPST");
-  return *s;
-}
-const std::string& DefaultFormat(absl::Time t) {
-  static auto* s = new std::string("%Y-%m-%d %H:%M:%E*S UTC");
-  return *s;
+constexpr char kDefaultFormat[] = "%Y-%m-%d %H:%M:%E*S %Z";
+
+// The part of a format that TimeFormat can format itself.
+constexpr absl::string_view kFastPrefix = "%Y-%m-%d %H:%M:%E*S";
+// The longest output for kFastPrefix, "9999-12-31 23:59:59.999999999".
+constexpr size_t kMaxFastPrefixSize = 29;
+
+const TimeFormat& DefaultTimeFormat() {
+  static const auto* f = new TimeFormat();
+  return *f;
 }
 
 // Convert between the TAI and GPST timescales and the Unix timescale.  Because
 // seconds are defined differently in these timescales, this is completely
 // unsound, but it's just what we need for formatting purposes.
 absl::Time ToUnixTime(TaiTime t) {
-  return absl::FromUnixNanos((t - TaiEpoch()) / Nanoseconds(1)) -
+  return absl::FromUnixNanos(ToInt64Nanoseconds(t - TaiEpoch())) -
          4383 * absl::Hours(24);
 }
 absl::Time ToUnixTime(GpsTime t) {
-  return absl::FromUnixNanos((t - GpsEpoch()) / Nanoseconds(1)) +
+  return absl::FromUnixNanos(ToInt64Nanoseconds(t - GpsEpoch())) +
          3657 * absl::Hours(24);
 }
 
-}  // namespace
-
-// Formatting with the default format.  This doesn't simply delegate to the
-// non-default version because we don't need to handle %Z.
-template <internal::TtBasedTimescale timescale>
-std::string FormatTime(internal::TtBasedTime<timescale> t) {
-  if (t == t.InfiniteFuture()) {
-    return FutureName(t);
-  }
-  if (t == t.InfinitePast()) {
-    return PastName(t);
-  }
-  return absl::FormatTime(DefaultFormat(t), ToUnixTime(t), absl::UTCTimeZone());
-}
-// Explicit instantiation.
-template std::string FormatTime(internal::TtBasedTime<internal::TAI> t);
-template std::string FormatTime(internal::TtBasedTime<internal::GPST> t);
-
-// Formatting with user-specified formats.
-template <internal::TtBasedTimescale timescale>
-std::string FormatTime(const std::string& format,
-                       internal::TtBasedTime<timescale> t) {
-  if (t == t.InfiniteFuture()) {
-    return FutureName(t);
-  }
-  if (t == t.InfinitePast()) {
-    return PastName(t);
-  }
-
-  // There is no absl::FixedTimeZoneWithName() to create a time zone with the
-  // name we want, so we need to preprocess the format string to replace "%Z"
-  // with the zone name.  But we shouldn't replace "%%Z" as would happen if we
-  // used absl::StrReplaceAll().
+// There is no absl::FixedTimeZoneWithName() to create a time zone with the
+// name we want, so we need to preprocess the format string to replace "%Z"
+// with the zone name.  But we shouldn't replace "%%Z" as would happen if we
+// used absl::StrReplaceAll().
+std::string ReplaceZone(absl::string_view format, absl::string_view zone) {
   std::string s;
   s.reserve(format.size());
   bool saw_percent = false;
   for (char c : format) {
     if (saw_percent) {
       if (c == 'Z') {
-        s.append(ZoneName(t));
+        s.append(zone.data(), zone.size());
       } else {
         s.push_back('%');
         s.push_back(c);
@@ -130,8 +108,461 @@ std::string FormatTime(const std::string& format,
     // Last char of string was '%'; unswallow it.
     s.push_back('%');
   }
+  return s;
+}
+
+// Returns true if TimeFormat can format the format itself.
+bool IsFast(absl::string_view format) {
+  if (format.substr(0, kFastPrefix.size()) != kFastPrefix) {
+    return false;
+  }
+  absl::string_view tail = format.substr(kFastPrefix.size());
+  return tail.find('%') == tail.npos &&
+         kMaxFastPrefixSize + tail.size() < TimeFormat::kMaxDefaultSize;
+}
 
-  return absl::FormatTime(s, ToUnixTime(t), absl::UTCTimeZone());
+// Writes the value as exactly n decimal digits.
+char* WriteDigits(int64_t v, int n, char* p) {
+  for (int i = n - 1; i >= 0; --i) {
+    p[i] = '0' + v % 10;
+    v /= 10;
+  }
+  return p + n;
+}
+
+// Writes the time with kFastPrefix to p, which has room for
+// kMaxFastPrefixSize characters, and returns the end of the output.  Returns
+// nullptr without writing anything if absl::FormatTime() is needed: for
+// infinities, years not of four digits, or fractions of a nanosecond.
+char* FormatFastPrefix(absl::Time t, char* p) {
+  // 1000-01-01 and 10000-01-01.  Checking first also keeps the arithmetic below
+  // from overflowing for infinities and times near the limits of absl::Time.
+  if (t < absl::FromUnixSeconds(-354285 * int64_t{86400}) ||
+      t >= absl::FromUnixSeconds(2932897 * int64_t{86400})) {
+    return nullptr;
+  }
+  const auto days = internal::ToUnixDays(t);
+  const absl::Duration subsecond =
+      t - absl::FromUnixSeconds(days.first * 86400 + days.second);
+  const int64_t ns = absl::ToInt64Nanoseconds(subsecond);
+  if (subsecond != absl::Nanoseconds(ns)) {
+    return nullptr;
+  }
+  const internal::CivilDay day = internal::CivilFromDays(days.first);
+  p = WriteDigits(day.year, 4, p);
+  *p++ = '-';
+  p = WriteDigits(day.month, 2, p);
+  *p++ = '-';
+  p = WriteDigits(day.day, 2, p);
+  *p++ = ' ';
+  p = WriteDigits(days.second / 3600, 2, p);
+  *p++ = ':';
+  p = WriteDigits(days.second / 60 % 60, 2, p);
+  *p++ = ':';
+  p = WriteDigits(days.second % 60, 2, p);
+  if (ns != 0) {
+    // %E*S omits trailing zeros.
+    *p++ = '.';
+    int digits = 9;
+    int64_t fraction = ns;
+    while (fraction % 10 == 0) {
+      fraction /= 10;
+      --digits;
+    }
+    p = WriteDigits(fraction, digits, p);
+  }
+  return p;
+}
+
+// The two-digit decimal representations of 0 to 99, concatenated, so that
+// digits can be written two at a time.
+constexpr char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+// Writes the value in [0, 99] as two decimal digits.
+inline void WriteDigitPair(int64_t v, char* p) {
+  std::memcpy(p, kDigitPairs + 2 * v, 2);
+}
+
+// Writes the value in [0, 999999999] as nine decimal digits.
+inline void WriteNineDigits(int64_t v, char* p) {
+  const int64_t hi = v / 100000;  // [0, 9999]
+  const int64_t lo = v % 100000;  // [0, 99999]
+  p[0] = '0' + hi / 1000;
+  WriteDigitPair(hi / 10 % 100, p + 1);
+  p[3] = '0' + hi % 10;
+  WriteDigitPair(lo / 1000, p + 4);
+  WriteDigitPair(lo / 10 % 100, p + 6);
+  p[8] = '0' + lo % 10;
+}
+
+// "2006-01-02 15:04:05", the part of a fixed-width record before the fraction.
+constexpr size_t kFixedSecondsSize = 19;
+// The largest count of days since 1970-01-01 that is in the year 9999, and the
+// smallest that is in the year 0.
+constexpr int64_t kMaxFixedDays = 2932896;
+constexpr int64_t kMinFixedDays = -719528;
+
+// The zone names of fixed-width records.
+absl::string_view FixedZoneName(TaiTime t) { return ZoneName(t); }
+absl::string_view FixedZoneName(GpsTime t) { return ZoneName(t); }
+absl::string_view FixedZoneName(absl::Time t) { return "UTC"; }
+
+// Like ToUnixTime(), but exact over the whole range of TaiTime and GpsTime,
+// mapping their infinities to those of absl::Time.
+absl::Time ToFixedUnixTime(TaiTime t) {
+  return absl::UnixEpoch() + internal::GetRep(t - TaiEpoch()) -
+         4383 * absl::Hours(24);
+}
+absl::Time ToFixedUnixTime(GpsTime t) {
+  return absl::UnixEpoch() + internal::GetRep(t - GpsEpoch()) +
+         3657 * absl::Hours(24);
+}
+absl::Time ToFixedUnixTime(absl::Time t) { return t; }
+
+// A formatted time, in a buffer if possible, or else in a string.
+struct Formatted {
+  char buf[TimeFormat::kMaxDefaultSize];
+  absl::string_view view;
+  std::string str;
+
+  void Set(const std::string& s) {
+    str = s;
+    view = str;
+  }
+};
+
+// Formats a time in the Unix timescale.  If fast, the format is known to
+// satisfy IsFast().
+void FormatUnix(absl::Time t, const std::string& format, bool fast,
+                Formatted* out) {
+  if (fast) {
+    char* end = FormatFastPrefix(t, out->buf);
+    if (end != nullptr) {
+      absl::string_view tail =
+          absl::string_view(format).substr(kFastPrefix.size());
+      std::memcpy(end, tail.data(), tail.size());
+      out->view = absl::string_view(out->buf, end - out->buf + tail.size());
+      return;
+    }
+  }
+  out->Set(absl::FormatTime(format, t, absl::UTCTimeZone()));
+}
+
+template <internal::TtBasedTimescale timescale>
+void FormatTt(internal::TtBasedTime<timescale> t, const std::string& format,
+              bool fast, Formatted* out) {
+  if (t == t.InfiniteFuture()) {
+    out->Set(FutureName(t));
+  } else if (t == t.InfinitePast()) {
+    out->Set(PastName(t));
+  } else {
+    FormatUnix(ToUnixTime(t), format, fast, out);
+  }
+}
+
+// Writes the formatted time to buf as described for TimeFormat::FormatTo().
+size_t CopyTo(const Formatted& f, char* buf, size_t n) {
+  if (n > 0) {
+    const size_t size = std::min(f.view.size(), n - 1);
+    std::memcpy(buf, f.view.data(), size);
+    buf[size] = '\0';
+  }
+  return f.view.size();
+}
+
+// The inverses of ToUnixTime().
+template <typename T>
+T FromUnixTime(absl::Time t);
+template <>
+TaiTime FromUnixTime(absl::Time t) {
+  return TaiEpoch() +
+         internal::MakeDuration(t - absl::UnixEpoch() + 4383 * absl::Hours(24));
+}
+template <>
+GpsTime FromUnixTime(absl::Time t) {
+  return GpsEpoch() +
+         internal::MakeDuration(t - absl::UnixEpoch() - 3657 * absl::Hours(24));
+}
+
+// Parses a decimal number of exactly n digits.
+bool ParseDigits(const char* p, int n, int64_t* v) {
+  *v = 0;
+  for (int i = 0; i < n; ++i) {
+    if (p[i] < '0' || p[i] > '9') {
+      return false;
+    }
+    *v = *v * 10 + (p[i] - '0');
+  }
+  return true;
+}
+
+// Parses the time in kFastPrefix and the literal tail that follows it, which
+// must be the entire input.  Returns false if the input does not match exactly
+// or has out-of-range fields, in which case absl::ParseTime() can handle the
+// input or explain the error.
+bool ParseFast(absl::string_view input, absl::string_view tail,
+               absl::Time* t) {
+  // "2006-01-02 15:04:05", the shortest possible prefix.
+  constexpr size_t kMinSize = 19;
+  if (input.size() < kMinSize + tail.size()) {
+    return false;
+  }
+  const char* p = input.data();
+  int64_t year, month, day, hour, minute, second;
+  if (!ParseDigits(p, 4, &year) || p[4] != '-' ||
+      !ParseDigits(p + 5, 2, &month) || p[7] != '-' ||
+      !ParseDigits(p + 8, 2, &day) || p[10] != ' ' ||
+      !ParseDigits(p + 11, 2, &hour) || p[13] != ':' ||
+      !ParseDigits(p + 14, 2, &minute) || p[16] != ':' ||
+      !ParseDigits(p + 17, 2, &second)) {
+    return false;
+  }
+  if (month < 1 || month > 12 || day < 1 ||
+      day > internal::DaysInMonth(year, month) || hour > 23 || minute > 59 ||
+      second > 59) {
+    return false;
+  }
+
+  // The fraction has 1 to 9 digits, or is omitted with its decimal point.
+  absl::string_view rest = input.substr(kMinSize);
+  int64_t ns = 0;
+  if (rest.size() > tail.size() && rest[0] == '.') {
+    const size_t digits = rest.size() - tail.size() - 1;
+    if (digits < 1 || digits > 9 ||
+        !ParseDigits(rest.data() + 1, digits, &ns)) {
+      return false;
+    }
+    for (size_t i = digits; i < 9; ++i) {
+      ns *= 10;
+    }
+    rest.remove_prefix(digits + 1);
+  }
+  if (rest != tail) {
+    return false;
+  }
+
+  const int64_t days = internal::DaysFromCivil(year, month, day);
+  *t = absl::FromUnixSeconds(days * 86400 + hour * 3600 + minute * 60 +
+                             second) +
+       absl::Nanoseconds(ns);
+  return true;
+}
+
+// Parses a time in the Unix timescale, whose format has zone names already
+// substituted for %Z.  If fast, the format is known to satisfy IsFast().
+bool ParseUnix(const std::string& format, bool fast, absl::string_view input,
+               absl::Time* t, std::string* err) {
+  if (fast &&
+      ParseFast(input, absl::string_view(format).substr(kFastPrefix.size()),
+                t)) {
+    return true;
+  }
+  return absl::ParseTime(format, input, absl::UTCTimeZone(), t, err);
+}
+
+template <internal::TtBasedTimescale timescale>
+bool ParseTt(const std::string& format, bool fast, absl::string_view input,
+             internal::TtBasedTime<timescale>* t, std::string* err) {
+  using T = internal::TtBasedTime<timescale>;
+  if (input == FutureName(T())) {
+    *t = T::InfiniteFuture();
+    return true;
+  }
+  if (input == PastName(T())) {
+    *t = T::InfinitePast();
+    return true;
+  }
+  absl::Time u;
+  if (!ParseUnix(format, fast, input, &u, err)) {
+    return false;
+  }
+  if (u == absl::InfiniteFuture()) {
+    *t = T::InfiniteFuture();
+  } else if (u == absl::InfinitePast()) {
+    *t = T::InfinitePast();
+  } else {
+    *t = FromUnixTime<T>(u);
+  }
+  return true;
+}
+
+}  // namespace
+
+TimeFormat::TimeFormat() : TimeFormat(kDefaultFormat) {}
+
+TimeFormat::TimeFormat(absl::string_view format)
+    : utc_format_(ReplaceZone(format, "UTC")),
+      tai_format_(ReplaceZone(format, ZoneName(TaiTime()))),
+      gps_format_(ReplaceZone(format, ZoneName(GpsTime()))),
+      fast_(IsFast(utc_format_) && IsFast(tai_format_) &&
+            IsFast(gps_format_)) {}
+
+template <internal::TtBasedTimescale timescale>
+std::string TimeFormat::Format(internal::TtBasedTime<timescale> t) const {
+  Formatted f;
+  FormatTt(t, format(t), fast_, &f);
+  return f.str.empty() ? std::string(f.view) : std::move(f.str);
+}
+std::string TimeFormat::Format(absl::Time t) const {
+  Formatted f;
+  FormatUnix(t, format(t), fast_, &f);
+  return f.str.empty() ? std::string(f.view) : std::move(f.str);
+}
+
+template <internal::TtBasedTimescale timescale>
+void TimeFormat::AppendTo(internal::TtBasedTime<timescale> t,
+                          std::string* s) const {
+  Formatted f;
+  FormatTt(t, format(t), fast_, &f);
+  s->append(f.view.data(), f.view.size());
+}
+void TimeFormat::AppendTo(absl::Time t, std::string* s) const {
+  Formatted f;
+  FormatUnix(t, format(t), fast_, &f);
+  s->append(f.view.data(), f.view.size());
+}
+
+template <internal::TtBasedTimescale timescale>
+size_t TimeFormat::FormatTo(internal::TtBasedTime<timescale> t, char* buf,
+                            size_t n) const {
+  Formatted f;
+  FormatTt(t, format(t), fast_, &f);
+  return CopyTo(f, buf, n);
+}
+size_t TimeFormat::FormatTo(absl::Time t, char* buf, size_t n) const {
+  Formatted f;
+  FormatUnix(t, format(t), fast_, &f);
+  return CopyTo(f, buf, n);
+}
+
+template <internal::TtBasedTimescale timescale>
+bool TimeFormat::Parse(absl::string_view input,
+                       internal::TtBasedTime<timescale>* t,
+                       std::string* err) const {
+  return ParseTt(format(*t), fast_, input, t, err);
+}
+bool TimeFormat::Parse(absl::string_view input, absl::Time* t,
+                       std::string* err) const {
+  return ParseUnix(format(*t), fast_, input, t, err);
+}
+
+// Explicit instantiations.
+template std::string TimeFormat::Format(TaiTime t) const;
+template std::string TimeFormat::Format(GpsTime t) const;
+template void TimeFormat::AppendTo(TaiTime t, std::string* s) const;
+template void TimeFormat::AppendTo(GpsTime t, std::string* s) const;
+template size_t TimeFormat::FormatTo(TaiTime t, char* buf, size_t n) const;
+template size_t TimeFormat::FormatTo(GpsTime t, char* buf, size_t n) const;
+template bool TimeFormat::Parse(absl::string_view input, TaiTime* t,
+                                std::string* err) const;
+template bool TimeFormat::Parse(absl::string_view input, GpsTime* t,
+                                std::string* err) const;
+
+FixedWidthTimeFormat::FixedWidthTimeFormat(int fraction_digits)
+    : fraction_digits_(std::min(std::max(fraction_digits, 0), 9)),
+      width_(kFixedSecondsSize + (fraction_digits_ > 0) + fraction_digits_ +
+             1) {}
+
+template <typename Time>
+size_t FixedWidthTimeFormat::FormatAllImpl(absl::Span<const Time> times,
+                                           char* buf, size_t stride,
+                                           std::vector<bool>* valid) const {
+  if (valid != nullptr) {
+    valid->assign(times.size(), false);
+  }
+  const size_t width = this->width(Time());
+  const absl::string_view zone = FixedZoneName(Time());
+  // The day of the date in day_chars.
+  int64_t cached_days = std::numeric_limits<int64_t>::min();
+  char day_chars[11];
+  size_t count = 0;
+  for (size_t i = 0; i < times.size(); ++i) {
+    char* p = buf + i * stride;
+    const absl::Time u = ToFixedUnixTime(times[i]);
+    if (u < absl::FromUnixSeconds(kMinFixedDays * 86400) ||
+        u >= absl::FromUnixSeconds((kMaxFixedDays + 1) * 86400)) {
+      std::memset(p, ' ', width);
+      continue;
+    }
+    const auto days = internal::ToUnixDays(u);
+    if (days.first != cached_days) {
+      const internal::CivilDay day = internal::CivilFromDays(days.first);
+      WriteDigitPair(day.year / 100, day_chars);
+      WriteDigitPair(day.year % 100, day_chars + 2);
+      day_chars[4] = '-';
+      WriteDigitPair(day.month, day_chars + 5);
+      day_chars[7] = '-';
+      WriteDigitPair(day.day, day_chars + 8);
+      day_chars[10] = ' ';
+      cached_days = days.first;
+    }
+    std::memcpy(p, day_chars, sizeof(day_chars));
+    const int64_t second = days.second;
+    WriteDigitPair(second / 3600, p + 11);
+    p[13] = ':';
+    WriteDigitPair(second / 60 % 60, p + 14);
+    p[16] = ':';
+    WriteDigitPair(second % 60, p + 17);
+    char* q = p + kFixedSecondsSize;
+    if (fraction_digits_ > 0) {
+      // Subseconds are in [0, 1 s), so the conversion truncates.
+      char fraction[9];
+      WriteNineDigits(absl::ToInt64Nanoseconds(
+                          u - absl::FromUnixSeconds(days.first * 86400 +
+                                                    days.second)),
+                      fraction);
+      *q++ = '.';
+      std::memcpy(q, fraction, fraction_digits_);
+      q += fraction_digits_;
+    }
+    *q++ = ' ';
+    std::memcpy(q, zone.data(), zone.size());
+    if (valid != nullptr) {
+      (*valid)[i] = true;
+    }
+    ++count;
+  }
+  return count;
+}
+
+size_t FixedWidthTimeFormat::FormatAll(absl::Span<const TaiTime> times,
+                                       char* buf, size_t stride,
+                                       std::vector<bool>* valid) const {
+  return FormatAllImpl(times, buf, stride, valid);
+}
+size_t FixedWidthTimeFormat::FormatAll(absl::Span<const GpsTime> times,
+                                       char* buf, size_t stride,
+                                       std::vector<bool>* valid) const {
+  return FormatAllImpl(times, buf, stride, valid);
+}
+size_t FixedWidthTimeFormat::FormatAll(absl::Span<const absl::Time> times,
+                                       char* buf, size_t stride,
+                                       std::vector<bool>* valid) const {
+  return FormatAllImpl(times, buf, stride, valid);
+}
+
+template <internal::TtBasedTimescale timescale>
+std::string FormatTime(internal::TtBasedTime<timescale> t) {
+  return DefaultTimeFormat().Format(t);
+}
+// Explicit instantiation.
+template std::string FormatTime(internal::TtBasedTime<internal::TAI> t);
+template std::string FormatTime(internal::TtBasedTime<internal::GPST> t);
+
+template <internal::TtBasedTimescale timescale>
+std::string FormatTime(const std::string& format,
+                       internal::TtBasedTime<timescale> t) {
+  if (t == t.InfiniteFuture()) {
+    return FutureName(t);
+  }
+  if (t == t.InfinitePast()) {
+    return PastName(t);
+  }
+  return absl::FormatTime(ReplaceZone(format, ZoneName(t)), ToUnixTime(t),
+                          absl::UTCTimeZone());
 }
 // Explicit instantiation.
 template std::string FormatTime(const std::string& format,
@@ -139,9 +570,44 @@ template std::string FormatTime(const std::string& format,
 template std::string FormatTime(const std::string& format,
                                 internal::TtBasedTime<internal::GPST> t);
 
-std::string FormatTime(absl::Time t) { return FormatTime(DefaultFormat(t), t); }
+std::string FormatTime(absl::Time t) { return DefaultTimeFormat().Format(t); }
 std::string FormatTime(const std::string& format, absl::Time t) {
   return absl::FormatTime(format, t, absl::UTCTimeZone());
 }
 
+bool ParseTime(absl::string_view format, absl::string_view input, TaiTime* t,
+               std::string* err) {
+  const std::string f = ReplaceZone(format, ZoneName(*t));
+  return ParseTt(f, IsFast(f), input, t, err);
+}
+bool ParseTime(absl::string_view format, absl::string_view input, GpsTime* t,
+               std::string* err) {
+  const std::string f = ReplaceZone(format, ZoneName(*t));
+  return ParseTt(f, IsFast(f), input, t, err);
+}
+bool ParseTime(absl::string_view format, absl::string_view input,
+               absl::Time* t, std::string* err) {
+  const std::string f = ReplaceZone(format, "UTC");
+  return ParseUnix(f, IsFast(f), input, t, err);
+}
+
+bool ParseTime(absl::string_view input, TaiTime* t, std::string* err) {
+  return DefaultTimeFormat().Parse(input, t, err);
+}
+bool ParseTime(absl::string_view input, GpsTime* t, std::string* err) {
+  return DefaultTimeFormat().Parse(input, t, err);
+}
+bool ParseTime(absl::string_view input, absl::Time* t, std::string* err) {
+  return DefaultTimeFormat().Parse(input, t, err);
+}
+
+absl::optional<TaiTime> UnsmearString(const LeapTable& lt,
+                                      absl::string_view s) {
+  absl::Time utc;
+  if (!DefaultTimeFormat().Parse(s, &utc, nullptr)) {
+    return absl::nullopt;
+  }
+  return lt.Unsmear(utc);
+}
+
 }  // namespace unsmear
@@ -12,13 +12,26 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <string>
+#include <type_traits>
 
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
+#include "unsmear/civil_day.h"
+#include "unsmear/conversion_stats.h"
 #include "unsmear/unsmear.h"
 
 namespace unsmear {
@@ -53,10 +66,123 @@ int ToJdnInt(absl::Time t) {
 }
 }  // namespace
 
-absl::Time LeapTable::expiration() const { return entries_.front().utc; }
+// The day indexes of a LeapTable built at runtime, with room for more days.  A
+// table built by LeapTableBuilder has its own, and the tables extended from it
+// share them: each uses the days up to its expiration, and Extend() fills in
+// the days after them.  Days are never changed once filled in, so the tables
+// sharing them may be used while another is being extended.
+struct LeapTable::DayIndexes {
+  DayIndexes(size_t utc_capacity, size_t tai_capacity)
+      : utc(new uint32_t[utc_capacity]),
+        tai(new uint32_t[tai_capacity]),
+        utc_capacity(utc_capacity),
+        tai_capacity(tai_capacity) {}
+
+  std::unique_ptr<uint32_t[]> utc;
+  std::unique_ptr<uint32_t[]> tai;
+  size_t utc_capacity;
+  size_t tai_capacity;
+
+  // The number of UTC days filled in.  Only a table with this many days, and so
+  // with every day filled in, may fill in more, after claiming them by
+  // increasing this.
+  std::atomic<size_t> utc_days{0};
+};
+
+namespace {
+// Backing storage for the entries of a LeapTable constructed at runtime.
+struct LeapTableStorage {
+  std::vector<int64_t> utc_seconds;
+  std::vector<int64_t> tai_seconds;
+  std::vector<int8_t> smears;
+};
+
+// The starts of the first days of the day indexes, in seconds since the Unix
+// and TAI epochs: 1971-12-31 12:00:00 UTC and 1971-12-31 12:00:10 TAI.
+constexpr int64_t kUtcDayIndexStart = 63072000 - 43200;
+constexpr int64_t kTaiDayIndexStart = (5113 * 86400 + 10) - 43200;
+
+// Returns the numbers of days in the day indexes of a table with the given
+// expiration, in seconds since the Unix and TAI epochs.  Each UTC day ends by
+// the expiration, and there is a TAI day for the expiration itself.
+size_t UtcDays(int64_t utc_expiration) {
+  return (utc_expiration - kUtcDayIndexStart) / 86400;
+}
+size_t TaiDays(int64_t tai_expiration) {
+  return (tai_expiration - kTaiDayIndexStart) / 86400 + 1;
+}
+
+// Fills in the day indexes of a table with the given entries, from the given
+// days on.  The days before them must already be filled in.
+void IndexDays(const LeapTableStorage& storage, size_t utc_from,
+               size_t tai_from, uint32_t* utc_day_index,
+               uint32_t* tai_day_index) {
+  const auto& utc = storage.utc_seconds;
+  const auto& tai = storage.tai_seconds;
+  // Entries are indexed by their position from the smear epoch.
+  const size_t last = utc.size() - 1;
+
+  // Each UTC day is within the segment whose end is at or after the end of the
+  // day.
+  const size_t utc_days = UtcDays(utc.front());
+  size_t i = utc_from > 0 ? last - utc_day_index[utc_from - 1] : last - 1;
+  for (size_t day = utc_from; day < utc_days; ++day) {
+    while (utc[i] < kUtcDayIndexStart + static_cast<int64_t>(day + 1) * 86400) {
+      --i;
+    }
+    utc_day_index[day] = last - i;
+  }
+
+  // Each TAI day starts within the segment whose end is after the start of the
+  // day.
+  const size_t tai_days = TaiDays(tai.front());
+  i = tai_from > 0 ? last - tai_day_index[tai_from - 1] : last - 1;
+  for (size_t day = tai_from; day < tai_days; ++day) {
+    while (i > 0 &&
+           tai[i] <= kTaiDayIndexStart + static_cast<int64_t>(day) * 86400) {
+      --i;
+    }
+    tai_day_index[day] = last - i;
+  }
+}
+
+// Returns whether the Julian day, from noon to noon UTC, spans the end of a
+// month.
+bool SpansMonthEnd(int jdn) {
+  return internal::CivilFromDays(internal::ToUnixDays(JdnToTime(jdn + 1)).first)
+             .day == 1;
+}
+
+}  // namespace
+
+namespace internal {
+
+LeapTableData GetLeapTableData(const LeapTable& lt) { return lt.data_; }
+
+LeapTable LeapTableFromStaticData(LeapTableData data) {
+  return LeapTable(data, nullptr);
+}
+
+}  // namespace internal
+
+absl::Time LeapTable::expiration() const {
+  return absl::FromUnixSeconds(data_.utc_seconds.front());
+}
 
-std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
-  int end_jdn = proto.end_jdn();
+LeapTableBuilder::LeapTableBuilder(const LeapTable& lt)
+    : end_jdn_(ToJdnInt(lt.expiration()) - 1) {
+  for (size_t i = lt.size() - 1; i > 0; --i) {
+    const auto e = lt.entry(i);
+    if (e.smear == 1) {
+      positive_leaps_.push_back(ToJdnInt(e.utc) - 1);
+    } else if (e.smear == -1) {
+      negative_leaps_.push_back(ToJdnInt(e.utc) - 1);
+    }
+  }
+}
+
+std::unique_ptr<LeapTable> LeapTableBuilder::Build() const {
+  const int end_jdn = end_jdn_;
   if (end_jdn < kMinJdn || end_jdn > kMaxJdn) {
     LOG(ERROR) << absl::StrCat("Failed validating leap table: end_jdn ",
                                end_jdn, " was not in valid range (", kMinJdn,
@@ -66,7 +192,7 @@ std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
 
   // The expiration must be at the end of the month, immediately before what
   // might be the start of a leap smear.
-  absl::Time expiration = JdnToTime(proto.end_jdn() + 1);
+  absl::Time expiration = JdnToTime(end_jdn + 1);
   if (absl::ToTM(expiration + absl::Hours(24), absl::UTCTimeZone()).tm_mday !=
       1) {
     LOG(ERROR) << "Failed validating leap table: end_jdn must be at the end of "
@@ -76,10 +202,8 @@ std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
   }
 
   // We will have two entries for each leap second, plus one for each endpoint.
-  // We can't use make_unique here because of the private constructor.
-  std::unique_ptr<LeapTable> lt(new LeapTable(
-      (proto.positive_leaps_size() + proto.negative_leaps_size()) * 2 + 2));
-  auto& entries = lt->entries_;
+  std::vector<internal::LeapTableEntry> entries(
+      (positive_leaps_.size() + negative_leaps_.size()) * 2 + 2);
 
   entries.front().utc = expiration;
   entries.front().smear = 0;
@@ -88,7 +212,7 @@ std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
 
   // Fill in the leap table from the end, since that's the most expected order.
   size_t i = entries.size() - 2;
-  for (const auto& jdn : proto.positive_leaps()) {
+  for (int32_t jdn : positive_leaps_) {
     if (jdn < kMinJdn || jdn > kMaxJdn) {
       LOG(ERROR) << absl::StrCat("Failed validating leap table: positive leap ",
                                  jdn, " was not in valid range (", kMinJdn,
@@ -102,7 +226,7 @@ std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
     entries[i].smear = 1;
     --i;
   }
-  for (const auto& jdn : proto.negative_leaps()) {
+  for (int32_t jdn : negative_leaps_) {
     if (jdn < kMinJdn || jdn > kMaxJdn) {
       LOG(ERROR) << absl::StrCat("Failed validating leap table: negative leap ",
                                  jdn, " was not in valid range (", kMinJdn,
@@ -153,20 +277,236 @@ std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
         Seconds(entries[i].smear);
   }
 
-  return lt;
+  auto storage = std::make_shared<LeapTableStorage>();
+  for (const auto& e : entries) {
+    storage->utc_seconds.push_back(absl::ToUnixSeconds(e.utc));
+    storage->tai_seconds.push_back(
+        absl::ToInt64Seconds(internal::GetRep(e.tai - TaiEpoch())));
+    storage->smears.push_back(e.smear);
+  }
+  const size_t utc_days = UtcDays(storage->utc_seconds.front());
+  const size_t tai_days = TaiDays(storage->tai_seconds.front());
+  auto days = std::make_shared<LeapTable::DayIndexes>(utc_days, tai_days);
+  IndexDays(*storage, 0, 0, days->utc.get(), days->tai.get());
+  days->utc_days.store(utc_days, std::memory_order_relaxed);
+  internal::LeapTableData data = {
+      storage->utc_seconds, storage->tai_seconds, storage->smears,
+      absl::MakeConstSpan(days->utc.get(), utc_days),
+      absl::MakeConstSpan(days->tai.get(), tai_days)};
+
+  // We can't use make_unique here because of the private constructor.
+  return std::unique_ptr<LeapTable>(
+      new LeapTable(data, std::move(storage), std::move(days)));
 }
 
-void LeapTable::ToProto(LeapTableProto* proto) const {
-  proto->Clear();
-  for (size_t i = entries_.size() - 1; i > 0; --i) {
-    const auto& entry = entries_[i];
-    if (entry.smear == 1) {
-      proto->add_positive_leaps(ToJdnInt(entry.utc) - 1);
-    } else if (entry.smear == -1) {
-      proto->add_negative_leaps(ToJdnInt(entry.utc) - 1);
+namespace {
+
+// The flat format is a FlatHeader followed by the arrays of LeapTableData in
+// this order: utc_seconds, tai_seconds, utc_day_index, tai_day_index, smears.
+// It is padded with zeros to a multiple of 8 bytes.  Every field is in the byte
+// order of the machine that wrote it; the other byte order fails the version
+// check.
+struct FlatHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t size;      // The number of entries.
+  uint32_t utc_days;  // The size of utc_day_index.
+  uint32_t tai_days;  // The size of tai_day_index.
+  uint64_t checksum;  // Checksum() of everything after the header.
+};
+static_assert(sizeof(FlatHeader) == 32, "FlatHeader must not be padded");
+
+constexpr char kFlatMagic[8] = "UNSMEAR";
+// Version 2 gives day indexes as positions from the smear epoch.
+constexpr uint32_t kFlatVersion = 2;
+
+size_t FlatSize(const FlatHeader& h) {
+  size_t size = sizeof(FlatHeader) + h.size * (2 * sizeof(int64_t) + 1) +
+                (size_t{h.utc_days} + h.tai_days) * sizeof(uint32_t);
+  return (size + 7) & ~size_t{7};
+}
+
+// Returns FNV-1a of the 64-bit words of s, whose size must be a multiple of 8,
+// computed in four interleaved lanes so that the multiplications overlap.  Any
+// change to a single word changes the checksum.
+uint64_t Checksum(absl::string_view s) {
+  constexpr uint64_t kBasis = 0xcbf29ce484222325;
+  constexpr uint64_t kPrime = 0x100000001b3;
+  assert(s.size() % 8 == 0);
+  auto word = [&s](size_t i) {
+    uint64_t w;
+    std::memcpy(&w, s.data() + i * 8, 8);
+    return w;
+  };
+  uint64_t a = kBasis, b = kBasis, c = kBasis, d = kBasis;
+  const size_t words = s.size() / 8;
+  size_t i = 0;
+  for (; i + 4 <= words; i += 4) {
+    a = (a ^ word(i)) * kPrime;
+    b = (b ^ word(i + 1)) * kPrime;
+    c = (c ^ word(i + 2)) * kPrime;
+    d = (d ^ word(i + 3)) * kPrime;
+  }
+  for (; i < words; ++i) {
+    a = (a ^ word(i)) * kPrime;
+  }
+  uint64_t hash = kBasis;
+  for (uint64_t lane : {a, b, c, d}) {
+    hash = (hash ^ lane) * kPrime;
+  }
+  return hash;
+}
+
+template <typename T>
+void AppendArray(absl::Span<const T> array, std::string* s) {
+  s->append(reinterpret_cast<const char*>(array.data()),
+            array.size() * sizeof(T));
+}
+
+template <typename T>
+absl::Span<const T> ConsumeArray(size_t size, const char** p) {
+  absl::Span<const T> array(reinterpret_cast<const T*>(*p), size);
+  *p += size * sizeof(T);
+  return array;
+}
+
+// Returns a view of flat leap table data, if it is valid.  The checks are
+// enough for the table to be safe to use, but not to detect every error; the
+// checksum is relied on for that, since the data was validated when it was
+// written.
+absl::optional<internal::LeapTableData> ViewFlat(absl::string_view flat) {
+  FlatHeader h;
+  if (flat.size() < sizeof(h)) {
+    LOG(ERROR) << "Failed validating flat leap table: too short";
+    return absl::nullopt;
+  }
+  std::memcpy(&h, flat.data(), sizeof(h));
+  if (std::memcmp(h.magic, kFlatMagic, sizeof(kFlatMagic)) != 0) {
+    LOG(ERROR) << "Failed validating flat leap table: not a flat leap table";
+    return absl::nullopt;
+  }
+  if (h.version != kFlatVersion) {
+    LOG(ERROR) << "Failed validating flat leap table: unsupported version "
+               << h.version;
+    return absl::nullopt;
+  }
+  if (reinterpret_cast<uintptr_t>(flat.data()) % 8 != 0) {
+    LOG(ERROR) << "Failed validating flat leap table: not 8-byte aligned";
+    return absl::nullopt;
+  }
+  if (h.size < 2 || flat.size() != FlatSize(h)) {
+    LOG(ERROR) << "Failed validating flat leap table: wrong size";
+    return absl::nullopt;
+  }
+  if (Checksum(flat.substr(sizeof(h))) != h.checksum) {
+    LOG(ERROR) << "Failed validating flat leap table: checksum mismatch";
+    return absl::nullopt;
+  }
+
+  const char* p = flat.data() + sizeof(h);
+  internal::LeapTableData data;
+  data.utc_seconds = ConsumeArray<int64_t>(h.size, &p);
+  data.tai_seconds = ConsumeArray<int64_t>(h.size, &p);
+  data.utc_day_index = ConsumeArray<uint32_t>(h.utc_days, &p);
+  data.tai_day_index = ConsumeArray<uint32_t>(h.tai_days, &p);
+  data.smears = ConsumeArray<int8_t>(h.size, &p);
+
+  // Check the invariants that conversions rely on.
+  const size_t last = h.size - 1;
+  bool valid =
+      data.utc_seconds[last] == absl::ToUnixSeconds(ModernUtcEpoch()) &&
+      data.tai_seconds[last] ==
+          absl::ToInt64Seconds(
+              internal::GetRep(TaiModernUtcEpoch() - TaiEpoch())) &&
+      data.smears[0] == 0 && data.smears[last] == 0;
+  for (size_t i = 0; valid && i < last; ++i) {
+    valid = data.utc_seconds[i] > data.utc_seconds[i + 1] &&
+            data.smears[i] >= -1 && data.smears[i] <= 1 &&
+            data.tai_seconds[i] - data.tai_seconds[i + 1] ==
+                data.utc_seconds[i] - data.utc_seconds[i + 1] + data.smears[i];
+  }
+  valid = valid && h.utc_days == UtcDays(data.utc_seconds[0]) &&
+          h.tai_days == TaiDays(data.tai_seconds[0]);
+  // Day indexes are positions from the smear epoch of entries at the ends of
+  // segments, so not of the epoch itself.
+  uint32_t min_index = last;
+  uint32_t max_index = 0;
+  for (absl::Span<const uint32_t> index :
+       {data.utc_day_index, data.tai_day_index}) {
+    for (uint32_t i : index) {
+      min_index = std::min(min_index, i);
+      max_index = std::max(max_index, i);
     }
   }
-  proto->set_end_jdn(ToJdnInt(entries_[0].utc) - 1);
+  valid = valid && min_index > 0 && max_index <= last;
+  if (!valid) {
+    LOG(ERROR) << "Failed validating flat leap table: inconsistent entries";
+    return absl::nullopt;
+  }
+  return data;
+}
+
+}  // namespace
+
+void LeapTable::ToFlat(std::string* flat) const {
+  FlatHeader h;
+  std::memcpy(h.magic, kFlatMagic, sizeof(kFlatMagic));
+  h.version = kFlatVersion;
+  h.size = size();
+  h.utc_days = data_.utc_day_index.size();
+  h.tai_days = data_.tai_day_index.size();
+  h.checksum = 0;
+
+  flat->assign(sizeof(h), '\0');
+  AppendArray(data_.utc_seconds, flat);
+  AppendArray(data_.tai_seconds, flat);
+  AppendArray(data_.utc_day_index, flat);
+  AppendArray(data_.tai_day_index, flat);
+  AppendArray(data_.smears, flat);
+  flat->resize(FlatSize(h), '\0');
+  h.checksum = Checksum(absl::string_view(*flat).substr(sizeof(h)));
+  std::memcpy(&(*flat)[0], &h, sizeof(h));
+}
+
+std::unique_ptr<LeapTable> NewLeapTableFromFlat(absl::string_view flat) {
+  auto data = ViewFlat(flat);
+  if (!data.has_value()) {
+    return nullptr;
+  }
+  return std::unique_ptr<LeapTable>(new LeapTable(*data, nullptr));
+}
+
+std::unique_ptr<LeapTable> NewLeapTableFromFlatFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed opening flat leap table " << path << ": "
+               << std::strerror(errno);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    LOG(ERROR) << "Failed reading flat leap table " << path << ": "
+               << std::strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  const size_t size = st.st_size;
+  void* addr = size == 0 ? MAP_FAILED
+                         : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Failed mapping flat leap table " << path;
+    return nullptr;
+  }
+  std::shared_ptr<const void> mapping(
+      addr, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+
+  auto data =
+      ViewFlat(absl::string_view(static_cast<const char*>(addr), size));
+  if (!data.has_value()) {
+    return nullptr;
+  }
+  return std::unique_ptr<LeapTable>(new LeapTable(*data, std::move(mapping)));
 }
 
 std::string LeapTable::DebugString() const {
@@ -174,10 +514,11 @@ std::string LeapTable::DebugString() const {
                                ::unsmear::FormatTime(expiration()), "\n");
 
   int tai_utc = 10;
-  for (const auto& e : entries_) {
-    tai_utc += e.smear;
+  for (int smear : data_.smears) {
+    tai_utc += smear;
   }
-  for (const auto& e : entries_) {
+  for (size_t i = 0; i < size(); ++i) {
+    const auto e = entry(i);
     absl::SubstituteAndAppend(&s, "  $0  $1  smear $2  TAI-UTC $3\n",
                               ::unsmear::FormatTime(e.utc), FormatTime(e.tai),
                               e.smear, tai_utc);
@@ -188,30 +529,41 @@ std::string LeapTable::DebugString() const {
 }
 
 bool LeapTable::operator==(const LeapTable& other) const {
-  if (entries_.size() != other.entries_.size()) {
-    return false;
-  }
-  for (size_t i = 0; i < entries_.size(); ++i) {
-    if (entries_[i].utc != other.entries_[i].utc ||
-        entries_[i].tai != other.entries_[i].tai ||
-        entries_[i].smear != other.entries_[i].smear) {
-      return false;
-    }
-  }
-  return true;
+  return data_.utc_seconds == other.data_.utc_seconds &&
+         data_.tai_seconds == other.data_.tai_seconds &&
+         data_.smears == other.data_.smears;
 }
 
 namespace {
 
+// Returns the whole seconds since the TAI epoch of a time no earlier than the
+// start of modern UTC, such as any time in the precise range of a table or
+// past its expiration, as the day indexes take them.  Such times are after
+// the TAI epoch, so truncation to whole seconds is also flooring.
+int64_t TaiSeconds(TaiTime tai) {
+  assert(tai >= TaiModernUtcEpoch());
+  return absl::ToInt64Seconds(internal::GetRep(tai - TaiEpoch()));
+}
+
+// Within a smear, 86400 + e.smear TAI seconds map linearly onto 86400 UTC
+// seconds.  The two Interpolate() functions below compute that map in whole
+// nanoseconds before the end of the smear, with any sub-nanosecond remainder
+// carried through unscaled.  They round in opposite directions, so that
+// whichever direction is one-to-one (unsmearing for positive leaps, smearing
+// for negative leaps) is exactly inverted by the other.
+
 absl::Time Interpolate(const internal::LeapTableEntry& e, TaiTime tai) {
   Duration d = e.tai - tai;
   assert(d >= ZeroDuration());
   absl::Time t = e.utc - internal::GetRep(d);
   if (e.smear != 0) {
-    double s = FDivDuration(d, Hours(24) + Seconds(e.smear));
-    assert(s >= 0);
-    assert(s <= 1);
-    t += s * absl::Seconds(e.smear);
+    int64_t ns = absl::ToInt64Nanoseconds(internal::GetRep(d));
+    assert(ns <= (86400 + 1) * int64_t{1000000000});
+    if (e.smear > 0) {
+      t += absl::Nanoseconds(ns / (86400 + 1));
+    } else {
+      t -= absl::Nanoseconds(ns / (86400 - 1));
+    }
   }
   return t;
 }
@@ -221,52 +573,26 @@ TaiTime Interpolate(const internal::LeapTableEntry& e, absl::Time utc) {
   assert(d >= absl::ZeroDuration());
   TaiTime t = e.tai - internal::MakeDuration(d);
   if (e.smear != 0) {
-    double s = absl::FDivDuration(d, absl::Hours(24));
-    assert(s >= 0);
-    assert(s <= 1);
-    t -= s * Seconds(e.smear);
+    int64_t ns = absl::ToInt64Nanoseconds(d);
+    assert(ns <= 86400 * int64_t{1000000000});
+    if (e.smear > 0) {
+      t -= Nanoseconds(ns / 86400);
+    } else {
+      t += Nanoseconds(ns / 86400);
+    }
   }
   return t;
 }
 
-// Returns true if t is within twelve hours before the end of the month.
-bool IsJustBeforeMonthEnd(const struct tm& t) {
-  if (t.tm_hour < 12) {
-    return false;
-  }
-  assert(t.tm_mon >= 0 && t.tm_mon <= 11);
-  switch (t.tm_mon) {
-    case 0:
-      return t.tm_mday == 31;
-    case 1:
-      if (t.tm_year % 4 == 0 &&
-          (t.tm_year % 100 != 0 || t.tm_year % 400 == 0)) {
-        return t.tm_mday == 29;
-      } else {
-        return t.tm_mday == 28;
-      }
-    case 2:
-      return t.tm_mday == 31;
-    case 3:
-      return t.tm_mday == 30;
-    case 4:
-      return t.tm_mday == 31;
-    case 5:
-      return t.tm_mday == 30;
-    case 6:
-      return t.tm_mday == 31;
-    case 7:
-      return t.tm_mday == 31;
-    case 8:
-      return t.tm_mday == 30;
-    case 9:
-      return t.tm_mday == 31;
-    case 10:
-      return t.tm_mday == 30;
-    case 11:
-      return t.tm_mday == 31;
-  }
-  return false;  // unreachable
+// Returns an absl::Time at UTC noon of a day since the Unix epoch.
+absl::Time UnixDayNoon(int64_t days) {
+  return absl::FromUnixSeconds(days * 86400 + 43200);
+}
+
+// Counts a precise conversion in the segment ending at e.
+void CountPrecise(const internal::LeapTableEntry& e) {
+  internal::CountConversion(e.smear != 0 ? internal::ConversionPath::kSmear
+                                         : internal::ConversionPath::kPrecise);
 }
 
 // Advances a leap table entry into the future, returning hypothetical leap
@@ -276,40 +602,35 @@ std::pair<internal::LeapTableEntry, internal::LeapTableEntry> Advance(
   assert(t > e.utc);
   assert(e.smear == 0);
 
-  struct tm e_tm = absl::ToTM(e.utc, absl::UTCTimeZone());
-  struct tm t_tm = absl::ToTM(t, absl::UTCTimeZone());
+  const internal::CivilDay e_day =
+      internal::CivilFromDays(internal::ToUnixDays(e.utc).first);
+  const auto t_days = internal::ToUnixDays(t);
+  const internal::CivilDay t_day = internal::CivilFromDays(t_days.first);
+  const bool afternoon = t_days.second >= 43200;
 
-  int leaps = (t_tm.tm_year - e_tm.tm_year) * 12 + (t_tm.tm_mon - e_tm.tm_mon);
-
-  int year = t_tm.tm_year + 1900;
-  int month = t_tm.tm_mon + 1;
-  int day = t_tm.tm_mday;
+  int64_t leaps = (t_day.year - e_day.year) * 12 + (t_day.month - e_day.month);
 
   // Construct two entries, one if all upcoming leap seconds are negative and
   // one if all upcoming leap seconds are positive.
   internal::LeapTableEntry neg;
   internal::LeapTableEntry pos;
-  if (IsJustBeforeMonthEnd(t_tm)) {
+  if (afternoon && internal::CivilFromDays(t_days.first + 1).day == 1) {
     // t is within the first half of a possible smear period.  It ends at noon
     // on the following day, the first day of a new month.
     ++leaps;
-    neg.utc = absl::FromDateTime(month == 12 ? year + 1 : year,
-                                 month == 12 ? 1 : month + 1, 1, 12, 0, 0,
-                                 absl::UTCTimeZone());
+    neg.utc = UnixDayNoon(t_days.first + 1);
     neg.smear = -1;
     pos.smear = 1;
-  } else if (day == 1 && t_tm.tm_hour < 12) {
+  } else if (t_day.day == 1 && !afternoon) {
     // t is within the second half of a possible smear period.  It ends at noon
     // on the current day.
-    neg.utc =
-        absl::FromDateTime(year, month, day, 12, 0, 0, absl::UTCTimeZone());
+    neg.utc = UnixDayNoon(t_days.first);
     neg.smear = -1;
     pos.smear = 1;
   } else {
     // t is not within a smear period.  We can set expiration at noon on the
     // following day, which we know to be within the current month.
-    neg.utc =
-        absl::FromDateTime(year, month, day + 1, 12, 0, 0, absl::UTCTimeZone());
+    neg.utc = UnixDayNoon(t_days.first + 1);
     neg.smear = 0;
     pos.smear = 0;
   }
@@ -320,8 +641,78 @@ std::pair<internal::LeapTableEntry, internal::LeapTableEntry> Advance(
   return {neg, pos};
 }
 
+// Returns the smeared time of tai, after the expiration e, if every possible
+// leap second after e is positive, or if every one is negative.
+absl::Time SmearFuture(const internal::LeapTableEntry& e, TaiTime tai,
+                       bool positive) {
+  auto segment = [&e, positive](absl::Time utc) {
+    auto advanced = Advance(e, utc);
+    return positive ? advanced.second : advanced.first;
+  };
+  // The hypothetical leap seconds put the smeared time up to a second per
+  // month from this estimate.  Since smeared time runs at nearly the rate of
+  // TAI, each step from the segment at the estimate corrects all but a
+  // fraction of a second per day of its error, so at most a few steps find
+  // the segment of the smeared time.
+  absl::Time utc = e.utc + internal::GetRep(tai - e.tai);
+  internal::LeapTableEntry s = segment(utc);
+  for (int i = 0; i < 4; ++i) {
+    const absl::Duration step = internal::GetRep(tai - Interpolate(s, utc));
+    if (step == absl::ZeroDuration()) break;
+    utc = std::max(utc + step, e.utc + absl::Nanoseconds(1));
+    s = segment(utc);
+  }
+  // Interpolation rounds, so tai may be just past the end of the segment.
+  if (tai > s.tai) {
+    s = segment(s.utc + absl::Nanoseconds(1));
+  }
+  return Interpolate(s, tai);
+}
+
 }  // namespace
 
+// The hypothetical segments after the expiration of a leap table, if every
+// possible leap second is negative and if every one is positive, as Advance()
+// computes them.  Each month has a segment ending at the start of its possible
+// smear, at noon on its last day, and one ending at the end of the smear.
+struct LeapTable::FutureHorizon {
+  // The entries at the ends of the segments, earliest first.  The first
+  // segment is the smear starting at the expiration.
+  struct Segments {
+    std::vector<internal::LeapTableEntry> entries;
+    // The index of the segment containing the start of each 86,400-second day
+    // of TAI since the expiration.
+    std::vector<uint32_t> tai_day_index;
+  };
+  Segments negative;
+  Segments positive;
+
+  // The expiration, in seconds since the Unix epoch and in TAI.
+  int64_t utc_begin;
+  TaiTime tai_begin;
+
+  // The index of the segment containing each day since the expiration, from
+  // noon to noon UTC.  Since segments end at noon, this is the same for both.
+  std::vector<uint32_t> utc_day_index;
+
+  // Returns the entry at the end of the segment containing the time, which
+  // must be after the expiration and within the horizon.
+  const internal::LeapTableEntry& Find(const Segments& segments,
+                                       absl::Time utc) const {
+    return segments.entries[utc_day_index[(absl::ToUnixSeconds(utc) -
+                                           utc_begin) / 86400]];
+  }
+  const internal::LeapTableEntry& Find(const Segments& segments,
+                                       TaiTime tai) const {
+    // The expiration is a whole second of TAI.
+    const int64_t day = (TaiSeconds(tai) - TaiSeconds(tai_begin)) / 86400;
+    size_t i = segments.tai_day_index[day];
+    while (segments.entries[i].tai < tai) ++i;
+    return segments.entries[i];
+  }
+};
+
+
 template <internal::TtBasedTimescale timescale>
 absl::optional<absl::Time> LeapTable::Smear(
     internal::TtBasedTime<timescale> t) const {
@@ -348,40 +739,139 @@ absl::optional<GpsTime> LeapTable::UnsmearToGps(absl::Time utc) const {
   return interval.first;
 }
 
+LeapTable::PreciseBounds LeapTable::PreciseRange() const {
+  const auto expiration = entry(0);
+  PreciseBounds b;
+  b.utc_begin = ModernUtcEpoch();
+  b.utc_end = expiration.utc;
+  b.tai_begin = TaiModernUtcEpoch();
+  b.tai_end = expiration.tai;
+  b.gps_begin = GpsEpoch();
+  b.gps_end = ToGpsTime(expiration.tai);
+  return b;
+}
+
+template <internal::TtBasedTimescale timescale>
+absl::Time LeapTable::SmearUnchecked(internal::TtBasedTime<timescale> t) const {
+  assert(t >= internal::TtBasedTime<timescale>());
+  const TaiTime tai = ToTaiTime(t);
+  assert(tai >= TaiModernUtcEpoch() && tai <= entry(0).tai);
+  const size_t i = TaiSegmentEnd(TaiSeconds(tai));
+  CountPrecise(entry(i));
+  return Interpolate(entry(i), tai);
+}
+
+template absl::Time LeapTable::SmearUnchecked(TaiTime t) const;
+template absl::Time LeapTable::SmearUnchecked(GpsTime t) const;
+
+TaiTime LeapTable::UnsmearUnchecked(absl::Time utc) const {
+  assert(utc >= ModernUtcEpoch() && utc <= expiration());
+  const size_t i = UtcSegmentEnd(absl::ToUnixSeconds(utc));
+  CountPrecise(entry(i));
+  return Interpolate(entry(i), utc);
+}
+
+GpsTime LeapTable::UnsmearToGpsUnchecked(absl::Time utc) const {
+  assert(utc >= UtcGpsEpoch());
+  return ToGpsTime(UnsmearUnchecked(utc));
+}
+
+absl::optional<Duration> LeapTable::ElapsedTT(absl::Time a,
+                                              absl::Time b) const {
+  size_t hint = 0;
+  return ElapsedTTNear(&hint, a, b);
+}
+
+absl::optional<Duration> LeapTable::ElapsedTTNear(size_t* hint, absl::Time a,
+                                                  absl::Time b) const {
+  const absl::Time utc_end = expiration();
+  if (a < ModernUtcEpoch() || a > utc_end || b < ModernUtcEpoch() ||
+      b > utc_end) {
+    const auto tai_a = Unsmear(a);
+    const auto tai_b = Unsmear(b);
+    if (!tai_a.has_value() || !tai_b.has_value()) {
+      return absl::nullopt;
+    }
+    return *tai_b - *tai_a;
+  }
+  size_t i = *hint;
+  if (a < entry(i + 1).utc || a > entry(i).utc) {
+    i = UtcSegmentEnd(absl::ToUnixSeconds(a));
+    *hint = i;
+  }
+  const auto end_a = entry(i);
+  CountPrecise(end_a);
+  if (b >= entry(i + 1).utc && b <= end_a.utc) {
+    CountPrecise(end_a);
+    if (end_a.smear == 0) {
+      return internal::MakeDuration(b - a);
+    }
+    return Interpolate(end_a, b) - Interpolate(end_a, a);
+  }
+  const auto end_b = entry(UtcSegmentEnd(absl::ToUnixSeconds(b)));
+  CountPrecise(end_b);
+  return Interpolate(end_b, b) - Interpolate(end_a, a);
+}
+
+std::pair<Duration, Duration> LeapTable::FutureProofElapsedTT(
+    absl::Time a, absl::Time b) const {
+  const auto tai_a = FutureProofUnsmear(a);
+  const auto tai_b = FutureProofUnsmear(b);
+  for (TaiTime t : {tai_a.first, tai_a.second, tai_b.first, tai_b.second}) {
+    if (t == TaiInfiniteFuture() || t == TaiInfinitePast()) {
+      return {-InfiniteDuration(), InfiniteDuration()};
+    }
+  }
+  // Leap seconds before a shift both times alike, so the elapsed time is
+  // extreme when those between a and b are all negative or all positive.
+  const Duration negative = tai_b.first - tai_a.first;
+  const Duration positive = tai_b.second - tai_a.second;
+  return {std::min(negative, positive), std::max(negative, positive)};
+}
+
 template <internal::TtBasedTimescale timescale>
 std::pair<absl::Time, absl::Time> LeapTable::FutureProofSmear(
     internal::TtBasedTime<timescale> t) const {
+  using internal::ConversionPath;
+  using internal::CountConversion;
   if (t == internal::TtBasedTime<timescale>::InfiniteFuture()) {
+    CountConversion(ConversionPath::kInfinite);
     return {absl::InfiniteFuture(), absl::InfiniteFuture()};
   }
   if (t == internal::TtBasedTime<timescale>::InfinitePast()) {
+    CountConversion(ConversionPath::kInfinite);
     return {absl::InfinitePast(), absl::InfinitePast()};
   }
 
   // If the time is before its own epoch, we cannot convert it.
   if (t < internal::TtBasedTime<timescale>()) {
+    CountConversion(ConversionPath::kBeforeEpoch);
     return {absl::InfinitePast(), absl::InfiniteFuture()};
   }
 
   // If the time is within the current leap table, we can convert it precisely.
   TaiTime tai = ToTaiTime(t);
-  const auto& expiration = entries_.front();
+  const auto expiration = entry(0);
   if (tai <= expiration.tai) {
-    size_t i;
-    for (i = 1; i < entries_.size(); ++i) {
-      if (tai >= entries_[i].tai) break;
-    }
-    if (i == entries_.size()) {
-      // We ran past the smear epoch.  The time is not convertible.
+    if (tai < TaiModernUtcEpoch()) {
+      // The time is before the smear epoch, and not convertible.
+      CountConversion(ConversionPath::kBeforeEpoch);
       return {absl::InfinitePast(), absl::InfiniteFuture()};
     }
-    absl::Time smeared = Interpolate(entries_[i - 1], tai);
+    size_t i = TaiSegmentEnd(TaiSeconds(tai));
+    CountPrecise(entry(i));
+    absl::Time smeared = Interpolate(entry(i), tai);
     return {smeared, smeared};
   }
 
-  auto advanced = Advance(
-      expiration, expiration.utc + internal::GetRep(tai - expiration.tai));
-  return {Interpolate(advanced.second, tai), Interpolate(advanced.first, tai)};
+  CountConversion(ConversionPath::kFuture);
+  if (horizon_ != nullptr && tai <= horizon_->negative.entries.back().tai) {
+    // The negative segments end earlier in TAI.
+    return {Interpolate(horizon_->Find(horizon_->positive, tai), tai),
+            Interpolate(horizon_->Find(horizon_->negative, tai), tai)};
+  }
+  return {SmearFuture(expiration, tai, true),
+          SmearFuture(expiration, tai, false)};
 }
 
 // Explicit instantiations:
@@ -394,40 +884,55 @@ template std::pair<absl::Time, absl::Time> LeapTable::FutureProofSmear(
 
 std::pair<TaiTime, TaiTime> LeapTable::FutureProofUnsmear(
     absl::Time utc) const {
+  using internal::ConversionPath;
+  using internal::CountConversion;
   if (utc == absl::InfiniteFuture()) {
+    CountConversion(ConversionPath::kInfinite);
     return {TaiInfiniteFuture(), TaiInfiniteFuture()};
   }
   if (utc == absl::InfinitePast()) {
+    CountConversion(ConversionPath::kInfinite);
     return {TaiInfinitePast(), TaiInfinitePast()};
   }
 
   // If the time is within the current leap table, we can convert it precisely.
-  const auto& expiration = entries_.front();
+  const auto expiration = entry(0);
   if (utc <= expiration.utc) {
-    size_t i;
-    for (i = 1; i < entries_.size(); ++i) {
-      if (utc >= entries_[i].utc) break;
-    }
-    if (i == entries_.size()) {
-      // We ran past the smear epoch.  The time is not convertible.
+    if (utc < ModernUtcEpoch()) {
+      // The time is before the smear epoch, and not convertible.
+      CountConversion(ConversionPath::kBeforeEpoch);
       return {TaiInfinitePast(), TaiInfiniteFuture()};
     }
-    TaiTime unsmeared = Interpolate(entries_[i - 1], utc);
+    size_t i = UtcSegmentEnd(absl::ToUnixSeconds(utc));
+    CountPrecise(entry(i));
+    TaiTime unsmeared = Interpolate(entry(i), utc);
     return {unsmeared, unsmeared};
   }
 
-  auto advanced = Advance(entries_.front(), utc);
+  CountConversion(ConversionPath::kFuture);
+  if (horizon_ != nullptr && utc <= horizon_->negative.entries.back().utc) {
+    return {Interpolate(horizon_->Find(horizon_->negative, utc), utc),
+            Interpolate(horizon_->Find(horizon_->positive, utc), utc)};
+  }
+  auto advanced = Advance(expiration, utc);
   return {Interpolate(advanced.first, utc), Interpolate(advanced.second, utc)};
 }
 
 std::pair<GpsTime, GpsTime> LeapTable::FutureProofUnsmearToGps(
     absl::Time utc) const {
   if (utc == absl::InfiniteFuture()) {
+    internal::CountConversion(internal::ConversionPath::kInfinite);
     return {GpsInfiniteFuture(), GpsInfiniteFuture()};
   }
   if (utc == absl::InfinitePast()) {
+    internal::CountConversion(internal::ConversionPath::kInfinite);
     return {GpsInfinitePast(), GpsInfinitePast()};
   }
+  if (utc < UtcGpsEpoch()) {
+    // Checked here so that the conversion is counted once.
+    internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+    return {GpsInfinitePast(), GpsInfiniteFuture()};
+  }
   auto unsmeared = FutureProofUnsmear(utc);
   if (unsmeared.first < ToTaiTime(GpsEpoch())) {
     // It's not valid to unsmear times before the GPST epoch.
@@ -437,4 +942,981 @@ std::pair<GpsTime, GpsTime> LeapTable::FutureProofUnsmearToGps(
   return {ToGpsTime(unsmeared.first), ToGpsTime(unsmeared.second)};
 }
 
+std::unique_ptr<LeapTable> LeapTable::WithFutureHorizon(
+    absl::Time until) const {
+  if (until > JdnToTime(kMaxJdn + 1)) {
+    LOG(ERROR) << "Future horizon " << until
+               << " is after the latest accepted expiration";
+    return nullptr;
+  }
+  auto lt = absl::make_unique<LeapTable>(*this);
+  lt->horizon_ = nullptr;
+  if (until <= expiration()) {
+    return lt;
+  }
+
+  // The expiration is at noon on the last day of a month, the start of its
+  // possible smear.  Add the end of that smear, and the start of the next
+  // month's, for each month until the horizon.
+  auto horizon = std::make_shared<FutureHorizon>();
+  horizon->utc_begin = absl::ToUnixSeconds(expiration());
+  horizon->tai_begin = entry(0).tai;
+  int64_t last_day = internal::ToUnixDays(expiration()).first;
+  while (UnixDayNoon(last_day) < until) {
+    const internal::CivilDay next = internal::CivilFromDays(last_day + 1);
+    const int days = internal::DaysInMonth(next.year, next.month);
+    for (int smear : {-1, 1}) {
+      auto& entries =
+          smear < 0 ? horizon->negative.entries : horizon->positive.entries;
+      const TaiTime tai =
+          entries.empty() ? horizon->tai_begin : entries.back().tai;
+      entries.push_back(
+          {UnixDayNoon(last_day + 1), tai + Hours(24) + Seconds(smear), smear});
+      entries.push_back({UnixDayNoon(last_day + days),
+                         entries.back().tai + (days - 1) * Hours(24), 0});
+    }
+    // The smear is the first day, and the rest of the month is the second.
+    const uint32_t smear = horizon->negative.entries.size() - 2;
+    horizon->utc_day_index.push_back(smear);
+    horizon->utc_day_index.insert(horizon->utc_day_index.end(), days - 1,
+                                  smear + 1);
+    last_day += days;
+  }
+  // The end of the horizon is in the last day.
+  horizon->utc_day_index.push_back(horizon->negative.entries.size() - 1);
+
+  for (auto* segments : {&horizon->negative, &horizon->positive}) {
+    const auto& entries = segments->entries;
+    size_t i = 0;
+    for (TaiTime day = horizon->tai_begin; day <= entries.back().tai;
+         day += Hours(24)) {
+      while (entries[i].tai < day) ++i;
+      segments->tai_day_index.push_back(i);
+    }
+  }
+  lt->horizon_ = std::move(horizon);
+  return lt;
+}
+
+std::unique_ptr<LeapTable> LeapTable::Extend(int32_t end_jdn) const {
+  return Extend(end_jdn, 0, 0);
+}
+
+std::unique_ptr<LeapTable> LeapTable::Extend(int32_t end_jdn, int32_t leap_jdn,
+                                             int sign) const {
+  const absl::Time old_expiration = expiration();
+  const absl::Time new_expiration = JdnToTime(end_jdn + 1);
+  if (end_jdn > kMaxJdn || new_expiration < old_expiration) {
+    LOG(ERROR) << absl::StrCat("Failed extending leap table: end_jdn ",
+                               end_jdn, " was not in valid range (",
+                               ToJdnInt(old_expiration) - 1, " - ", kMaxJdn,
+                               ")");
+    return nullptr;
+  }
+  // The expiration must be at the start of a possible smear.
+  if (!SpansMonthEnd(end_jdn + 1)) {
+    LOG(ERROR) << "Failed extending leap table: end_jdn must be at the end of "
+                  "the month, but was actually "
+               << new_expiration;
+    return nullptr;
+  }
+  if (sign != 0) {
+    if (sign != 1 && sign != -1) {
+      LOG(ERROR) << "Failed extending leap table: leap second sign " << sign
+                 << " is not +1 or -1";
+      return nullptr;
+    }
+    if (JdnToTime(leap_jdn) < old_expiration ||
+        JdnToTime(leap_jdn + 1) >= new_expiration) {
+      LOG(ERROR) << "Failed extending leap table: leap " << JdnToTime(leap_jdn)
+                 << " is not between the expirations " << old_expiration
+                 << " and " << new_expiration;
+      return nullptr;
+    }
+    if (!SpansMonthEnd(leap_jdn)) {
+      LOG(ERROR) << "Failed extending leap table: leap second "
+                 << JdnToTime(leap_jdn) << " is not at end of month";
+      return nullptr;
+    }
+  }
+
+  // The old expiration is replaced by the new expiration and, with a leap
+  // second, the end and start of its smear, latest first.  The other entries
+  // are unchanged.
+  std::vector<internal::LeapTableEntry> added;
+  added.push_back({new_expiration, TaiTime(), 0});
+  if (sign != 0) {
+    added.push_back({JdnToTime(leap_jdn + 1), TaiTime(), sign});
+    added.push_back({JdnToTime(leap_jdn), TaiTime(), 0});
+  }
+  internal::LeapTableEntry next = entry(1);
+  for (auto it = added.rbegin(); it != added.rend(); ++it) {
+    it->tai = next.tai +
+              Seconds(absl::ToInt64Seconds(it->utc - next.utc) + it->smear);
+    next = *it;
+  }
+
+  auto storage = std::make_shared<LeapTableStorage>();
+  for (const auto& e : added) {
+    storage->utc_seconds.push_back(absl::ToUnixSeconds(e.utc));
+    storage->tai_seconds.push_back(
+        absl::ToInt64Seconds(internal::GetRep(e.tai - TaiEpoch())));
+    storage->smears.push_back(e.smear);
+  }
+  storage->utc_seconds.insert(storage->utc_seconds.end(),
+                              data_.utc_seconds.begin() + 1,
+                              data_.utc_seconds.end());
+  storage->tai_seconds.insert(storage->tai_seconds.end(),
+                              data_.tai_seconds.begin() + 1,
+                              data_.tai_seconds.end());
+  storage->smears.insert(storage->smears.end(), data_.smears.begin() + 1,
+                         data_.smears.end());
+
+  // The days of this table are in the same segments, which have the same
+  // positions from the smear epoch, so only the days after them are new.  The
+  // exception is a leap second at the current expiration when that is also the
+  // start of the last TAI day, which then starts at the end of the segment
+  // before the smear rather than in it.  That is only when TAI - UTC is 10 s,
+  // before the first leap second.
+  size_t utc_from = data_.utc_day_index.size();
+  size_t tai_from = data_.tai_day_index.size();
+  if (sign != 0 && JdnToTime(leap_jdn) == old_expiration &&
+      (data_.tai_seconds[0] - kTaiDayIndexStart) % 86400 == 0) {
+    --tai_from;
+  }
+  const size_t utc_days = UtcDays(storage->utc_seconds.front());
+  const size_t tai_days = TaiDays(storage->tai_seconds.front());
+  std::shared_ptr<DayIndexes> days = day_indexes_;
+  size_t claimed = utc_from;
+  if (days == nullptr || tai_from < data_.tai_day_index.size() ||
+      utc_days > days->utc_capacity || tai_days > days->tai_capacity ||
+      !days->utc_days.compare_exchange_strong(claimed, utc_days,
+                                              std::memory_order_relaxed)) {
+    // Copy the days into new arrays, with room for the next ten years of
+    // extensions, so that extending a table every six months copies them once
+    // a decade.
+    constexpr size_t kSpareDays = 3653;
+    days = std::make_shared<DayIndexes>(utc_days + kSpareDays,
+                                        tai_days + kSpareDays);
+    std::copy(data_.utc_day_index.begin(),
+              data_.utc_day_index.begin() + utc_from, days->utc.get());
+    std::copy(data_.tai_day_index.begin(),
+              data_.tai_day_index.begin() + tai_from, days->tai.get());
+    days->utc_days.store(utc_days, std::memory_order_relaxed);
+  }
+  IndexDays(*storage, utc_from, tai_from, days->utc.get(), days->tai.get());
+  internal::LeapTableData data = {
+      storage->utc_seconds, storage->tai_seconds, storage->smears,
+      absl::MakeConstSpan(days->utc.get(), utc_days),
+      absl::MakeConstSpan(days->tai.get(), tai_days)};
+  return std::unique_ptr<LeapTable>(
+      new LeapTable(data, std::move(storage), std::move(days)));
+}
+
+Duration LeapTable::Segment::offset() const {
+  // TAI and UTC times are both labeled from 1958-01-01 00:00:00.
+  return (end_.tai - TaiEpoch()) -
+         internal::MakeDuration(end_.utc - absl::UnixEpoch() +
+                                4383 * absl::Hours(24));
+}
+
+TaiTime LeapTable::Segment::Convert(absl::Time utc) const {
+  assert(utc >= begin_.utc && utc <= end_.utc);
+  return Interpolate(end_, utc);
+}
+
+absl::Time LeapTable::Segment::Convert(TaiTime tai) const {
+  assert(tai >= begin_.tai && tai <= end_.tai);
+  return Interpolate(end_, tai);
+}
+
+absl::optional<LeapTable::Segment> LeapTable::SegmentAt(absl::Time utc) const {
+  if (utc < ModernUtcEpoch() || utc > expiration()) {
+    return absl::nullopt;
+  }
+  size_t i = UtcSegmentEnd(absl::ToUnixSeconds(utc));
+  while (i > 0 && entry(i).utc <= utc) --i;
+  return Segment(entry(i + 1), entry(i));
+}
+
+absl::optional<LeapTable::Segment> LeapTable::SegmentAt(TaiTime tai) const {
+  if (tai < TaiModernUtcEpoch() || tai > entry(0).tai) {
+    return absl::nullopt;
+  }
+  size_t i = TaiSegmentEnd(TaiSeconds(tai));
+  while (i > 0 && entry(i).tai <= tai) --i;
+  return Segment(entry(i + 1), entry(i));
+}
+
+namespace {
+
+// Generates the segments past the expiration of a leap table in a hypothetical
+// table that has a leap second at every opportunity, all negative or all
+// positive.  Any other future leap seconds convert times to between the
+// results of these two tables, which are the bounds that Advance() computes
+// for one time at a time.  Segments alternate between smears, from noon on the
+// last day of a month to noon on the next day, and the rest of the following
+// month, so they are at the same UTC times in both tables.
+class FutureSegments {
+ public:
+  // The sign is -1 for negative leap seconds and 1 for positive ones.  The
+  // first segment is the smear starting at the expiration.
+  FutureSegments(const internal::LeapTableEntry& expiration, int sign)
+      : expiration_(expiration),
+        sign_(sign),
+        last_day_(internal::ToUnixDays(expiration.utc).first),
+        segment_(Entry(last_day_, 0, 0), Entry(last_day_ + 1, 1, sign)) {}
+
+  const LeapTable::Segment& segment() const { return segment_; }
+
+  void Next() {
+    if (segment_.smear() != 0) {
+      const internal::CivilDay day = internal::CivilFromDays(last_day_ + 1);
+      const int64_t next_last_day =
+          last_day_ + internal::DaysInMonth(day.year, day.month);
+      segment_ = LeapTable::Segment(Entry(last_day_ + 1, leaps_, 0),
+                                    Entry(next_last_day, leaps_, 0));
+      last_day_ = next_last_day;
+    } else {
+      segment_ = LeapTable::Segment(Entry(last_day_, leaps_, 0),
+                                    Entry(last_day_ + 1, leaps_ + 1, sign_));
+      ++leaps_;
+    }
+  }
+
+ private:
+  // Returns the entry at noon on a day since the Unix epoch, after the given
+  // number of leap seconds since the expiration.
+  internal::LeapTableEntry Entry(int64_t day, int64_t leaps, int smear) const {
+    const absl::Time utc = UnixDayNoon(day);
+    return {utc,
+            expiration_.tai + internal::MakeDuration(utc - expiration_.utc) +
+                sign_ * leaps * Seconds(1),
+            smear};
+  }
+
+  const internal::LeapTableEntry expiration_;
+  const int sign_;
+  // The last day of the month of the current or next smear.
+  int64_t last_day_;
+  // Leap seconds since the expiration, through the end of the current
+  // segment.
+  int64_t leaps_ = 1;
+  LeapTable::Segment segment_;
+};
+
+}  // namespace
+
+std::vector<LeapTable::RangePart<absl::Time>> LeapTable::UnsmearRange(
+    absl::Time begin, absl::Time end) const {
+  std::vector<RangePart<absl::Time>> parts;
+  if (end == absl::InfiniteFuture()) {
+    LOG(ERROR) << "Failed converting range: end must be finite";
+    return parts;
+  }
+  absl::Time t = std::max(begin, ModernUtcEpoch());
+  if (t >= end) {
+    return parts;
+  }
+
+  const auto expiration = entry(0);
+  if (t < expiration.utc) {
+    size_t i = UtcSegmentEnd(absl::ToUnixSeconds(t));
+    while (t < end && t < expiration.utc) {
+      // Move on past any segments ending at t.
+      while (entry(i).utc <= t) --i;
+      const Segment segment(entry(i + 1), entry(i));
+      const absl::Time part_end = std::min(end, segment.utc_end());
+      parts.push_back({t, part_end, segment, segment});
+      t = part_end;
+    }
+  }
+
+  FutureSegments neg(expiration, -1);
+  FutureSegments pos(expiration, 1);
+  while (t < end) {
+    while (neg.segment().utc_end() <= t) {
+      neg.Next();
+      pos.Next();
+    }
+    const absl::Time part_end = std::min(end, neg.segment().utc_end());
+    parts.push_back({t, part_end, neg.segment(), pos.segment()});
+    t = part_end;
+  }
+  return parts;
+}
+
+std::vector<LeapTable::RangePart<TaiTime>> LeapTable::SmearRange(
+    TaiTime begin, TaiTime end) const {
+  std::vector<RangePart<TaiTime>> parts;
+  if (end == TaiInfiniteFuture()) {
+    LOG(ERROR) << "Failed converting range: end must be finite";
+    return parts;
+  }
+  TaiTime t = std::max(begin, TaiModernUtcEpoch());
+  if (t >= end) {
+    return parts;
+  }
+
+  const auto expiration = entry(0);
+  if (t < expiration.tai) {
+    size_t i = TaiSegmentEnd(TaiSeconds(t));
+    while (t < end && t < expiration.tai) {
+      while (entry(i).tai <= t) --i;
+      const Segment segment(entry(i + 1), entry(i));
+      const TaiTime part_end = std::min(end, segment.tai_end());
+      parts.push_back({t, part_end, segment, segment});
+      t = part_end;
+    }
+  }
+
+  // The tables differ in TAI, so each part ends at the first end of a segment
+  // in either table.  More positive leap seconds make smeared times earlier.
+  FutureSegments neg(expiration, -1);
+  FutureSegments pos(expiration, 1);
+  while (t < end) {
+    while (neg.segment().tai_end() <= t) neg.Next();
+    while (pos.segment().tai_end() <= t) pos.Next();
+    const TaiTime part_end = std::min(
+        end, std::min(neg.segment().tai_end(), pos.segment().tai_end()));
+    parts.push_back({t, part_end, pos.segment(), neg.segment()});
+    t = part_end;
+  }
+  return parts;
+}
+
+size_t LeapTable::UtcSegmentEnd(int64_t utc_seconds) const {
+  assert(utc_seconds <= data_.utc_seconds.front());
+  assert(utc_seconds >= data_.utc_seconds.back());
+  // The expiration itself is at the start of the day after the last one.
+  size_t day = std::min<size_t>((utc_seconds - kUtcDayIndexStart) / 86400,
+                                data_.utc_day_index.size() - 1);
+  return size() - 1 - data_.utc_day_index[day];
+}
+
+size_t LeapTable::TaiSegmentEnd(int64_t tai_seconds) const {
+  assert(tai_seconds <= data_.tai_seconds.front());
+  assert(tai_seconds >= data_.tai_seconds.back());
+  size_t i = size() - 1 -
+             data_.tai_day_index[(tai_seconds - kTaiDayIndexStart) / 86400];
+  // Move on past any segments ending earlier in the day.
+  while (i > 0 && tai_seconds >= data_.tai_seconds[i]) --i;
+  return i;
+}
+
+void LeapTable::Cursor::SeekUtc(absl::Time utc) {
+  // Sorted inputs usually move on to the following segment.
+  size_t i = utc_index_;
+  if (i > 0 && utc >= utc_end_.utc && utc <= lt_->entry(i - 1).utc) {
+    --i;
+  } else {
+    i = lt_->UtcSegmentEnd(absl::ToUnixSeconds(utc));
+  }
+  utc_index_ = i;
+  utc_end_ = lt_->entry(i);
+  utc_begin_ = lt_->entry(i + 1).utc;
+}
+
+void LeapTable::Cursor::SeekTai(TaiTime tai) {
+  size_t i = tai_index_;
+  if (i > 0 && tai >= tai_end_.tai && tai <= lt_->entry(i - 1).tai) {
+    --i;
+  } else {
+    i = lt_->TaiSegmentEnd(TaiSeconds(tai));
+  }
+  tai_index_ = i;
+  tai_end_ = lt_->entry(i);
+  tai_begin_ = lt_->entry(i + 1).tai;
+}
+
+template <internal::TtBasedTimescale timescale>
+absl::optional<absl::Time> LeapTable::Cursor::Smear(
+    internal::TtBasedTime<timescale> t) {
+  if (t < internal::TtBasedTime<timescale>()) {
+    // Let the LeapTable handle times before the epoch of their timescale.
+    return lt_->Smear(t);
+  }
+  TaiTime tai = ToTaiTime(t);
+  if (tai < tai_begin_ || tai > tai_end_.tai) {
+    if (tai < TaiModernUtcEpoch() || tai > lt_->entry(0).tai) {
+      return lt_->Smear(t);
+    }
+    SeekTai(tai);
+  }
+  CountPrecise(tai_end_);
+  return Interpolate(tai_end_, tai);
+}
+
+// Explicit instantiations:
+template absl::optional<absl::Time> LeapTable::Cursor::Smear(TaiTime t);
+template absl::optional<absl::Time> LeapTable::Cursor::Smear(GpsTime t);
+
+absl::optional<TaiTime> LeapTable::Cursor::Unsmear(absl::Time utc) {
+  if (utc < utc_begin_ || utc > utc_end_.utc) {
+    if (utc < ModernUtcEpoch() || utc > lt_->expiration()) {
+      return lt_->Unsmear(utc);
+    }
+    SeekUtc(utc);
+  }
+  CountPrecise(utc_end_);
+  return Interpolate(utc_end_, utc);
+}
+
+absl::optional<GpsTime> LeapTable::Cursor::UnsmearToGps(absl::Time utc) {
+  if (utc < UtcGpsEpoch()) {
+    return lt_->UnsmearToGps(utc);
+  }
+  auto unsmeared = Unsmear(utc);
+  if (!unsmeared.has_value()) {
+    return absl::nullopt;
+  }
+  return ToGpsTime(*unsmeared);
+}
+
+static_assert(std::is_trivially_copyable<InlineLeapTable>::value,
+              "InlineLeapTable must be copyable with memcpy");
+static_assert(sizeof(InlineLeapTable) == 2048,
+              "InlineLeapTable must fit in 2 KiB");
+
+bool InlineLeapTable::Assign(const LeapTable& lt) {
+  internal::LeapTableData data = internal::GetLeapTableData(lt);
+  if (data.smears.size() > kCapacity) {
+    LOG(ERROR) << "Leap table has " << data.smears.size()
+               << " entries, more than the capacity of " << kCapacity;
+    return false;
+  }
+  for (size_t i = 0; i < data.smears.size(); ++i) {
+    int64_t offset = data.tai_seconds[i] - data.utc_seconds[i];
+    assert(offset == static_cast<int32_t>(offset));
+    entries_[i] = {data.utc_seconds[i], static_cast<int32_t>(offset),
+                   data.smears[i]};
+  }
+  size_ = data.smears.size();
+  return true;
+}
+
+absl::Time InlineLeapTable::expiration() const {
+  if (size_ == 0) {
+    return absl::InfinitePast();
+  }
+  return absl::FromUnixSeconds(entries_[0].utc_seconds);
+}
+
+size_t InlineLeapTable::UtcSegmentEnd(int64_t utc_seconds) const {
+  assert(utc_seconds <= entries_[0].utc_seconds);
+  assert(utc_seconds >= entries_[size_ - 1].utc_seconds);
+  // Recent times are usually in the latest segment, whose entries share the
+  // first cache line with the size.
+  if (utc_seconds >= entries_[1].utc_seconds) {
+    return 0;
+  }
+  // Otherwise, count the entries after the time, in a branchless binary search
+  // that compilers can implement with conditional moves.  The epoch is never
+  // after it, so the count is at most the number of segments.
+  const Entry* base = entries_ + 1;
+  for (size_t n = size_ - 1; n > 1; n -= n / 2) {
+    base = base[n / 2].utc_seconds > utc_seconds ? base + n / 2 : base;
+  }
+  return (base - entries_) + (base->utc_seconds > utc_seconds) - 1;
+}
+
+size_t InlineLeapTable::TaiSegmentEnd(int64_t tai_seconds) const {
+  assert(tai_seconds <= entries_[0].tai_seconds());
+  assert(tai_seconds >= entries_[size_ - 1].tai_seconds());
+  // As for UtcSegmentEnd(), but a time at the end of a segment is in the
+  // following one, as in LeapTable::TaiSegmentEnd().
+  if (tai_seconds >= entries_[1].tai_seconds()) {
+    return 0;
+  }
+  const Entry* base = entries_ + 1;
+  for (size_t n = size_ - 1; n > 1; n -= n / 2) {
+    base = base[n / 2].tai_seconds() > tai_seconds ? base + n / 2 : base;
+  }
+  return (base - entries_) + (base->tai_seconds() > tai_seconds) - 1;
+}
+
+template <internal::TtBasedTimescale timescale>
+absl::optional<absl::Time> InlineLeapTable::Smear(
+    internal::TtBasedTime<timescale> t) const {
+  using internal::ConversionPath;
+  using internal::CountConversion;
+  if (t == internal::TtBasedTime<timescale>::InfiniteFuture()) {
+    CountConversion(ConversionPath::kInfinite);
+    return absl::InfiniteFuture();
+  }
+  if (t == internal::TtBasedTime<timescale>::InfinitePast()) {
+    CountConversion(ConversionPath::kInfinite);
+    return absl::InfinitePast();
+  }
+  TaiTime tai = ToTaiTime(t);
+  if (t < internal::TtBasedTime<timescale>() || tai < TaiModernUtcEpoch()) {
+    CountConversion(ConversionPath::kBeforeEpoch);
+    return absl::nullopt;
+  }
+  if (size_ == 0 || tai > entry(0).tai) {
+    CountConversion(ConversionPath::kFuture);
+    return absl::nullopt;
+  }
+  size_t i = TaiSegmentEnd(TaiSeconds(tai));
+  CountPrecise(entry(i));
+  return Interpolate(entry(i), tai);
+}
+
+// Explicit instantiations:
+template absl::optional<absl::Time> InlineLeapTable::Smear(TaiTime t) const;
+template absl::optional<absl::Time> InlineLeapTable::Smear(GpsTime t) const;
+
+absl::optional<TaiTime> InlineLeapTable::Unsmear(absl::Time utc) const {
+  using internal::ConversionPath;
+  using internal::CountConversion;
+  if (utc == absl::InfiniteFuture()) {
+    CountConversion(ConversionPath::kInfinite);
+    return TaiInfiniteFuture();
+  }
+  if (utc == absl::InfinitePast()) {
+    CountConversion(ConversionPath::kInfinite);
+    return TaiInfinitePast();
+  }
+  if (utc < ModernUtcEpoch()) {
+    CountConversion(ConversionPath::kBeforeEpoch);
+    return absl::nullopt;
+  }
+  if (utc > expiration()) {
+    CountConversion(ConversionPath::kFuture);
+    return absl::nullopt;
+  }
+  size_t i = UtcSegmentEnd(absl::ToUnixSeconds(utc));
+  CountPrecise(entry(i));
+  return Interpolate(entry(i), utc);
+}
+
+absl::optional<GpsTime> InlineLeapTable::UnsmearToGps(absl::Time utc) const {
+  if (utc == absl::InfiniteFuture()) {
+    internal::CountConversion(internal::ConversionPath::kInfinite);
+    return GpsInfiniteFuture();
+  }
+  if (utc == absl::InfinitePast()) {
+    internal::CountConversion(internal::ConversionPath::kInfinite);
+    return GpsInfinitePast();
+  }
+  if (utc < UtcGpsEpoch()) {
+    internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+    return absl::nullopt;
+  }
+  auto unsmeared = Unsmear(utc);
+  if (!unsmeared.has_value()) {
+    return absl::nullopt;
+  }
+  return ToGpsTime(*unsmeared);
+}
+
+namespace {
+
+// Converts each element of in to out with the given Cursor method, returning
+// the number of elements converted.
+template <typename In, typename Out, typename Convert>
+size_t ConvertBatch(absl::Span<const In> in, absl::Span<Out> out,
+                    std::vector<bool>* valid, Out invalid, Convert convert) {
+  assert(in.size() == out.size());
+  if (valid != nullptr) {
+    valid->assign(in.size(), false);
+  }
+  size_t converted = 0;
+  for (size_t i = 0; i < in.size(); ++i) {
+    absl::optional<Out> result = convert(in[i]);
+    if (result.has_value()) {
+      out[i] = *result;
+      ++converted;
+      if (valid != nullptr) (*valid)[i] = true;
+    } else {
+      out[i] = invalid;
+    }
+  }
+  return converted;
+}
+
+}  // namespace
+
+size_t LeapTable::Smear(absl::Span<const TaiTime> tai,
+                        absl::Span<absl::Time> utc,
+                        std::vector<bool>* valid) const {
+  Cursor cursor(*this);
+  return ConvertBatch(tai, utc, valid, absl::InfinitePast(),
+                      [&cursor](TaiTime t) { return cursor.Smear(t); });
+}
+
+size_t LeapTable::Smear(absl::Span<const GpsTime> gps,
+                        absl::Span<absl::Time> utc,
+                        std::vector<bool>* valid) const {
+  Cursor cursor(*this);
+  return ConvertBatch(gps, utc, valid, absl::InfinitePast(),
+                      [&cursor](GpsTime t) { return cursor.Smear(t); });
+}
+
+size_t LeapTable::Unsmear(absl::Span<const absl::Time> utc,
+                          absl::Span<TaiTime> tai,
+                          std::vector<bool>* valid) const {
+  Cursor cursor(*this);
+  return ConvertBatch(utc, tai, valid, TaiInfinitePast(),
+                      [&cursor](absl::Time t) { return cursor.Unsmear(t); });
+}
+
+size_t LeapTable::UnsmearToGps(absl::Span<const absl::Time> utc,
+                               absl::Span<GpsTime> gps,
+                               std::vector<bool>* valid) const {
+  Cursor cursor(*this);
+  return ConvertBatch(
+      utc, gps, valid, GpsInfinitePast(),
+      [&cursor](absl::Time t) { return cursor.UnsmearToGps(t); });
+}
+
+size_t LeapTable::ElapsedTT(absl::Span<const absl::Time> a,
+                            absl::Span<const absl::Time> b,
+                            absl::Span<Duration> elapsed,
+                            std::vector<bool>* valid) const {
+  assert(a.size() == b.size());
+  assert(a.size() == elapsed.size());
+  if (valid != nullptr) {
+    valid->assign(a.size(), false);
+  }
+  size_t hint = 0;
+  size_t converted = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    absl::optional<Duration> result = ElapsedTTNear(&hint, a[i], b[i]);
+    if (result.has_value()) {
+      elapsed[i] = *result;
+      ++converted;
+      if (valid != nullptr) (*valid)[i] = true;
+    } else {
+      elapsed[i] = InfiniteDuration();
+    }
+  }
+  return converted;
+}
+
+namespace {
+
+// Converts in to out in chunks on the executor, with a batch conversion that
+// returns the number of elements converted in a chunk.
+template <typename In, typename Out, typename Convert>
+size_t ConvertParallel(const LeapTable::Executor& executor,
+                       absl::Span<const In> in, absl::Span<Out> out,
+                       std::vector<bool>* valid, Convert convert) {
+  assert(in.size() == out.size());
+  // Chunks of 256 KiB of input and output stay in the L2 caches of most
+  // processors, while being large enough for the per-chunk lookups and task
+  // overhead to be negligible.
+  constexpr size_t kChunkSize = 8192;
+  const size_t chunks = (in.size() + kChunkSize - 1) / kChunkSize;
+  // Concurrent writes to different elements of one std::vector<bool> may race,
+  // so each chunk sets its own, and they are joined after the executor returns.
+  std::vector<std::vector<bool>> chunk_valid(valid != nullptr ? chunks : 0);
+  std::atomic<size_t> converted(0);
+  const std::function<void(size_t)> task = [&](size_t i) {
+    const size_t begin = i * kChunkSize;
+    const size_t size = std::min(kChunkSize, in.size() - begin);
+    converted.fetch_add(
+        convert(in.subspan(begin, size), out.subspan(begin, size),
+                valid != nullptr ? &chunk_valid[i] : nullptr),
+        std::memory_order_relaxed);
+  };
+  if (executor) {
+    executor(chunks, task);
+  } else {
+    for (size_t i = 0; i < chunks; ++i) task(i);
+  }
+  if (valid != nullptr) {
+    valid->clear();
+    valid->reserve(in.size());
+    for (const std::vector<bool>& v : chunk_valid) {
+      valid->insert(valid->end(), v.begin(), v.end());
+    }
+  }
+  return converted.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+size_t LeapTable::ParallelSmear(const Executor& executor,
+                                absl::Span<const TaiTime> tai,
+                                absl::Span<absl::Time> utc,
+                                std::vector<bool>* valid) const {
+  return ConvertParallel(
+      executor, tai, utc, valid,
+      [this](absl::Span<const TaiTime> in, absl::Span<absl::Time> out,
+             std::vector<bool>* chunk_valid) {
+        return Smear(in, out, chunk_valid);
+      });
+}
+
+size_t LeapTable::ParallelSmear(const Executor& executor,
+                                absl::Span<const GpsTime> gps,
+                                absl::Span<absl::Time> utc,
+                                std::vector<bool>* valid) const {
+  return ConvertParallel(
+      executor, gps, utc, valid,
+      [this](absl::Span<const GpsTime> in, absl::Span<absl::Time> out,
+             std::vector<bool>* chunk_valid) {
+        return Smear(in, out, chunk_valid);
+      });
+}
+
+size_t LeapTable::ParallelUnsmear(const Executor& executor,
+                                  absl::Span<const absl::Time> utc,
+                                  absl::Span<TaiTime> tai,
+                                  std::vector<bool>* valid) const {
+  return ConvertParallel(
+      executor, utc, tai, valid,
+      [this](absl::Span<const absl::Time> in, absl::Span<TaiTime> out,
+             std::vector<bool>* chunk_valid) {
+        return Unsmear(in, out, chunk_valid);
+      });
+}
+
+size_t LeapTable::ParallelUnsmearToGps(const Executor& executor,
+                                       absl::Span<const absl::Time> utc,
+                                       absl::Span<GpsTime> gps,
+                                       std::vector<bool>* valid) const {
+  return ConvertParallel(
+      executor, utc, gps, valid,
+      [this](absl::Span<const absl::Time> in, absl::Span<GpsTime> out,
+             std::vector<bool>* chunk_valid) {
+        return UnsmearToGps(in, out, chunk_valid);
+      });
+}
+
+namespace {
+constexpr int64_t kNanosPerSecond = 1000000000;
+}  // namespace
+
+// The raw conversions below follow the Interpolate() functions, in int64 math.
+// Within the precise range, smeared times are positive and far from overflow,
+// and at most a day from the end of the segment when they're smeared.
+
+bool LeapTable::UnsmearNanos(int64_t utc, int64_t* tai) const {
+  const int64_t seconds = utc / kNanosPerSecond;
+  const int64_t subsecond = utc % kNanosPerSecond;
+  if (utc < data_.utc_seconds.back() * kNanosPerSecond) {
+    internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+    return false;
+  }
+  if (seconds > data_.utc_seconds.front() ||
+      (seconds == data_.utc_seconds.front() && subsecond != 0)) {
+    internal::CountConversion(internal::ConversionPath::kFuture);
+    return false;
+  }
+  const size_t i = UtcSegmentEnd(seconds);
+  CountPrecise(entry(i));
+  return UnsmearNanosIn(i, utc, tai);
+}
+
+bool LeapTable::UnsmearNanosIn(size_t i, int64_t utc, int64_t* tai) const {
+  const int64_t offset =
+      (data_.tai_seconds[i] - data_.utc_seconds[i]) * kNanosPerSecond;
+  int64_t adjustment = 0;
+  if (data_.smears[i] != 0) {
+    int64_t d =
+        (data_.utc_seconds[i] - utc / kNanosPerSecond) * kNanosPerSecond -
+        utc % kNanosPerSecond;
+    adjustment = -data_.smears[i] * (d / 86400);
+  }
+  if (utc > std::numeric_limits<int64_t>::max() - offset - adjustment) {
+    return false;
+  }
+  *tai = utc + offset + adjustment;
+  return true;
+}
+
+bool LeapTable::UnsmearToGpsNanos(int64_t utc, int64_t* gps) const {
+  int64_t tai;
+  if (utc < absl::ToUnixNanos(UtcGpsEpoch())) {
+    // It's not valid to unsmear times before the GPST epoch.
+    internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+    return false;
+  }
+  if (!UnsmearNanos(utc, &tai)) {
+    return false;
+  }
+  assert(tai >= internal::kTaiGpsOffsetNanos);
+  *gps = tai - internal::kTaiGpsOffsetNanos;
+  return true;
+}
+
+bool LeapTable::SmearTaiNanos(int64_t tai, int64_t* utc) const {
+  const int64_t seconds = tai / kNanosPerSecond;
+  const int64_t subsecond = tai % kNanosPerSecond;
+  if (tai < data_.tai_seconds.back() * kNanosPerSecond) {
+    internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+    return false;
+  }
+  if (seconds > data_.tai_seconds.front() ||
+      (seconds == data_.tai_seconds.front() && subsecond != 0)) {
+    internal::CountConversion(internal::ConversionPath::kFuture);
+    return false;
+  }
+  const size_t i = TaiSegmentEnd(seconds);
+  CountPrecise(entry(i));
+  *utc = SmearTaiNanosIn(i, tai);
+  return true;
+}
+
+int64_t LeapTable::SmearTaiNanosIn(size_t i, int64_t tai) const {
+  int64_t t = tai - (data_.tai_seconds[i] - data_.utc_seconds[i]) *
+                        kNanosPerSecond;
+  if (data_.smears[i] != 0) {
+    int64_t d =
+        (data_.tai_seconds[i] - tai / kNanosPerSecond) * kNanosPerSecond -
+        tai % kNanosPerSecond;
+    if (data_.smears[i] > 0) {
+      t += d / (86400 + 1);
+    } else {
+      t -= d / (86400 - 1);
+    }
+  }
+  return t;
+}
+
+bool LeapTable::SmearGpsNanos(int64_t gps, int64_t* utc) const {
+  if (gps < 0) {
+    // Times before the GPST epoch cannot be smeared.
+    internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+    return false;
+  }
+  int64_t tai;
+  return GpsNanosToTaiNanos(gps, &tai) && SmearTaiNanos(tai, utc);
+}
+
+bool LeapTable::NtpToPtp(uint64_t ntp, int era, PtpTimestamp* ptp) const {
+  int64_t utc;
+  int64_t tai;
+  // Every time that can be unsmeared is after the PTP epoch.
+  return NtpToUnixNanos(ntp, era, &utc) && UnsmearNanos(utc, &tai) &&
+         TaiNanosToPtp(tai, ptp);
+}
+
+bool LeapTable::PtpToNtp(PtpTimestamp ptp, uint64_t* ntp, int* era) const {
+  int64_t tai;
+  int64_t utc;
+  if (!PtpToTaiNanos(ptp, &tai) || !SmearTaiNanos(tai, &utc)) {
+    return false;
+  }
+  UnixNanosToNtp(utc, ntp, era);
+  return true;
+}
+
+namespace {
+
+// Converts whole seconds in the precise range of a leap table to nanoseconds,
+// saturating for expirations too late to be represented.
+int64_t SecondsToNanos(int64_t seconds) {
+  if (seconds > std::numeric_limits<int64_t>::max() / kNanosPerSecond) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return seconds * kNanosPerSecond;
+}
+
+}  // namespace
+
+size_t LeapTable::SmearGpsWeeks(absl::Span<const GpsWeekTime> gps,
+                                absl::Span<absl::Time> utc,
+                                std::vector<bool>* valid) const {
+  assert(gps.size() == utc.size());
+  if (valid != nullptr) {
+    valid->assign(gps.size(), false);
+  }
+  // The segment of the previous element, in nanoseconds since the TAI epoch,
+  // as for a Cursor.  It starts out empty.
+  size_t segment = 0;
+  int64_t begin = 0;
+  int64_t end = -1;
+  size_t converted = 0;
+  for (size_t k = 0; k < gps.size(); ++k) {
+    utc[k] = absl::InfinitePast();
+    int64_t gps_ns;
+    int64_t tai;
+    if (!GpsWeekTimeToNanos(gps[k], &gps_ns)) {
+      internal::CountConversion(gps[k].week < 0
+                                    ? internal::ConversionPath::kBeforeEpoch
+                                    : internal::ConversionPath::kFuture);
+      continue;
+    }
+    if (gps_ns < 0) {
+      // Times before the GPST epoch cannot be smeared.
+      internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+      continue;
+    }
+    if (!GpsNanosToTaiNanos(gps_ns, &tai)) {
+      continue;
+    }
+    if (tai >= begin && tai <= end) {
+      CountPrecise(entry(segment));
+      utc[k] = absl::FromUnixNanos(SmearTaiNanosIn(segment, tai));
+    } else {
+      int64_t utc_ns;
+      if (!SmearTaiNanos(tai, &utc_ns)) {
+        continue;
+      }
+      utc[k] = absl::FromUnixNanos(utc_ns);
+      segment = TaiSegmentEnd(tai / kNanosPerSecond);
+      begin = SecondsToNanos(data_.tai_seconds[segment + 1]);
+      end = SecondsToNanos(data_.tai_seconds[segment]);
+    }
+    if (valid != nullptr) {
+      (*valid)[k] = true;
+    }
+    ++converted;
+  }
+  return converted;
+}
+
+size_t LeapTable::UnsmearToGpsWeeks(absl::Span<const absl::Time> utc,
+                                    absl::Span<GpsWeekTime> gps,
+                                    std::vector<bool>* valid) const {
+  assert(utc.size() == gps.size());
+  if (valid != nullptr) {
+    valid->assign(utc.size(), false);
+  }
+  const int64_t gps_epoch = absl::ToUnixNanos(UtcGpsEpoch());
+  GpsWeekTime invalid;
+  invalid.week = std::numeric_limits<int64_t>::min();
+  // As above, but in nanoseconds since the Unix epoch.
+  size_t segment = 0;
+  int64_t begin = 0;
+  int64_t end = -1;
+  size_t converted = 0;
+  for (size_t k = 0; k < utc.size(); ++k) {
+    gps[k] = invalid;
+    if (utc[k] == absl::InfiniteFuture() || utc[k] == absl::InfinitePast()) {
+      internal::CountConversion(internal::ConversionPath::kInfinite);
+      continue;
+    }
+    const int64_t utc_ns = absl::ToUnixNanos(utc[k]);
+    if (utc_ns < gps_epoch) {
+      // It's not valid to unsmear times before the GPST epoch.
+      internal::CountConversion(internal::ConversionPath::kBeforeEpoch);
+      continue;
+    }
+    int64_t tai;
+    if (utc_ns >= begin && utc_ns <= end) {
+      CountPrecise(entry(segment));
+      if (!UnsmearNanosIn(segment, utc_ns, &tai)) {
+        continue;
+      }
+    } else {
+      if (!UnsmearNanos(utc_ns, &tai)) {
+        continue;
+      }
+      segment = UtcSegmentEnd(utc_ns / kNanosPerSecond);
+      begin = SecondsToNanos(data_.utc_seconds[segment + 1]);
+      end = SecondsToNanos(data_.utc_seconds[segment]);
+    }
+    gps[k] = GpsNanosToWeekTime(tai - internal::kTaiGpsOffsetNanos);
+    if (valid != nullptr) {
+      (*valid)[k] = true;
+    }
+    ++converted;
+  }
+  return converted;
+}
+
 }  // namespace unsmear
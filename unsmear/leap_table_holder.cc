@@ -0,0 +1,86 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/leap_table_holder.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+
+namespace unsmear {
+
+namespace {
+
+// Returns the leap seconds that occur no later than end_jdn.  Leap tables
+// write their leap seconds in increasing order.
+std::vector<int32_t> LeapsThrough(const std::vector<int32_t>& leaps,
+                                  int32_t end_jdn) {
+  std::vector<int32_t> v;
+  for (int32_t jdn : leaps) {
+    if (jdn <= end_jdn) {
+      v.push_back(jdn);
+    }
+  }
+  return v;
+}
+
+// Returns true if conversions with next agree with conversions with current
+// within the precise range of current.
+bool Extends(const LeapTable& next, const LeapTable& current) {
+  const LeapTableBuilder next_leaps(next);
+  const LeapTableBuilder current_leaps(current);
+  if (next_leaps.end_jdn() < current_leaps.end_jdn()) {
+    LOG(ERROR) << "Failed updating leap table: new expiration "
+               << next.expiration() << " is before current expiration "
+               << current.expiration();
+    return false;
+  }
+  const int32_t end_jdn = current_leaps.end_jdn();
+  if (LeapsThrough(next_leaps.positive_leaps(), end_jdn) !=
+          LeapsThrough(current_leaps.positive_leaps(), end_jdn) ||
+      LeapsThrough(next_leaps.negative_leaps(), end_jdn) !=
+          LeapsThrough(current_leaps.negative_leaps(), end_jdn)) {
+    LOG(ERROR) << "Failed updating leap table: new table changes leap seconds "
+                  "before current expiration "
+               << current.expiration();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+LeapTableHolder::LeapTableHolder(LeapTable lt)
+    : current_(std::make_shared<const LeapTable>(std::move(lt))) {}
+
+bool LeapTableHolder::Update(LeapTable lt) {
+  absl::MutexLock update_lock(&update_mu_);
+  const std::shared_ptr<const LeapTable> current = Get();
+  if (!Extends(lt, *current)) {
+    return false;
+  }
+  if (lt == *current) {
+    return true;
+  }
+  auto next = std::make_shared<const LeapTable>(std::move(lt));
+  absl::MutexLock lock(&mu_);
+  // Swapping leaves the replaced table in next, so that it is destroyed, if no
+  // reader still holds it, after the lock is released.
+  current_.swap(next);
+  return true;
+}
+
+}  // namespace unsmear
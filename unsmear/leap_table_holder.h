@@ -0,0 +1,85 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_LEAP_TABLE_HOLDER_H
+#define UNSMEAR_LEAP_TABLE_HOLDER_H
+
+#include <memory>
+#include "absl/synchronization/mutex.h"
+#include "unsmear/unsmear.h"
+
+namespace unsmear {
+
+// Publishes the current leap table to any number of threads, and replaces it
+// when a newer leap table is available, such as after IERS Bulletin C is
+// published.
+//
+// Get() returns a snapshot of the current table, which its holders own: a
+// table lives for as long as any snapshot of it, however many updates replace
+// it, and is destroyed with the last one.  Get() holds a reader lock only to
+// copy the pointer, so readers never wait for each other, or for Update()
+// beyond that copy; parsing and validating a new table happen outside the lock.
+// Since each Get() writes the lock and the reference count, which every reader
+// shares, readers converting at high rates should keep a snapshot for a batch
+// or a request rather than call Get() for every conversion, or read the
+// current time with a Clock.
+//
+// Updates must extend the current table: the new table must have every leap
+// second of the current table, no other leap seconds before the current
+// expiration, and an expiration no earlier than the current one.  Conversions
+// that succeed with the current table therefore give identical results with
+// every later table.
+//
+// The holder depends only on the core library.  UpdateLeapTableHolder() and
+// UpdateLeapTableHolderFromFile(), in leap_table_holder_proto.h, update it
+// from a LeapTableProto.
+//
+// Example:
+//   LeapTableHolder holder(*NewLeapTableFromProto(pb));
+//
+//   // From any thread:
+//   absl::optional<TaiTime> tai = holder.Get()->Unsmear(utc);
+//
+//   // When a new leap table is available:
+//   if (!UpdateLeapTableHolderFromFile("leap_table.pb", &holder)) { ... }
+class LeapTableHolder {
+ public:
+  explicit LeapTableHolder(LeapTable lt);
+
+  LeapTableHolder(const LeapTableHolder&) = delete;
+  LeapTableHolder& operator=(const LeapTableHolder&) = delete;
+
+  // Returns the current leap table, which remains valid for as long as the
+  // caller keeps it, even after the holder is destroyed.
+  std::shared_ptr<const LeapTable> Get() const {
+    absl::ReaderMutexLock lock(&mu_);
+    return current_;
+  }
+
+  // Replaces the current leap table with a newer one, if it extends the current
+  // table.  Otherwise, logs an error and returns false, leaving the current
+  // table in place.  Updating to a table equal to the current one succeeds and
+  // changes nothing.
+  bool Update(LeapTable lt);
+
+ private:
+  // Serializes updates, so that each is checked against the table it replaces.
+  absl::Mutex update_mu_;
+  mutable absl::Mutex mu_;
+  std::shared_ptr<const LeapTable> current_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace unsmear
+
+#endif  // UNSMEAR_LEAP_TABLE_HOLDER_H
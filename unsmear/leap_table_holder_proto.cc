@@ -0,0 +1,44 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/leap_table_holder_proto.h"
+
+#include <fstream>
+#include <utility>
+
+#include "absl/log/log.h"
+
+namespace unsmear {
+
+bool UpdateLeapTableHolder(const LeapTableProto& proto,
+                           LeapTableHolder* holder) {
+  auto lt = NewLeapTableFromProto(proto);
+  if (lt == nullptr) {
+    return false;
+  }
+  return holder->Update(std::move(*lt));
+}
+
+bool UpdateLeapTableHolderFromFile(const std::string& path,
+                                   LeapTableHolder* holder) {
+  std::ifstream stream(path, std::ios::binary);
+  LeapTableProto proto;
+  if (!stream || !proto.ParseFromIstream(&stream)) {
+    LOG(ERROR) << "Failed updating leap table: could not read " << path;
+    return false;
+  }
+  return UpdateLeapTableHolder(proto, holder);
+}
+
+}  // namespace unsmear
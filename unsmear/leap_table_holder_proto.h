@@ -0,0 +1,39 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_LEAP_TABLE_HOLDER_PROTO_H
+#define UNSMEAR_LEAP_TABLE_HOLDER_PROTO_H
+
+#include <string>
+#include "unsmear/leap_table_holder.h"
+#include "unsmear/unsmear_proto.h"
+
+namespace unsmear {
+
+// Updates of a LeapTableHolder from a LeapTableProto, in a separate library so
+// that the holder, and the Clocks bound to it, do not depend on protobuf.
+
+// Constructs a LeapTable from the protobuf and calls holder->Update() with it.
+// Returns false if the protobuf is invalid, or if the update fails.
+bool UpdateLeapTableHolder(const LeapTableProto& proto,
+                           LeapTableHolder* holder);
+
+// Reads a binary LeapTableProto from the file, and updates the holder with it.
+// Returns false if the file cannot be read or parsed, or if the update fails.
+bool UpdateLeapTableHolderFromFile(const std::string& path,
+                                   LeapTableHolder* holder);
+
+}  // namespace unsmear
+
+#endif  // UNSMEAR_LEAP_TABLE_HOLDER_PROTO_H
@@ -0,0 +1,194 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/leap_table_holder.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/time/civil_time.h"
+#include "gtest/gtest.h"
+#include "unsmear/leap_table_holder_proto.h"
+
+namespace unsmear {
+namespace {
+
+// Returns an absl::Time at UTC noon.
+absl::Time Noon(int64_t y, int m, int d) {
+  return absl::FromDateTime(y, m, d, 12, 0, 0, absl::UTCTimeZone());
+}
+
+// Returns the end_jdn of a table that expires at the end of the month.
+int32_t EndJdn(int64_t y, int m) {
+  const absl::CivilDay next(absl::CivilMonth(y, m) + 1);
+  return static_cast<int32_t>(next - absl::CivilDay(1970, 1, 1)) + 2440586;
+}
+
+class LeapTableHolderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    proto_.add_positive_leaps(2441499);  // 1972-06-30 12:00:00 UTC
+    proto_.add_positive_leaps(2441864);  // 1973-06-30 12:00:00 UTC
+    proto_.set_end_jdn(2442412);         // 1974-12-30 12:00:00 UTC
+  }
+
+  LeapTable Table(const LeapTableProto& proto) {
+    auto lt = NewLeapTableFromProto(proto);
+    EXPECT_TRUE(lt != nullptr);
+    return *lt;
+  }
+
+  LeapTableProto proto_;
+};
+
+TEST_F(LeapTableHolderTest, Get) {
+  LeapTableHolder holder(Table(proto_));
+  EXPECT_EQ(*holder.Get(), Table(proto_));
+  EXPECT_EQ(holder.Get()->expiration(), Noon(1974, 12, 31));
+}
+
+TEST_F(LeapTableHolderTest, UpdateExtends) {
+  LeapTableHolder holder(Table(proto_));
+  const std::shared_ptr<const LeapTable> old = holder.Get();
+  absl::Time utc = Noon(1975, 6, 1);
+  EXPECT_EQ(old->Unsmear(utc), absl::nullopt);
+
+  // Extend the table past a new leap second.
+  LeapTableProto next = proto_;
+  next.add_positive_leaps(2442413);  // 1974-12-31 12:00:00 UTC
+  next.set_end_jdn(2442593);         // 1975-06-29 12:00:00 UTC
+  EXPECT_TRUE(holder.Update(Table(next)));
+  EXPECT_EQ(*holder.Get(), Table(next));
+  EXPECT_EQ(holder.Get()->Unsmear(utc),
+            TaiEpoch() + 6360 * Hours(24) + Hours(12) + Seconds(13));
+
+  // The previous table remains valid.
+  EXPECT_EQ(*old, Table(proto_));
+
+  // Updating to an equal table succeeds and changes nothing.
+  const std::shared_ptr<const LeapTable> current = holder.Get();
+  EXPECT_TRUE(holder.Update(Table(next)));
+  EXPECT_EQ(holder.Get(), current);
+}
+
+TEST_F(LeapTableHolderTest, SnapshotsOutliveUpdates) {
+  auto holder = absl::make_unique<LeapTableHolder>(Table(proto_));
+  const std::shared_ptr<const LeapTable> first = holder->Get();
+
+  // Replaced tables are destroyed once no snapshot holds them, and no sooner:
+  // the first stays alive, held by first, and the others do not.
+  LeapTableProto next = proto_;
+  std::weak_ptr<const LeapTable> replaced;
+  for (int m = 1; m <= 12; ++m) {
+    next.set_end_jdn(EndJdn(1975, m));
+    replaced = holder->Get();
+    EXPECT_TRUE(holder->Update(Table(next)));
+    EXPECT_EQ(replaced.expired(), m > 1);
+    EXPECT_EQ(*first, Table(proto_));
+  }
+
+  // Snapshots also outlive the holder.
+  std::weak_ptr<const LeapTable> last = holder->Get();
+  std::shared_ptr<const LeapTable> kept = holder->Get();
+  holder.reset();
+  EXPECT_EQ(*first, Table(proto_));
+  EXPECT_EQ(*kept, Table(next));
+  kept.reset();
+  EXPECT_TRUE(last.expired());
+}
+
+TEST_F(LeapTableHolderTest, UpdateRejectsEarlierExpiration) {
+  LeapTableHolder holder(Table(proto_));
+  LeapTableProto next = proto_;
+  next.set_end_jdn(2442228);  // 1974-06-29 12:00:00 UTC
+  EXPECT_FALSE(holder.Update(Table(next)));
+  EXPECT_EQ(*holder.Get(), Table(proto_));
+}
+
+TEST_F(LeapTableHolderTest, UpdateRejectsChangedLeaps) {
+  LeapTableHolder holder(Table(proto_));
+
+  LeapTableProto added = proto_;
+  added.add_negative_leaps(2442048);  // 1973-12-31 12:00:00 UTC
+  added.set_end_jdn(2442777);         // 1975-12-30 12:00:00 UTC
+  EXPECT_FALSE(holder.Update(Table(added)));
+
+  LeapTableProto removed;
+  removed.add_positive_leaps(2441499);  // 1972-06-30 12:00:00 UTC
+  removed.set_end_jdn(2442777);         // 1975-12-30 12:00:00 UTC
+  EXPECT_FALSE(holder.Update(Table(removed)));
+
+  EXPECT_EQ(*holder.Get(), Table(proto_));
+}
+
+TEST_F(LeapTableHolderTest, UpdateFromProto) {
+  LeapTableHolder holder(Table(proto_));
+  LeapTableProto next = proto_;
+  next.set_end_jdn(2442593);  // 1975-06-29 12:00:00 UTC
+  EXPECT_TRUE(UpdateLeapTableHolder(next, &holder));
+  EXPECT_EQ(*holder.Get(), Table(next));
+}
+
+TEST_F(LeapTableHolderTest, UpdateRejectsInvalidProto) {
+  LeapTableHolder holder(Table(proto_));
+  LeapTableProto invalid = proto_;
+  invalid.set_end_jdn(2442777);  // 1975-12-30 12:00:00 UTC
+  invalid.add_positive_leaps(2442777);
+  EXPECT_FALSE(UpdateLeapTableHolder(invalid, &holder));
+  EXPECT_EQ(*holder.Get(), Table(proto_));
+}
+
+TEST_F(LeapTableHolderTest, UpdateFromMissingFile) {
+  LeapTableHolder holder(Table(proto_));
+  EXPECT_FALSE(
+      UpdateLeapTableHolderFromFile("/nonexistent/leap_table.pb", &holder));
+  EXPECT_EQ(*holder.Get(), Table(proto_));
+}
+
+TEST_F(LeapTableHolderTest, ConcurrentReaders) {
+  LeapTableHolder holder(Table(proto_));
+  absl::Time utc = Noon(1974, 6, 1);
+  TaiTime tai = *holder.Get()->Unsmear(utc);
+
+  // Readers always see some complete table, which stays valid while they use
+  // it, and conversions in the range of the first table never change.
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!done.load()) {
+        const std::shared_ptr<const LeapTable> lt = holder.Get();
+        ASSERT_EQ(lt->Unsmear(utc), tai);
+        ASSERT_GE(lt->expiration(), Noon(1974, 12, 31));
+      }
+    });
+  }
+
+  LeapTableProto next = proto_;
+  for (int m = 1; m <= 120; ++m) {
+    next.set_end_jdn(EndJdn(1975, m));  // Every month from 1975 to 1984.
+    EXPECT_TRUE(holder.Update(Table(next)));
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(*holder.Get(), Table(next));
+}
+
+}  // namespace
+}  // namespace unsmear
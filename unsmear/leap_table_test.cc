@@ -14,8 +14,16 @@
 
 #include "unsmear/unsmear.h"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <vector>
+
 #include "google/protobuf/util/message_differencer.h"
 #include "gtest/gtest.h"
+#include "unsmear/unsmear_proto.h"
 
 namespace unsmear {
 namespace {
@@ -197,6 +205,46 @@ TEST_F(LeapTableTest, RoundTrip) {
   }
 }
 
+TEST_F(LeapTableTest, ExactSmearRoundTrip) {
+  // Check every nanosecond near the ends of each smear, and runs of
+  // nanoseconds spaced irregularly through it.
+  constexpr int64_t kDayNs = 86400 * int64_t{1000000000};
+  std::vector<int64_t> offsets;
+  for (int64_t ns = 0; ns < 100000; ++ns) {
+    offsets.push_back(ns);
+    offsets.push_back(kDayNs - ns);
+  }
+  for (int64_t ns = 0; ns < kDayNs; ns += 86399999989) {
+    for (int64_t i = 0; i < 100; ++i) {
+      offsets.push_back(ns + i);
+    }
+  }
+
+  // A positive leap: unsmearing is one-to-one and smearing inverts it.
+  absl::Time utc_end = Noon(1973, 7, 1);
+  TaiTime tai_end = *lt_->Unsmear(utc_end);
+  for (int64_t ns : offsets) {
+    absl::Time utc = utc_end - absl::Nanoseconds(ns);
+    TaiTime tai = *lt_->Unsmear(utc);
+    ASSERT_EQ(tai_end - tai, Nanoseconds(ns + ns / 86400)) << utc;
+    ASSERT_EQ(lt_->Smear(tai), utc) << utc;
+  }
+
+  // A negative leap: smearing is one-to-one and unsmearing inverts it.
+  tai_end = *lt_->Unsmear(Noon(1974, 1, 1));
+  for (int64_t ns : offsets) {
+    if (ns > kDayNs - int64_t{1000000000}) continue;
+    TaiTime tai = tai_end - Nanoseconds(ns);
+    ASSERT_EQ(lt_->Unsmear(*lt_->Smear(tai)), tai) << tai;
+  }
+
+  // Sub-nanosecond remainders are carried through.
+  absl::Time utc = utc_end - absl::Hours(6) - absl::Nanoseconds(1) / 4;
+  EXPECT_EQ(lt_->Smear(*lt_->Unsmear(utc)), utc);
+  EXPECT_EQ(*lt_->Unsmear(utc + absl::Nanoseconds(1) / 4) - *lt_->Unsmear(utc),
+            Nanoseconds(1) / 4);
+}
+
 TEST_F(LeapTableTest, PastExpiration) {
   // The exact moment of expiration is precisely convertible.
   auto utc = lt_->expiration();
@@ -237,9 +285,867 @@ TEST_F(LeapTableTest, PastExpiration) {
       << utc;
 }
 
+TEST_F(LeapTableTest, FarPastExpiration) {
+  // Each month after expiration adds ±1 s of uncertainty, accrued during the
+  // smear that starts at noon on its last day.  Check the boundaries of every
+  // month through 2400, which covers every kind of month and leap year.
+  int64_t months = 0;
+  for (absl::CivilDay month(1985, 1, 1); month.year() <= 2400;
+       month = absl::CivilDay(absl::CivilMonth(month) + 1)) {
+    SCOPED_TRACE(month);
+    ++months;
+    absl::Time first = absl::FromCivil(month, absl::UTCTimeZone());
+    absl::Time utc = first - absl::Hours(12);
+    TaiTime tai = expiration_tai() + internal::MakeDuration(
+                                         utc - lt_->expiration());
+    for (auto pair :
+         {std::make_pair(utc - absl::Seconds(1), Seconds(months - 1)),
+          std::make_pair(utc, Seconds(months - 1)),
+          std::make_pair(first, Seconds(months - 1) + Milliseconds(500)),
+          std::make_pair(utc + absl::Hours(24), Seconds(months)),
+          std::make_pair(utc + absl::Hours(36), Seconds(months))}) {
+      TaiTime t = tai + internal::MakeDuration(pair.first - utc);
+      EXPECT_EQ(lt_->FutureProofUnsmear(pair.first),
+                std::make_pair(t - pair.second, t + pair.second))
+          << pair.first;
+      auto smeared = lt_->FutureProofSmear(t);
+      EXPECT_LE(smeared.first, pair.first) << t;
+      EXPECT_GE(smeared.second, pair.first) << t;
+      // If every leap second is positive, smearing inverts unsmearing.
+      EXPECT_EQ(lt_->FutureProofSmear(t + pair.second).first, pair.first)
+          << t;
+    }
+  }
+}
+
+TEST_F(LeapTableTest, WithFutureHorizon) {
+  const absl::Time until = lt_->expiration() + absl::Hours(3 * 365 * 24);
+  auto horizon = lt_->WithFutureHorizon(until);
+  ASSERT_TRUE(horizon != nullptr);
+  EXPECT_EQ(*horizon, *lt_);
+
+  // Step from before the expiration to past the horizon, and through every
+  // possible smear in it in finer steps.
+  std::vector<absl::Time> utc;
+  for (absl::Time t = lt_->expiration() - absl::Hours(24);
+       t < until + absl::Hours(62 * 24);
+       t += absl::Hours(5) + absl::Nanoseconds(7)) {
+    utc.push_back(t);
+  }
+  for (absl::CivilMonth month(1985, 1); month <= absl::CivilMonth(1988, 2);
+       ++month) {
+    const absl::Time first = absl::FromCivil(month, absl::UTCTimeZone());
+    for (absl::Time t = first - absl::Hours(13); t <= first + absl::Hours(13);
+         t += absl::Minutes(7) + absl::Nanoseconds(1)) {
+      utc.push_back(t);
+    }
+    utc.push_back(first - absl::Hours(12));
+    utc.push_back(first + absl::Hours(12));
+  }
+  utc.push_back(until);
+
+  for (absl::Time t : utc) {
+    SCOPED_TRACE(t);
+    auto unsmeared = lt_->FutureProofUnsmear(t);
+    ASSERT_EQ(horizon->FutureProofUnsmear(t), unsmeared);
+    ASSERT_EQ(horizon->FutureProofUnsmearToGps(t),
+              lt_->FutureProofUnsmearToGps(t));
+    ASSERT_EQ(horizon->Unsmear(t), lt_->Unsmear(t));
+    for (TaiTime tai : {unsmeared.first, unsmeared.second}) {
+      ASSERT_EQ(horizon->FutureProofSmear(tai), lt_->FutureProofSmear(tai));
+      ASSERT_EQ(horizon->FutureProofSmear(ToGpsTime(tai)),
+                lt_->FutureProofSmear(ToGpsTime(tai)));
+    }
+  }
+
+  // A horizon before the expiration has no effect, and replaces any horizon.
+  auto none = horizon->WithFutureHorizon(lt_->expiration());
+  ASSERT_TRUE(none != nullptr);
+  EXPECT_EQ(none->FutureProofUnsmear(until), lt_->FutureProofUnsmear(until));
+  EXPECT_TRUE(lt_->WithFutureHorizon(absl::InfiniteFuture()) == nullptr);
+}
+
+TEST_F(LeapTableTest, Batch) {
+  // Cover every segment of the table, with times before and after it and
+  // infinities at either end.
+  std::vector<absl::Time> utc = {absl::InfinitePast(),
+                                 ModernUtcEpoch() - absl::Nanoseconds(1)};
+  for (absl::Time t = ModernUtcEpoch();
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Hours(5) + absl::Nanoseconds(1)) {
+    utc.push_back(t);
+  }
+  utc.push_back(Noon(1973, 6, 30) + absl::Hours(6) + absl::Nanoseconds(3));
+  utc.push_back(lt_->expiration());
+  utc.push_back(absl::InfiniteFuture());
+
+  std::vector<TaiTime> tai(utc.size());
+  std::vector<GpsTime> gps(utc.size());
+  std::vector<bool> valid;
+  size_t expected = 0;
+  size_t expected_gps = 0;
+  for (absl::Time t : utc) {
+    if (lt_->Unsmear(t).has_value()) ++expected;
+    if (lt_->UnsmearToGps(t).has_value()) ++expected_gps;
+  }
+
+  ASSERT_EQ(lt_->Unsmear(utc, absl::MakeSpan(tai), &valid), expected);
+  ASSERT_EQ(valid.size(), utc.size());
+  for (size_t i = 0; i < utc.size(); ++i) {
+    SCOPED_TRACE(utc[i]);
+    auto unsmeared = lt_->Unsmear(utc[i]);
+    ASSERT_EQ(valid[i], unsmeared.has_value());
+    ASSERT_EQ(tai[i], unsmeared.value_or(TaiInfinitePast()));
+  }
+
+  ASSERT_EQ(lt_->UnsmearToGps(utc, absl::MakeSpan(gps), &valid),
+            expected_gps);
+  for (size_t i = 0; i < utc.size(); ++i) {
+    SCOPED_TRACE(utc[i]);
+    auto unsmeared = lt_->UnsmearToGps(utc[i]);
+    ASSERT_EQ(valid[i], unsmeared.has_value());
+    ASSERT_EQ(gps[i], unsmeared.value_or(GpsInfinitePast()));
+  }
+
+  // Unconvertible times were output as the infinite past, which smears to
+  // itself.
+  std::vector<absl::Time> smeared(utc.size());
+  ASSERT_EQ(lt_->Smear(tai, absl::MakeSpan(smeared), &valid), utc.size());
+  for (size_t i = 0; i < utc.size(); ++i) {
+    SCOPED_TRACE(utc[i]);
+    ASSERT_EQ(smeared[i], lt_->Smear(tai[i]));
+  }
+  ASSERT_EQ(lt_->Smear(gps, absl::MakeSpan(smeared), nullptr), utc.size());
+  for (size_t i = 0; i < utc.size(); ++i) {
+    SCOPED_TRACE(utc[i]);
+    ASSERT_EQ(smeared[i], lt_->Smear(gps[i]));
+  }
+
+  // Times before the GPST epoch cannot be smeared.
+  std::vector<GpsTime> early = {GpsEpoch() - Seconds(1), GpsEpoch()};
+  ASSERT_EQ(lt_->Smear(early, absl::MakeSpan(smeared).first(2), &valid), 1u);
+  EXPECT_EQ(valid, std::vector<bool>({false, true}));
+  EXPECT_EQ(smeared[0], absl::InfinitePast());
+  EXPECT_EQ(smeared[1], UtcGpsEpoch());
+}
+
+TEST_F(LeapTableTest, ParallelBatch) {
+  // Enough chunks for every thread, with sorted times across the whole table
+  // and then the same times shuffled, and unconvertible times at either end.
+  std::vector<absl::Time> utc = {absl::InfinitePast()};
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(1);
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Minutes(17) + absl::Nanoseconds(1)) {
+    utc.push_back(t);
+  }
+  const size_t sorted = utc.size();
+  for (size_t i = 0; i < sorted; ++i) {
+    utc.push_back(utc[(i * 7919) % sorted]);
+  }
+  utc.push_back(absl::InfiniteFuture());
+
+  // Runs the tasks on four threads, interleaved.
+  const LeapTable::Executor executor =
+      [](size_t n, const std::function<void(size_t)>& task) {
+        std::vector<std::thread> threads;
+        for (size_t k = 0; k < 4; ++k) {
+          threads.emplace_back([n, &task, k] {
+            for (size_t i = k; i < n; i += 4) task(i);
+          });
+        }
+        for (auto& thread : threads) {
+          thread.join();
+        }
+      };
+
+  for (const LeapTable::Executor& e : {executor, LeapTable::Executor()}) {
+    std::vector<TaiTime> tai(utc.size()), expected_tai(utc.size());
+    std::vector<bool> valid, expected_valid;
+    ASSERT_EQ(lt_->ParallelUnsmear(e, utc, absl::MakeSpan(tai), &valid),
+              lt_->Unsmear(utc, absl::MakeSpan(expected_tai),
+                           &expected_valid));
+    EXPECT_EQ(tai, expected_tai);
+    EXPECT_EQ(valid, expected_valid);
+
+    std::vector<GpsTime> gps(utc.size()), expected_gps(utc.size());
+    ASSERT_EQ(lt_->ParallelUnsmearToGps(e, utc, absl::MakeSpan(gps), &valid),
+              lt_->UnsmearToGps(utc, absl::MakeSpan(expected_gps),
+                                &expected_valid));
+    EXPECT_EQ(gps, expected_gps);
+    EXPECT_EQ(valid, expected_valid);
+
+    std::vector<absl::Time> smeared(utc.size()), expected(utc.size());
+    ASSERT_EQ(lt_->ParallelSmear(e, tai, absl::MakeSpan(smeared), &valid),
+              lt_->Smear(tai, absl::MakeSpan(expected), &expected_valid));
+    EXPECT_EQ(smeared, expected);
+    EXPECT_EQ(valid, expected_valid);
+    ASSERT_EQ(lt_->ParallelSmear(e, gps, absl::MakeSpan(smeared), nullptr),
+              lt_->Smear(gps, absl::MakeSpan(expected), nullptr));
+    EXPECT_EQ(smeared, expected);
+  }
+}
+
+TEST_F(LeapTableTest, Cursor) {
+  // Sorted times across the whole table and past its expiration, then back
+  // again in reverse, then jumping around.
+  std::vector<absl::Time> utc;
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(1);
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Hours(7) + absl::Nanoseconds(1)) {
+    utc.push_back(t);
+  }
+  utc.insert(utc.end(), utc.rbegin(), utc.rend());
+  for (size_t i = 0; i < 1000; ++i) {
+    utc.push_back(utc[(i * 7919) % utc.size()]);
+  }
+  utc.push_back(lt_->expiration());
+  utc.push_back(absl::InfiniteFuture());
+  utc.push_back(absl::InfinitePast());
+
+  LeapTable::Cursor cursor(*lt_);
+  for (absl::Time t : utc) {
+    SCOPED_TRACE(t);
+    ASSERT_EQ(cursor.Unsmear(t), lt_->Unsmear(t));
+    ASSERT_EQ(cursor.UnsmearToGps(t), lt_->UnsmearToGps(t));
+    TaiTime tai = lt_->FutureProofUnsmear(t).first;
+    ASSERT_EQ(cursor.Smear(tai), lt_->Smear(tai));
+    GpsTime gps = ToGpsTime(tai);
+    ASSERT_EQ(cursor.Smear(gps), lt_->Smear(gps));
+  }
+}
+
+TEST_F(LeapTableTest, InlineLeapTable) {
+  // Times across the whole table and past it, and each side of every boundary.
+  std::vector<absl::Time> utc;
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(1);
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Hours(7) + absl::Nanoseconds(1)) {
+    utc.push_back(t);
+  }
+  for (const auto& part :
+       lt_->UnsmearRange(ModernUtcEpoch(), lt_->expiration())) {
+    for (int64_t ns : {-1, 0, 1}) {
+      utc.push_back(part.begin + absl::Nanoseconds(ns));
+    }
+  }
+  for (absl::Time t : {UtcGpsEpoch(), lt_->expiration()}) {
+    for (int64_t ns : {-1, 0, 1}) {
+      utc.push_back(t + absl::Nanoseconds(ns));
+    }
+  }
+  utc.push_back(absl::InfiniteFuture());
+  utc.push_back(absl::InfinitePast());
+
+  InlineLeapTable table;
+  EXPECT_EQ(table.expiration(), absl::InfinitePast());
+  EXPECT_EQ(table.Unsmear(ModernUtcEpoch()), absl::nullopt);
+  EXPECT_EQ(table.Smear(TaiModernUtcEpoch()), absl::nullopt);
+  ASSERT_TRUE(table.Assign(*lt_));
+  EXPECT_EQ(table.expiration(), lt_->expiration());
+
+  // It has no pointers, so copies with memcpy work.
+  alignas(InlineLeapTable) char arena[sizeof(InlineLeapTable)];
+  std::memcpy(arena, &table, sizeof(table));
+  const auto& copy = *reinterpret_cast<const InlineLeapTable*>(arena);
+
+  for (absl::Time t : utc) {
+    SCOPED_TRACE(t);
+    ASSERT_EQ(copy.Unsmear(t), lt_->Unsmear(t));
+    ASSERT_EQ(copy.UnsmearToGps(t), lt_->UnsmearToGps(t));
+    TaiTime tai = lt_->FutureProofUnsmear(t).first;
+    ASSERT_EQ(copy.Smear(tai), lt_->Smear(tai));
+    for (Duration d : {-Nanoseconds(1), Nanoseconds(1)}) {
+      ASSERT_EQ(copy.Smear(tai + d), lt_->Smear(tai + d));
+    }
+    GpsTime gps = ToGpsTime(tai);
+    ASSERT_EQ(copy.Smear(gps), lt_->Smear(gps));
+  }
+}
+
+TEST(InlineLeapTableTest, Capacity) {
+  // A leap second at the end of every month, filling the table exactly.
+  LeapTableProto pb;
+  const absl::CivilMonth start(1972, 1);
+  auto last_jdn = [start](int64_t months) {
+    absl::CivilDay last = absl::CivilDay(start + months + 1) - 1;
+    return static_cast<int32_t>(2440588 + (last - absl::CivilDay(1970, 1, 1)));
+  };
+  const size_t leaps = (InlineLeapTable::kCapacity - 2) / 2;
+  for (size_t i = 0; i < leaps; ++i) {
+    pb.add_positive_leaps(last_jdn(i));
+  }
+  pb.set_end_jdn(last_jdn(leaps) - 1);
+  auto lt = NewLeapTableFromProto(pb);
+  ASSERT_TRUE(lt != nullptr);
+  InlineLeapTable table;
+  ASSERT_TRUE(table.Assign(*lt));
+  for (absl::Time t = ModernUtcEpoch(); t <= lt->expiration();
+       t += absl::Hours(5)) {
+    SCOPED_TRACE(t);
+    ASSERT_EQ(table.Unsmear(t), lt->Unsmear(t));
+  }
+
+  // One more leap second does not fit, and leaves the table unchanged.
+  pb.add_positive_leaps(last_jdn(leaps));
+  pb.set_end_jdn(last_jdn(leaps + 1) - 1);
+  auto larger = NewLeapTableFromProto(pb);
+  ASSERT_TRUE(larger != nullptr);
+  EXPECT_FALSE(table.Assign(*larger));
+  EXPECT_EQ(table.expiration(), lt->expiration());
+}
+
+TEST_F(LeapTableTest, Nanos) {
+  // Times across the whole table and past it, each side of every boundary, and
+  // through a positive and a negative smear in finer steps.
+  std::vector<absl::Time> utc;
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(1);
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Hours(7) + absl::Nanoseconds(1)) {
+    utc.push_back(t);
+  }
+  for (absl::Time smear : {Noon(1972, 6, 30), Noon(1973, 12, 31)}) {
+    for (absl::Time t = smear; t <= smear + absl::Hours(24);
+         t += absl::Seconds(97.123456789)) {
+      utc.push_back(t);
+    }
+  }
+  for (absl::Time t : {ModernUtcEpoch(), Noon(1972, 6, 30), Noon(1972, 7, 1),
+                       Noon(1973, 12, 31), Noon(1974, 1, 1), UtcGpsEpoch(),
+                       lt_->expiration()}) {
+    for (int64_t ns : {-1, 0, 1}) {
+      utc.push_back(t + absl::Nanoseconds(ns));
+    }
+  }
+
+  for (absl::Time t : utc) {
+    SCOPED_TRACE(t);
+    int64_t tai_ns = -1;
+    auto tai = lt_->Unsmear(t);
+    ASSERT_EQ(lt_->UnsmearNanos(absl::ToUnixNanos(t), &tai_ns),
+              tai.has_value());
+    if (tai.has_value()) {
+      EXPECT_EQ(tai_ns, ToInt64Nanoseconds(*tai - TaiEpoch()));
+    }
+    int64_t gps_ns = -1;
+    auto gps = lt_->UnsmearToGps(t);
+    ASSERT_EQ(lt_->UnsmearToGpsNanos(absl::ToUnixNanos(t), &gps_ns),
+              gps.has_value());
+    if (gps.has_value()) {
+      EXPECT_EQ(gps_ns, ToInt64Nanoseconds(*gps - GpsEpoch()));
+    }
+
+    TaiTime unsmeared = lt_->FutureProofUnsmear(t).first;
+    if (unsmeared == TaiInfinitePast()) {
+      // Infinities have no raw representation.
+      continue;
+    }
+    for (Duration d : {-Nanoseconds(1), ZeroDuration(), Nanoseconds(1)}) {
+      TaiTime tai = unsmeared + d;
+      int64_t utc_ns = -1;
+      auto smeared = lt_->Smear(tai);
+      ASSERT_EQ(lt_->SmearTaiNanos(ToInt64Nanoseconds(tai - TaiEpoch()),
+                                   &utc_ns),
+                smeared.has_value());
+      if (smeared.has_value()) {
+        EXPECT_EQ(utc_ns, absl::ToUnixNanos(*smeared));
+      }
+      GpsTime gps = ToGpsTime(tai);
+      smeared = lt_->Smear(gps);
+      ASSERT_EQ(lt_->SmearGpsNanos(ToInt64Nanoseconds(gps - GpsEpoch()),
+                                   &utc_ns),
+                smeared.has_value());
+      if (smeared.has_value()) {
+        EXPECT_EQ(utc_ns, absl::ToUnixNanos(*smeared));
+      }
+    }
+  }
+
+  // Failed conversions leave the output unchanged.
+  int64_t ns = 42;
+  EXPECT_FALSE(lt_->UnsmearNanos(std::numeric_limits<int64_t>::min(), &ns));
+  EXPECT_FALSE(lt_->UnsmearNanos(std::numeric_limits<int64_t>::max(), &ns));
+  EXPECT_FALSE(lt_->SmearTaiNanos(std::numeric_limits<int64_t>::min(), &ns));
+  EXPECT_FALSE(lt_->SmearGpsNanos(std::numeric_limits<int64_t>::max(), &ns));
+  EXPECT_EQ(ns, 42);
+}
+
+TEST_F(LeapTableTest, GpsWeeks) {
+  // Sorted times from before the GPST epoch to past the expiration, each side
+  // of every boundary, then jumping around, and some that cannot be converted.
+  std::vector<absl::Time> utc;
+  for (absl::Time t = UtcGpsEpoch() - absl::Hours(24 * 400);
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Hours(7) + absl::Nanoseconds(1.25)) {
+    utc.push_back(t);
+  }
+  for (const auto& part : lt_->UnsmearRange(UtcGpsEpoch(), lt_->expiration())) {
+    for (int64_t ns : {-1, 0, 1}) {
+      utc.push_back(part.begin + absl::Nanoseconds(ns));
+    }
+  }
+  for (size_t i = 0; i < 1000; ++i) {
+    utc.push_back(utc[(i * 7919) % utc.size()]);
+  }
+  for (absl::Time t : {UtcGpsEpoch(), lt_->expiration()}) {
+    for (int64_t ns : {-1, 0, 1}) {
+      utc.push_back(t + absl::Nanoseconds(ns));
+    }
+  }
+  utc.push_back(absl::FromUnixSeconds(int64_t{1} << 40));
+  utc.push_back(absl::InfiniteFuture());
+  utc.push_back(absl::InfinitePast());
+
+  std::vector<GpsWeekTime> gps(utc.size());
+  std::vector<bool> valid;
+  size_t converted = lt_->UnsmearToGpsWeeks(utc, absl::MakeSpan(gps), &valid);
+  size_t expected = 0;
+  for (size_t i = 0; i < utc.size(); ++i) {
+    SCOPED_TRACE(utc[i]);
+    int64_t gps_ns;
+    bool ok = utc[i] != absl::InfiniteFuture() &&
+              utc[i] != absl::InfinitePast() &&
+              lt_->UnsmearToGpsNanos(absl::ToUnixNanos(utc[i]), &gps_ns);
+    ASSERT_EQ(valid[i], ok);
+    if (ok) {
+      ++expected;
+      int64_t ns;
+      ASSERT_TRUE(GpsWeekTimeToNanos(gps[i], &ns));
+      EXPECT_EQ(ns, gps_ns);
+      EXPECT_GE(gps[i].tow_nanos, 0);
+      EXPECT_LT(gps[i].tow_nanos, kGpsWeekNanos);
+    } else {
+      EXPECT_EQ(gps[i].week, std::numeric_limits<int64_t>::min());
+    }
+  }
+  EXPECT_EQ(converted, expected);
+
+  // Back again, and from some week numbers that cannot be converted.  The
+  // infinities stay at the week that marks errors.
+  for (size_t i = 0; i < utc.size(); ++i) {
+    if (!valid[i]) {
+      gps[i] = ToGpsWeekTime(lt_->FutureProofUnsmearToGps(utc[i]).first);
+    }
+    if (utc[i] == absl::InfiniteFuture() || utc[i] == absl::InfinitePast()) {
+      EXPECT_EQ(gps[i].week, std::numeric_limits<int64_t>::min());
+    }
+  }
+  gps.push_back({-1, kGpsWeekNanos - 1});
+  gps.push_back({std::numeric_limits<int64_t>::max(), 0});
+  gps.push_back({std::numeric_limits<int64_t>::min(), 0});
+  std::vector<absl::Time> smeared(gps.size());
+  converted = lt_->SmearGpsWeeks(gps, absl::MakeSpan(smeared), &valid);
+  expected = 0;
+  for (size_t i = 0; i < gps.size(); ++i) {
+    SCOPED_TRACE(FromGpsWeekTime(gps[i]));
+    int64_t gps_ns;
+    int64_t utc_ns;
+    bool ok = GpsWeekTimeToNanos(gps[i], &gps_ns) &&
+              lt_->SmearGpsNanos(gps_ns, &utc_ns);
+    ASSERT_EQ(valid[i], ok);
+    if (ok) {
+      ++expected;
+      EXPECT_EQ(smeared[i], absl::FromUnixNanos(utc_ns));
+    } else {
+      EXPECT_EQ(smeared[i], absl::InfinitePast());
+    }
+  }
+  EXPECT_EQ(converted, expected);
+}
+
+TEST_F(LeapTableTest, PreciseRange) {
+  const LeapTable::PreciseBounds b = lt_->PreciseRange();
+  EXPECT_EQ(b.utc_begin, ModernUtcEpoch());
+  EXPECT_EQ(b.utc_end, lt_->expiration());
+  EXPECT_EQ(b.tai_begin, TaiModernUtcEpoch());
+  EXPECT_EQ(b.tai_end, lt_->Unsmear(b.utc_end));
+  EXPECT_EQ(b.gps_begin, GpsEpoch());
+  EXPECT_EQ(b.gps_end, lt_->UnsmearToGps(b.utc_end));
+
+  // The bounds are the edges of the precise range.
+  const absl::Duration ns = absl::Nanoseconds(1);
+  EXPECT_EQ(lt_->Smear(b.tai_begin), b.utc_begin);
+  EXPECT_EQ(lt_->Smear(b.tai_end), b.utc_end);
+  EXPECT_EQ(lt_->Smear(b.gps_begin), UtcGpsEpoch());
+  EXPECT_EQ(lt_->Smear(b.gps_end), b.utc_end);
+  EXPECT_EQ(lt_->Unsmear(b.utc_begin - ns), absl::nullopt);
+  EXPECT_EQ(lt_->Unsmear(b.utc_end + ns), absl::nullopt);
+  EXPECT_EQ(lt_->Smear(b.tai_begin - Nanoseconds(1)), absl::nullopt);
+  EXPECT_EQ(lt_->Smear(b.tai_end + Nanoseconds(1)), absl::nullopt);
+  EXPECT_EQ(lt_->Smear(b.gps_begin - Nanoseconds(1)), absl::nullopt);
+  EXPECT_EQ(lt_->Smear(b.gps_end + Nanoseconds(1)), absl::nullopt);
+  EXPECT_EQ(lt_->UnsmearToGps(UtcGpsEpoch() - ns), absl::nullopt);
+}
+
+TEST_F(LeapTableTest, Unchecked) {
+  // Within the precise range, the unchecked conversions give the same results
+  // as the checked ones.
+  const LeapTable::PreciseBounds b = lt_->PreciseRange();
+  for (absl::Time t :
+       {b.utc_begin, UtcGpsEpoch(), b.utc_end, b.utc_end - absl::Nanoseconds(1),
+        absl::FromDateTime(1973, 12, 31, 11, 59, 59, absl::UTCTimeZone())}) {
+    SCOPED_TRACE(t);
+    EXPECT_EQ(lt_->UnsmearUnchecked(t), lt_->Unsmear(t));
+  }
+  EXPECT_EQ(lt_->SmearUnchecked(b.tai_begin), b.utc_begin);
+  EXPECT_EQ(lt_->SmearUnchecked(b.tai_end), b.utc_end);
+  EXPECT_EQ(lt_->SmearUnchecked(b.gps_begin), UtcGpsEpoch());
+  EXPECT_EQ(lt_->SmearUnchecked(b.gps_end), b.utc_end);
+  EXPECT_EQ(lt_->UnsmearToGpsUnchecked(UtcGpsEpoch()), b.gps_begin);
+
+  for (absl::Time t = b.utc_begin; t <= b.utc_end;
+       t += absl::Hours(5) + absl::Nanoseconds(3)) {
+    SCOPED_TRACE(t);
+    const TaiTime tai = lt_->UnsmearUnchecked(t);
+    EXPECT_EQ(tai, lt_->Unsmear(t));
+    EXPECT_EQ(lt_->SmearUnchecked(tai), lt_->Smear(tai));
+    if (t >= UtcGpsEpoch()) {
+      const GpsTime gps = lt_->UnsmearToGpsUnchecked(t);
+      EXPECT_EQ(gps, lt_->UnsmearToGps(t));
+      EXPECT_EQ(lt_->SmearUnchecked(gps), lt_->Smear(gps));
+    }
+  }
+}
+
+TEST_F(LeapTableTest, ElapsedTT) {
+  const absl::Time smear_start =
+      absl::FromDateTime(1972, 6, 30, 12, 0, 0, absl::UTCTimeZone());
+  // Outside of smears, elapsed TT is the elapsed smeared time.
+  EXPECT_EQ(lt_->ElapsedTT(ModernUtcEpoch(), smear_start),
+            internal::MakeDuration(smear_start - ModernUtcEpoch()));
+  // A whole smear takes one second more, and half of it half a second.
+  EXPECT_EQ(lt_->ElapsedTT(smear_start, smear_start + absl::Hours(24)),
+            Hours(24) + Seconds(1));
+  EXPECT_EQ(lt_->ElapsedTT(smear_start + absl::Hours(12), smear_start),
+            -Hours(12) - Milliseconds(500));
+  EXPECT_EQ(lt_->ElapsedTT(ModernUtcEpoch(), lt_->expiration()),
+            expiration_tai() - TaiModernUtcEpoch());
+  EXPECT_EQ(lt_->ElapsedTT(ModernUtcEpoch() - absl::Nanoseconds(1),
+                           smear_start),
+            absl::nullopt);
+  EXPECT_EQ(lt_->ElapsedTT(smear_start,
+                           lt_->expiration() + absl::Nanoseconds(1)),
+            absl::nullopt);
+  EXPECT_EQ(lt_->ElapsedTT(smear_start, absl::InfiniteFuture()),
+            InfiniteDuration());
+
+  // Every pair of times agrees with the difference of unsmeared times.
+  std::vector<absl::Time> a, b;
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(7);
+       t <= lt_->expiration() + absl::Hours(7);
+       t += absl::Hours(7) + absl::Nanoseconds(3)) {
+    for (absl::Duration d : {absl::ZeroDuration(), absl::Seconds(1),
+                             -absl::Hours(11), absl::Hours(36)}) {
+      a.push_back(t);
+      b.push_back(t + d);
+    }
+  }
+  std::vector<Duration> elapsed(a.size());
+  std::vector<bool> valid;
+  size_t converted = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    SCOPED_TRACE(a[i]);
+    SCOPED_TRACE(b[i]);
+    const auto tai_a = lt_->Unsmear(a[i]);
+    const auto tai_b = lt_->Unsmear(b[i]);
+    if (tai_a.has_value() && tai_b.has_value()) {
+      EXPECT_EQ(lt_->ElapsedTT(a[i], b[i]), *tai_b - *tai_a);
+      EXPECT_EQ(lt_->FutureProofElapsedTT(a[i], b[i]),
+                std::make_pair(*tai_b - *tai_a, *tai_b - *tai_a));
+      ++converted;
+    } else {
+      EXPECT_EQ(lt_->ElapsedTT(a[i], b[i]), absl::nullopt);
+    }
+  }
+  EXPECT_EQ(lt_->ElapsedTT(a, b, absl::MakeSpan(elapsed), &valid), converted);
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(valid[i], lt_->ElapsedTT(a[i], b[i]).has_value());
+    EXPECT_EQ(elapsed[i], lt_->ElapsedTT(a[i], b[i]).value_or(
+                              InfiniteDuration()));
+  }
+}
+
+TEST_F(LeapTableTest, FutureProofElapsedTT) {
+  const absl::Time expiration = lt_->expiration();
+  // The smear after the expiration adds ±1 s, and is then past.
+  EXPECT_EQ(lt_->FutureProofElapsedTT(expiration - absl::Hours(1),
+                                      expiration + 3 * absl::Hours(24)),
+            std::make_pair(Hours(73) - Seconds(1), Hours(73) + Seconds(1)));
+  EXPECT_EQ(lt_->FutureProofElapsedTT(expiration + absl::Hours(24),
+                                      expiration + 3 * absl::Hours(24)),
+            std::make_pair(Hours(48), Hours(48)));
+  EXPECT_EQ(lt_->FutureProofElapsedTT(expiration + 3 * absl::Hours(24),
+                                      expiration + 45 * absl::Hours(24)),
+            std::make_pair(42 * Hours(24) - Seconds(1),
+                           42 * Hours(24) + Seconds(1)));
+  EXPECT_EQ(lt_->FutureProofElapsedTT(expiration + 45 * absl::Hours(24),
+                                      expiration + 3 * absl::Hours(24)),
+            std::make_pair(-42 * Hours(24) - Seconds(1),
+                           -42 * Hours(24) + Seconds(1)));
+  EXPECT_EQ(lt_->FutureProofElapsedTT(ModernUtcEpoch() - absl::Hours(1),
+                                      expiration),
+            std::make_pair(-InfiniteDuration(), InfiniteDuration()));
+}
+
+TEST_F(LeapTableTest, NtpAndPtp) {
+  // The GPST epoch, 1980-01-06 00:00:00 UTC and 00:00:19 TAI.
+  PtpTimestamp ptp;
+  ASSERT_TRUE(lt_->NtpToPtp(uint64_t{2524953600} << 32, 0, &ptp));
+  EXPECT_EQ(ptp.seconds, 315964819);
+  EXPECT_EQ(ptp.nanoseconds, 0);
+  uint64_t ntp = 0;
+  int era = -1;
+  ASSERT_TRUE(lt_->PtpToNtp(ptp, &ntp, &era));
+  EXPECT_EQ(ntp, uint64_t{2524953600} << 32);
+  EXPECT_EQ(era, 0);
+
+  // Results are those of the conversions on nanoseconds, across the table.
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(1);
+       t < lt_->expiration() + absl::Hours(48);
+       t += absl::Hours(7) + absl::Nanoseconds(1)) {
+    SCOPED_TRACE(t);
+    UnixNanosToNtp(absl::ToUnixNanos(t), &ntp, &era);
+    int64_t tai;
+    ptp = PtpTimestamp();
+    bool ok = lt_->UnsmearNanos(absl::ToUnixNanos(t), &tai);
+    ASSERT_EQ(lt_->NtpToPtp(ntp, era, &ptp), ok);
+    if (!ok) {
+      EXPECT_EQ(ptp.seconds, 0);
+      continue;
+    }
+    int64_t ptp_ns;
+    ASSERT_TRUE(PtpToTaiNanos(ptp, &ptp_ns));
+    EXPECT_EQ(ptp_ns, tai);
+
+    int64_t utc;
+    ASSERT_TRUE(lt_->SmearTaiNanos(tai, &utc));
+    uint64_t smeared;
+    int smeared_era;
+    ASSERT_TRUE(lt_->PtpToNtp(ptp, &smeared, &smeared_era));
+    int64_t smeared_ns;
+    ASSERT_TRUE(NtpToUnixNanos(smeared, smeared_era, &smeared_ns));
+    EXPECT_EQ(smeared_ns, utc);
+  }
+
+  // Times past the expiration and invalid timestamps are not converted.
+  ntp = 0;
+  ptp.seconds = 0;
+  EXPECT_FALSE(lt_->NtpToPtp(~uint64_t{0}, 0, &ptp));
+  EXPECT_FALSE(lt_->NtpToPtp(0, 3, &ptp));
+  EXPECT_EQ(ptp.seconds, 0);
+  ptp.nanoseconds = 1000000000;
+  EXPECT_FALSE(lt_->PtpToNtp(ptp, &ntp, &era));
+  EXPECT_EQ(ntp, 0);
+}
+
+TEST(FarFutureLeapTableTest, Nanos) {
+  // Unsmeared times overflow about 12 years before smeared times do.
+  LeapTableProto pb;
+  pb.set_end_jdn(5373483);  // 9999-12-30 12:00:00 UTC
+  auto lt = NewLeapTableFromProto(pb);
+  ASSERT_TRUE(lt != nullptr);
+  const int64_t offset = ToInt64Nanoseconds(TaiModernUtcEpoch() - TaiEpoch()) -
+                         absl::ToUnixNanos(ModernUtcEpoch());
+  const int64_t last = std::numeric_limits<int64_t>::max() - offset;
+  int64_t ns;
+  ASSERT_TRUE(lt->UnsmearNanos(last, &ns));
+  EXPECT_EQ(ns, std::numeric_limits<int64_t>::max());
+  EXPECT_FALSE(lt->UnsmearNanos(last + 1, &ns));
+  ASSERT_TRUE(lt->SmearTaiNanos(std::numeric_limits<int64_t>::max(), &ns));
+  EXPECT_EQ(ns, last);
+
+  // The batch versions convert the same times from a cached segment.
+  const std::vector<absl::Time> utc = {
+      ModernUtcEpoch() + absl::Hours(24 * 3000), absl::FromUnixNanos(last),
+      absl::FromUnixNanos(last + 1)};
+  std::vector<GpsWeekTime> gps(utc.size());
+  std::vector<bool> valid;
+  EXPECT_EQ(lt->UnsmearToGpsWeeks(utc, absl::MakeSpan(gps), &valid), 2);
+  EXPECT_EQ(valid, std::vector<bool>({true, true, false}));
+  std::vector<absl::Time> smeared(gps.size());
+  EXPECT_EQ(lt->SmearGpsWeeks(gps, absl::MakeSpan(smeared)), 2);
+  EXPECT_EQ(smeared[1], utc[1]);
+}
+
+TEST_F(LeapTableTest, SegmentAt) {
+  std::vector<absl::Time> utc;
+  for (absl::Time t = ModernUtcEpoch(); t <= lt_->expiration();
+       t += absl::Hours(5) + absl::Nanoseconds(1)) {
+    utc.push_back(t);
+  }
+  for (absl::Time t = Noon(1973, 12, 31); t <= Noon(1974, 1, 1);
+       t += absl::Seconds(97.123456789)) {
+    utc.push_back(t);
+  }
+  utc.push_back(lt_->expiration());
+
+  for (absl::Time t : utc) {
+    SCOPED_TRACE(t);
+    auto segment = lt_->SegmentAt(t);
+    ASSERT_TRUE(segment.has_value());
+    EXPECT_LE(segment->utc_begin(), t);
+    EXPECT_LE(t, segment->utc_end());
+    TaiTime tai = segment->Convert(t);
+    EXPECT_EQ(tai, lt_->Unsmear(t));
+    auto tai_segment = lt_->SegmentAt(tai);
+    ASSERT_TRUE(tai_segment.has_value());
+    EXPECT_EQ(tai_segment->Convert(tai), lt_->Smear(tai));
+
+    // The integer conversions documented for kernels give the same results,
+    // for times in whole nanoseconds.
+    const int64_t utc_end = absl::ToUnixNanos(segment->utc_end());
+    const int64_t tai_end = ToInt64Nanoseconds(segment->tai_end() - TaiEpoch());
+    int64_t d = utc_end - absl::ToUnixNanos(t);
+    EXPECT_EQ(tai_end - d - segment->smear() * (d / 86400),
+              ToInt64Nanoseconds(tai - TaiEpoch()));
+    const int s = tai_segment->smear();
+    d = ToInt64Nanoseconds(tai_segment->tai_end() - tai);
+    EXPECT_EQ(absl::ToUnixNanos(tai_segment->utc_end()) - d +
+                  (s > 0 ? d / 86401 : s < 0 ? -(d / 86399) : 0),
+              absl::ToUnixNanos(*lt_->Smear(tai)));
+  }
+
+  // Times at boundaries are in the later segment, except at the expiration.
+  auto segment = lt_->SegmentAt(Noon(1973, 12, 31));
+  ASSERT_TRUE(segment.has_value());
+  EXPECT_EQ(segment->utc_begin(), Noon(1973, 12, 31));
+  EXPECT_EQ(segment->utc_end(), Noon(1974, 1, 1));
+  EXPECT_EQ(segment->smear(), -1);
+  EXPECT_EQ(segment->offset(), Seconds(11));
+  segment = lt_->SegmentAt(segment->tai_begin());
+  ASSERT_TRUE(segment.has_value());
+  EXPECT_EQ(segment->utc_begin(), Noon(1973, 12, 31));
+  segment = lt_->SegmentAt(lt_->expiration());
+  ASSERT_TRUE(segment.has_value());
+  EXPECT_EQ(segment->utc_end(), lt_->expiration());
+  EXPECT_EQ(segment->tai_end(), expiration_tai());
+  EXPECT_EQ(segment, lt_->SegmentAt(expiration_tai()));
+
+  EXPECT_EQ(lt_->SegmentAt(ModernUtcEpoch() - absl::Nanoseconds(1)),
+            absl::nullopt);
+  EXPECT_EQ(lt_->SegmentAt(lt_->expiration() + absl::Nanoseconds(1)),
+            absl::nullopt);
+  EXPECT_EQ(lt_->SegmentAt(TaiModernUtcEpoch() - Nanoseconds(1)),
+            absl::nullopt);
+  EXPECT_EQ(lt_->SegmentAt(expiration_tai() + Nanoseconds(1)), absl::nullopt);
+}
+
+TEST_F(LeapTableTest, UnsmearRange) {
+  const absl::Time begin = ModernUtcEpoch() - absl::Hours(1);
+  const absl::Time end = lt_->expiration() + absl::Hours(24 * 400);
+  const auto parts = lt_->UnsmearRange(begin, end);
+  ASSERT_FALSE(parts.empty());
+  EXPECT_EQ(parts.front().begin, ModernUtcEpoch());
+  EXPECT_EQ(parts.back().end, end);
+
+  // The parts are contiguous, and convert the times in them as the leap table
+  // does, both within its validity range and past it.
+  size_t precise = 0;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    const auto& part = parts[i];
+    SCOPED_TRACE(part.begin);
+    ASSERT_LT(part.begin, part.end);
+    if (i > 0) {
+      ASSERT_EQ(part.begin, parts[i - 1].end);
+    }
+    if (part.end <= lt_->expiration()) {
+      ++precise;
+      EXPECT_EQ(part.earliest, part.latest);
+    }
+    EXPECT_GE(part.begin, part.earliest.utc_begin());
+    EXPECT_LE(part.end, part.earliest.utc_end());
+    const absl::Duration length = part.end - part.begin;
+    for (absl::Time t : {part.begin, part.begin + length / 3,
+                         part.end - absl::Nanoseconds(1)}) {
+      SCOPED_TRACE(t);
+      auto expected = lt_->FutureProofUnsmear(t);
+      EXPECT_EQ(part.earliest.Convert(t), expected.first);
+      EXPECT_EQ(part.latest.Convert(t), expected.second);
+    }
+  }
+  // Each leap second has a smear and the segment after it.
+  EXPECT_EQ(precise, 2 * proto_.positive_leaps_size() +
+                         2 * proto_.negative_leaps_size() + 1);
+  // And each possible future leap second has the same.
+  EXPECT_EQ(parts.size() - precise, 2 * 14);
+  EXPECT_EQ(parts.back().earliest.offset(), Seconds(19 - 14));
+  EXPECT_EQ(parts.back().latest.offset(), Seconds(19 + 14));
+
+  // Ranges within a segment have one part.
+  const absl::Time t = Noon(1976, 6, 1);
+  const auto within = lt_->UnsmearRange(t, t + absl::Hours(1));
+  ASSERT_EQ(within.size(), 1);
+  EXPECT_EQ(within[0].begin, t);
+  EXPECT_EQ(within[0].end, t + absl::Hours(1));
+  EXPECT_EQ(within[0].earliest.offset(), Seconds(13));
+  EXPECT_EQ(within[0].earliest.smear(), 0);
+
+  // Ranges past the expiration start in the part containing their beginning.
+  const auto future =
+      lt_->UnsmearRange(Noon(1990, 1, 15), Noon(1990, 2, 15));
+  ASSERT_EQ(future.size(), 3);
+  EXPECT_EQ(future[0].end, Noon(1990, 1, 31));
+  EXPECT_EQ(future[1].end, Noon(1990, 2, 1));
+  EXPECT_EQ(future[1].latest.smear(), 1);
+
+  EXPECT_TRUE(lt_->UnsmearRange(t, t).empty());
+  EXPECT_TRUE(
+      lt_->UnsmearRange(absl::InfinitePast(), ModernUtcEpoch()).empty());
+  EXPECT_TRUE(lt_->UnsmearRange(t, absl::InfiniteFuture()).empty());
+}
+
+TEST_F(LeapTableTest, SmearRange) {
+  const TaiTime begin = TaiModernUtcEpoch() - Hours(1);
+  const TaiTime end = expiration_tai() + Hours(24 * 400);
+  const auto parts = lt_->SmearRange(begin, end);
+  ASSERT_FALSE(parts.empty());
+  EXPECT_EQ(parts.front().begin, TaiModernUtcEpoch());
+  EXPECT_EQ(parts.back().end, end);
+
+  for (size_t i = 0; i < parts.size(); ++i) {
+    const auto& part = parts[i];
+    SCOPED_TRACE(FormatTime(part.begin));
+    ASSERT_LT(part.begin, part.end);
+    if (i > 0) {
+      ASSERT_EQ(part.begin, parts[i - 1].end);
+    }
+    EXPECT_GE(part.begin, part.earliest.tai_begin());
+    EXPECT_LE(part.end, part.earliest.tai_end());
+    EXPECT_GE(part.begin, part.latest.tai_begin());
+    EXPECT_LE(part.end, part.latest.tai_end());
+    const Duration length = part.end - part.begin;
+    for (TaiTime t :
+         {part.begin, part.begin + length / 3, part.end - Nanoseconds(1)}) {
+      SCOPED_TRACE(FormatTime(t));
+      if (part.end <= expiration_tai()) {
+        EXPECT_EQ(part.earliest, part.latest);
+        EXPECT_EQ(part.earliest.Convert(t), lt_->Smear(t));
+      } else {
+        auto expected = lt_->FutureProofSmear(t);
+        EXPECT_EQ(part.earliest.Convert(t), expected.first);
+        EXPECT_EQ(part.latest.Convert(t), expected.second);
+        EXPECT_LE(part.earliest.Convert(t), part.latest.Convert(t));
+      }
+    }
+  }
+
+  EXPECT_TRUE(lt_->SmearRange(end, end).empty());
+  EXPECT_TRUE(lt_->SmearRange(begin, TaiInfiniteFuture()).empty());
+}
+
+TEST_F(LeapTableTest, UnsmearString) {
+  EXPECT_EQ(UnsmearString(*lt_, "1973-07-01 00:00:00 UTC"),
+            lt_->Unsmear(Noon(1973, 6, 30) + absl::Hours(12)));
+  EXPECT_EQ(UnsmearString(*lt_, "1973-07-01 00:00:00.25 UTC"),
+            lt_->Unsmear(Noon(1973, 6, 30) + absl::Hours(12) +
+                         absl::Milliseconds(250)));
+  EXPECT_EQ(UnsmearString(*lt_, "1971-07-01 00:00:00 UTC"), absl::nullopt);
+  EXPECT_EQ(UnsmearString(*lt_, "1999-07-01 00:00:00 UTC"), absl::nullopt);
+  EXPECT_EQ(UnsmearString(*lt_, "1973-07-01 00:00:00 TAI"), absl::nullopt);
+}
+
 TEST_F(LeapTableTest, ToProto) {
   LeapTableProto proto2;
-  lt_->ToProto(&proto2);
+  LeapTableToProto(*lt_, &proto2);
 
   std::string diffs;
   google::protobuf::util::MessageDifferencer differencer;
@@ -252,6 +1158,172 @@ TEST_F(LeapTableTest, ToProto) {
   ASSERT_EQ(*lt_, *lt2);
 }
 
+TEST_F(LeapTableTest, Builder) {
+  LeapTableBuilder builder;
+  for (int32_t jdn : proto_.positive_leaps()) {
+    builder.AddPositiveLeap(jdn);
+  }
+  for (int32_t jdn : proto_.negative_leaps()) {
+    builder.AddNegativeLeap(jdn);
+  }
+  builder.SetEndJdn(proto_.end_jdn());
+  auto lt = builder.Build();
+  ASSERT_TRUE(lt != nullptr);
+  EXPECT_EQ(*lt, *lt_);
+
+  // Starting from a table gives back its leap seconds in increasing order.
+  LeapTableBuilder copy(*lt_);
+  EXPECT_EQ(copy.positive_leaps(), builder.positive_leaps());
+  EXPECT_EQ(copy.negative_leaps(), builder.negative_leaps());
+  EXPECT_EQ(copy.end_jdn(), proto_.end_jdn());
+
+  // Leap seconds may be added in any order, and are validated as for
+  // protobufs.
+  LeapTableBuilder reversed;
+  reversed.AddPositiveLeap(2441864);  // 1973-06-30
+  reversed.AddPositiveLeap(2441499);  // 1972-06-30
+  EXPECT_EQ(reversed.Build(), nullptr);
+  reversed.SetEndJdn(2442047);  // 1973-12-30
+  lt = reversed.Build();
+  ASSERT_TRUE(lt != nullptr);
+  EXPECT_EQ(LeapTableBuilder(*lt).positive_leaps(),
+            std::vector<int32_t>({2441499, 2441864}));
+  reversed.AddNegativeLeap(2441864);
+  EXPECT_EQ(reversed.Build(), nullptr);
+}
+
+// Expects the tables to have the same contents, including their day indexes.
+void ExpectSameData(const LeapTable& a, const LeapTable& b) {
+  const internal::LeapTableData x = internal::GetLeapTableData(a);
+  const internal::LeapTableData y = internal::GetLeapTableData(b);
+  EXPECT_EQ(x.utc_seconds, y.utc_seconds);
+  EXPECT_EQ(x.tai_seconds, y.tai_seconds);
+  EXPECT_EQ(x.smears, y.smears);
+  EXPECT_EQ(x.utc_day_index, y.utc_day_index);
+  EXPECT_EQ(x.tai_day_index, y.tai_day_index);
+}
+
+TEST_F(LeapTableTest, Extend) {
+  // A new expiration, a leap second at the old expiration, and one later.
+  LeapTableBuilder builder(*lt_);
+  builder.SetEndJdn(2446246);  // 1985-06-29
+  auto extended = lt_->Extend(2446246);
+  ASSERT_TRUE(extended != nullptr);
+  ExpectSameData(*extended, *builder.Build());
+
+  builder.AddPositiveLeap(2446066);  // 1984-12-31
+  extended = lt_->Extend(2446246, 2446066, 1);
+  ASSERT_TRUE(extended != nullptr);
+  ExpectSameData(*extended, *builder.Build());
+
+  // Extending an extended table fills in its new days after those of the
+  // table, in the same arrays.
+  const LeapTableBuilder no_leap = builder;
+  builder.AddNegativeLeap(2446247);  // 1985-06-30
+  builder.SetEndJdn(2446611);        // 1986-06-29
+  auto next = extended->Extend(2446611, 2446247, -1);
+  ASSERT_TRUE(next != nullptr);
+  ExpectSameData(*next, *builder.Build());
+  EXPECT_EQ(internal::GetLeapTableData(*next).utc_day_index.data(),
+            internal::GetLeapTableData(*extended).utc_day_index.data());
+  EXPECT_EQ(internal::GetLeapTableData(*next).tai_day_index.data(),
+            internal::GetLeapTableData(*extended).tai_day_index.data());
+  // After a positive and a negative leap second, TAI - UTC is as it was.
+  EXPECT_EQ(*next->Unsmear(Noon(1985, 7, 1)) - *lt_->Unsmear(lt_->expiration()),
+            internal::MakeDuration(Noon(1985, 7, 1) - lt_->expiration()));
+
+  // Extending the same table differently copies its days instead, leaving the
+  // first extension unchanged.
+  auto other = extended->Extend(2446430);  // 1985-12-30
+  ASSERT_TRUE(other != nullptr);
+  LeapTableBuilder other_builder = no_leap;
+  other_builder.SetEndJdn(2446430);
+  ExpectSameData(*other, *other_builder.Build());
+  EXPECT_NE(internal::GetLeapTableData(*other).utc_day_index.data(),
+            internal::GetLeapTableData(*extended).utc_day_index.data());
+  ExpectSameData(*next, *builder.Build());
+
+  // A leap second at an expiration at the start of a TAI day, before the first
+  // leap second, changes the segment of that day.
+  LeapTableBuilder early;
+  early.SetEndJdn(2441498);  // 1972-06-29
+  auto early_table = early.Build();
+  ASSERT_TRUE(early_table != nullptr);
+  early.AddPositiveLeap(2441499);  // 1972-06-30
+  early.SetEndJdn(2441682);        // 1972-12-30
+  extended = early_table->Extend(2441682, 2441499, 1);
+  ASSERT_TRUE(extended != nullptr);
+  ExpectSameData(*extended, *early.Build());
+
+  // Extending to the same expiration changes nothing.
+  extended = lt_->Extend(2446065);
+  ASSERT_TRUE(extended != nullptr);
+  ExpectSameData(*extended, *lt_);
+
+  // Errors.
+  EXPECT_EQ(lt_->Extend(2446034), nullptr);  // 1984-11-29, earlier
+  EXPECT_EQ(lt_->Extend(2446232), nullptr);  // 1985-06-15, not a month end
+  EXPECT_EQ(lt_->Extend(5373513), nullptr);  // 10000-01-30, too late
+  EXPECT_EQ(lt_->Extend(2446246, 2446035, 1), nullptr);  // Before expiration
+  EXPECT_EQ(lt_->Extend(2446246, 2446232, 1), nullptr);  // Not a month end
+  EXPECT_EQ(lt_->Extend(2446246, 2446247, 1), nullptr);  // After end_jdn
+  EXPECT_EQ(lt_->Extend(2446246, 2446066, 2), nullptr);  // Not ±1
+}
+
+TEST_F(LeapTableTest, Flat) {
+  std::string flat;
+  lt_->ToFlat(&flat);
+  auto lt = NewLeapTableFromFlat(flat);
+  ASSERT_TRUE(lt != nullptr);
+  EXPECT_EQ(*lt, *lt_);
+  EXPECT_EQ(lt->DebugString(), lt_->DebugString());
+  absl::Time utc = Noon(1973, 6, 30) + absl::Hours(6);
+  EXPECT_EQ(lt->Unsmear(utc), lt_->Unsmear(utc));
+  EXPECT_EQ(lt->Smear(*lt_->Unsmear(utc)), utc);
+
+  // Writing the table again gives identical data.
+  std::string flat2;
+  lt->ToFlat(&flat2);
+  EXPECT_EQ(flat2, flat);
+
+  // Any corruption is detected.
+  for (size_t i = 0; i < flat.size(); i += 7) {
+    std::string corrupt = flat;
+    corrupt[i] ^= 0x10;
+    EXPECT_EQ(NewLeapTableFromFlat(corrupt), nullptr) << i;
+  }
+  EXPECT_EQ(NewLeapTableFromFlat(absl::string_view(flat).substr(0, 40)),
+            nullptr);
+  EXPECT_EQ(NewLeapTableFromFlat(""), nullptr);
+
+  // The data must be aligned.
+  std::string misaligned = " " + flat;
+  EXPECT_EQ(NewLeapTableFromFlat(absl::string_view(misaligned).substr(1)),
+            nullptr);
+}
+
+TEST_F(LeapTableTest, FlatFile) {
+  std::string flat;
+  lt_->ToFlat(&flat);
+  std::string path = ::testing::TempDir() + "/leap_table.flat";
+  {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream << flat;
+    ASSERT_TRUE(stream.good());
+  }
+  auto lt = NewLeapTableFromFlatFile(path);
+  ASSERT_TRUE(lt != nullptr);
+  EXPECT_EQ(*lt, *lt_);
+
+  // Copies keep the mapping alive.
+  LeapTable copy = *lt;
+  lt.reset();
+  EXPECT_EQ(copy, *lt_);
+
+  EXPECT_EQ(NewLeapTableFromFlatFile(path + ".missing"), nullptr);
+  std::remove(path.c_str());
+}
+
 TEST_F(LeapTableTest, EqualityOperators) {
   EXPECT_TRUE(*lt_ == *lt_);
   EXPECT_FALSE(*lt_ != *lt_);
@@ -318,6 +1390,57 @@ TEST(InvalidLeapTableTest, ExpirationTooLate) {
   ASSERT_TRUE(NewLeapTableFromProto(proto) == nullptr);
 }
 
+TEST_F(LeapTableTest, SegmentBoundaries) {
+  // Every entry of the table is exactly convertible, and conversions are
+  // strictly increasing across it.
+  std::vector<std::pair<absl::Time, TaiTime>> boundaries = {
+      {ModernUtcEpoch(), TaiModernUtcEpoch()},
+      {Noon(1972, 6, 30), TaiEpoch() + 5294 * Hours(24) + Hours(12) +
+                              Seconds(10)},
+      {Noon(1973, 7, 1), TaiEpoch() + 5660 * Hours(24) + Hours(12) +
+                             Seconds(12)},
+      {Noon(1973, 12, 31), TaiEpoch() + 5843 * Hours(24) + Hours(12) +
+                               Seconds(12)},
+      {Noon(1974, 1, 1), TaiEpoch() + 5844 * Hours(24) + Hours(12) +
+                             Seconds(11)},
+      {lt_->expiration(), expiration_tai()},
+  };
+  for (const auto& b : boundaries) {
+    SCOPED_TRACE(b.first);
+    EXPECT_EQ(lt_->Unsmear(b.first), b.second);
+    EXPECT_EQ(lt_->Smear(b.second), b.first);
+    if (b.first > ModernUtcEpoch()) {
+      EXPECT_LT(*lt_->Unsmear(b.first - absl::Microseconds(1)), b.second);
+      EXPECT_LT(*lt_->Smear(b.second - Microseconds(1)), b.first);
+    }
+    if (b.first < lt_->expiration()) {
+      EXPECT_GT(*lt_->Unsmear(b.first + absl::Microseconds(1)), b.second);
+      EXPECT_GT(*lt_->Smear(b.second + Microseconds(1)), b.first);
+    }
+  }
+}
+
+TEST(NegativeLeapSecondTest, TwoSegmentsEndInOneTaiDay) {
+  // TAI days start at 12:00:10 TAI, so the day starting at the start of this
+  // negative smear also contains its end, at 1972-02-01 12:00:09 TAI.
+  LeapTableProto pb;
+  pb.add_negative_leaps(2441348);  // 1972-01-31
+  pb.set_end_jdn(2441376);         // 1972-02-28
+  auto lt = NewLeapTableFromProto(pb);
+  ASSERT_TRUE(lt != nullptr);
+
+  TaiTime smear_end = TaiEpoch() + 5144 * Hours(24) + Hours(12) + Seconds(9);
+  absl::Time utc_smear_end = Noon(1972, 2, 1);
+  EXPECT_EQ(lt->Smear(smear_end), utc_smear_end);
+  EXPECT_EQ(lt->Unsmear(utc_smear_end), smear_end);
+  EXPECT_EQ(lt->Smear(smear_end + Milliseconds(500)),
+            utc_smear_end + absl::Milliseconds(500));
+  EXPECT_EQ(lt->Unsmear(utc_smear_end + absl::Milliseconds(500)),
+            smear_end + Milliseconds(500));
+  EXPECT_EQ(lt->Smear(smear_end - Hours(12) + Milliseconds(500)),
+            utc_smear_end - absl::Hours(12));
+}
+
 TEST(AdjacentLeapSecondsTest, AdjacentLeapSeconds) {
   LeapTableProto pb;
   pb.add_positive_leaps(2441348);  // 1972-01-31
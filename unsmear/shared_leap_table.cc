@@ -0,0 +1,148 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/shared_leap_table.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+
+namespace unsmear {
+
+namespace {
+
+using internal::SharedLeapTableRegion;
+
+constexpr size_t kRegionSize = sizeof(SharedLeapTableRegion);
+
+}  // namespace
+
+std::unique_ptr<SharedLeapTablePublisher> SharedLeapTablePublisher::Create(
+    const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed opening shared leap table " << name << ": "
+               << std::strerror(errno);
+    return nullptr;
+  }
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    LOG(ERROR) << "Failed locking shared leap table " << name << ": "
+               << std::strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (static_cast<size_t>(st.st_size) != kRegionSize &&
+       ftruncate(fd, kRegionSize) != 0)) {
+    LOG(ERROR) << "Failed resizing shared leap table " << name << ": "
+               << std::strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  void* addr =
+      mmap(nullptr, kRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Failed mapping shared leap table " << name << ": "
+               << std::strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+
+  auto* region = static_cast<SharedLeapTableRegion*>(addr);
+  if (region->magic.load(std::memory_order_acquire) !=
+      SharedLeapTableRegion::kMagic) {
+    // A new object, or one with a different layout, which no reader accepts.
+    std::memset(addr, 0, kRegionSize);
+    region->magic.store(SharedLeapTableRegion::kMagic,
+                        std::memory_order_release);
+  } else if (region->seq.load(std::memory_order_relaxed) % 2 != 0) {
+    // A previous publisher stopped while writing the next table, which no
+    // reader has used yet; write it again.
+    region->seq.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return absl::WrapUnique(new SharedLeapTablePublisher(fd, region));
+}
+
+SharedLeapTablePublisher::~SharedLeapTablePublisher() {
+  munmap(region_, kRegionSize);
+  close(fd_);
+}
+
+bool SharedLeapTablePublisher::Publish(const LeapTable& lt) {
+  if (published_ != nullptr && *published_ == lt) {
+    return true;
+  }
+  InlineLeapTable table;
+  if (!table.Assign(lt)) {
+    return false;
+  }
+
+  const uint64_t seq = region_->seq.load(std::memory_order_relaxed);
+  region_->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  region_->tables[(seq / 2 + 1) % 2] = table;
+  region_->seq.store(seq + 2, std::memory_order_release);
+
+  published_ = absl::make_unique<LeapTable>(lt);
+  return true;
+}
+
+std::unique_ptr<SharedLeapTableReader> SharedLeapTableReader::Open(
+    const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed opening shared leap table " << name << ": "
+               << std::strerror(errno);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != kRegionSize) {
+    LOG(ERROR) << "Failed opening shared leap table " << name
+               << ": wrong size";
+    close(fd);
+    return nullptr;
+  }
+  void* addr = mmap(nullptr, kRegionSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Failed mapping shared leap table " << name << ": "
+               << std::strerror(errno);
+    return nullptr;
+  }
+
+  const auto* region = static_cast<const SharedLeapTableRegion*>(addr);
+  if (region->magic.load(std::memory_order_acquire) !=
+      SharedLeapTableRegion::kMagic) {
+    LOG(ERROR) << "Failed opening shared leap table " << name
+               << ": not initialized by a publisher";
+    munmap(addr, kRegionSize);
+    return nullptr;
+  }
+  return absl::WrapUnique(new SharedLeapTableReader(region));
+}
+
+SharedLeapTableReader::~SharedLeapTableReader() {
+  munmap(const_cast<SharedLeapTableRegion*>(region_), kRegionSize);
+}
+
+}  // namespace unsmear
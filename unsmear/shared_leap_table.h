@@ -0,0 +1,169 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_SHARED_LEAP_TABLE_H
+#define UNSMEAR_SHARED_LEAP_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "unsmear/unsmear.h"
+
+namespace unsmear {
+
+namespace internal {
+
+// The contents of a shared leap table's POSIX shared memory object.
+//
+// The tables alternate: generation g is in tables[g % 2], and seq is 2g while
+// it is current, or 2g + 1 while generation g + 1 is being written into the
+// other table.  The table of generation g is therefore unchanged until seq
+// reaches 2g + 3, and readers that see a smaller seq after converting with it
+// know that their result is consistent.  Generation 0 is the empty table.
+struct SharedLeapTableRegion {
+  // Identifies the layout; it must change whenever the layout does.
+  static constexpr uint64_t kMagic = 0x756e736d65617201;
+
+  // kMagic once a publisher has initialized the region.
+  std::atomic<uint64_t> magic;
+  std::atomic<uint64_t> seq;
+  InlineLeapTable tables[2];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory requires address-free atomics");
+
+}  // namespace internal
+
+// Publishes a leap table into a POSIX shared memory object, so that every
+// process on a host can convert with it through a SharedLeapTableReader
+// instead of loading and refreshing a copy of its own.
+//
+// There may be one publisher of a name at a time; it holds an exclusive lock
+// on the object.  The object outlives the publisher, so that readers keep
+// working while it restarts; a restarted publisher continues from the table
+// last published.
+//
+// Example, in a per-host daemon:
+//   auto publisher = SharedLeapTablePublisher::Create("/unsmear_leap_table");
+//   if (publisher == nullptr || !publisher->Publish(*holder.Get())) { ... }
+class SharedLeapTablePublisher {
+ public:
+  // Creates the shared memory object name, or opens it if it exists, and maps
+  // it for publishing.  Logs an error and returns null if it cannot be opened
+  // or mapped, or if another publisher holds it.
+  static std::unique_ptr<SharedLeapTablePublisher> Create(
+      const std::string& name);
+
+  ~SharedLeapTablePublisher();
+
+  SharedLeapTablePublisher(const SharedLeapTablePublisher&) = delete;
+  SharedLeapTablePublisher& operator=(const SharedLeapTablePublisher&) = delete;
+
+  // Makes lt the table of every reader, atomically: each conversion sees
+  // either the previous table or lt.  Publishing the table last published by
+  // this publisher changes nothing, so that it costs nothing to republish on
+  // every refresh.  Logs an error and returns false, leaving the previous
+  // table in place, if lt has more entries than an InlineLeapTable holds.
+  bool Publish(const LeapTable& lt);
+
+ private:
+  SharedLeapTablePublisher(int fd, internal::SharedLeapTableRegion* region)
+      : fd_(fd), region_(region) {}
+
+  int fd_;
+  internal::SharedLeapTableRegion* region_;
+  std::unique_ptr<LeapTable> published_;
+};
+
+// Converts times with the leap table most recently published into a POSIX
+// shared memory object by a SharedLeapTablePublisher.
+//
+// Conversions read the table in place, as InlineLeapTable does, bracketed by
+// two loads of a sequence number, so they cost about the same as conversions
+// with an in-process table.  Readers never block or write shared memory.  A
+// conversion is retried only if two tables were published while it ran.
+//
+// A reader is thread-safe, and is meant to be shared by every thread of a
+// process.
+//
+// Example:
+//   static const SharedLeapTableReader* reader =
+//       SharedLeapTableReader::Open("/unsmear_leap_table").release();
+//   absl::optional<TaiTime> tai = reader->Unsmear(utc);
+class SharedLeapTableReader {
+ public:
+  // Maps the shared memory object name for reading.  Logs an error and returns
+  // null if it does not exist or has not been initialized by a publisher.
+  static std::unique_ptr<SharedLeapTableReader> Open(const std::string& name);
+
+  ~SharedLeapTableReader();
+
+  SharedLeapTableReader(const SharedLeapTableReader&) = delete;
+  SharedLeapTableReader& operator=(const SharedLeapTableReader&) = delete;
+
+  // As for LeapTable, with the current table.  Until a table is published,
+  // nothing can be converted.
+  template <internal::TtBasedTimescale timescale>
+  absl::optional<absl::Time> Smear(internal::TtBasedTime<timescale> t) const {
+    return Read([t](const InlineLeapTable& lt) { return lt.Smear(t); });
+  }
+  absl::optional<TaiTime> Unsmear(absl::Time utc) const {
+    return Read([utc](const InlineLeapTable& lt) { return lt.Unsmear(utc); });
+  }
+  absl::optional<GpsTime> UnsmearToGps(absl::Time utc) const {
+    return Read(
+        [utc](const InlineLeapTable& lt) { return lt.UnsmearToGps(utc); });
+  }
+
+  // Returns the expiration of the current table, or the infinite past if none
+  // has been published.
+  absl::Time expiration() const {
+    return Read([](const InlineLeapTable& lt) { return lt.expiration(); });
+  }
+
+  // Returns the number of tables published so far, which increases with every
+  // change of table.
+  uint64_t generation() const {
+    return region_->seq.load(std::memory_order_acquire) / 2;
+  }
+
+ private:
+  explicit SharedLeapTableReader(const internal::SharedLeapTableRegion* region)
+      : region_(region) {}
+
+  // Returns f applied to the current table, retrying until the table was not
+  // overwritten while f ran.
+  template <typename F>
+  auto Read(F f) const -> decltype(f(std::declval<const InlineLeapTable&>())) {
+    while (true) {
+      const uint64_t seq = region_->seq.load(std::memory_order_acquire);
+      auto result = f(region_->tables[(seq / 2) % 2]);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (region_->seq.load(std::memory_order_relaxed) < seq / 2 * 2 + 3) {
+        return result;
+      }
+    }
+  }
+
+  const internal::SharedLeapTableRegion* region_;
+};
+
+}  // namespace unsmear
+
+#endif  // UNSMEAR_SHARED_LEAP_TABLE_H
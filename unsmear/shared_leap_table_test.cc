@@ -0,0 +1,188 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/shared_leap_table.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/civil_time.h"
+#include "gtest/gtest.h"
+
+namespace unsmear {
+namespace {
+
+// Returns an absl::Time at UTC noon.
+absl::Time Noon(int64_t y, int m, int d) {
+  return absl::FromDateTime(y, m, d, 12, 0, 0, absl::UTCTimeZone());
+}
+
+class SharedLeapTableTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    name_ = absl::StrCat(
+        "/unsmear_test_", getpid(), "_",
+        ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    builder_.AddPositiveLeap(2441499);  // 1972-06-30 12:00:00 UTC
+    builder_.AddPositiveLeap(2441864);  // 1973-06-30 12:00:00 UTC
+    builder_.SetEndJdn(2442412);        // 1974-12-30 12:00:00 UTC
+    old_ = builder_.Build();
+    ASSERT_TRUE(old_ != nullptr);
+
+    // The same table, extended past a new leap second.
+    builder_.AddPositiveLeap(2442413);  // 1974-12-31 12:00:00 UTC
+    builder_.SetEndJdn(2442593);        // 1975-06-29 12:00:00 UTC
+    new_ = builder_.Build();
+    ASSERT_TRUE(new_ != nullptr);
+  }
+
+  void TearDown() override { shm_unlink(name_.c_str()); }
+
+  std::string name_;
+  LeapTableBuilder builder_;
+  std::unique_ptr<LeapTable> old_;
+  std::unique_ptr<LeapTable> new_;
+};
+
+TEST_F(SharedLeapTableTest, PublishAndRead) {
+  auto publisher = SharedLeapTablePublisher::Create(name_);
+  ASSERT_TRUE(publisher != nullptr);
+  auto reader = SharedLeapTableReader::Open(name_);
+  ASSERT_TRUE(reader != nullptr);
+
+  // Nothing can be converted until a table is published.
+  EXPECT_EQ(reader->generation(), 0);
+  EXPECT_EQ(reader->expiration(), absl::InfinitePast());
+  EXPECT_EQ(reader->Unsmear(Noon(1973, 1, 1)), absl::nullopt);
+
+  ASSERT_TRUE(publisher->Publish(*old_));
+  EXPECT_EQ(reader->generation(), 1);
+  EXPECT_EQ(reader->expiration(), old_->expiration());
+  for (absl::Time t = ModernUtcEpoch() - absl::Hours(1);
+       t < old_->expiration() + absl::Hours(48);
+       t += absl::Minutes(37) + absl::Nanoseconds(1)) {
+    SCOPED_TRACE(t);
+    EXPECT_EQ(reader->Unsmear(t), old_->Unsmear(t));
+    EXPECT_EQ(reader->UnsmearToGps(t), old_->UnsmearToGps(t));
+    if (auto tai = old_->Unsmear(t)) {
+      EXPECT_EQ(reader->Smear(*tai), old_->Smear(*tai));
+      EXPECT_EQ(reader->Smear(*tai + Nanoseconds(1)),
+                old_->Smear(*tai + Nanoseconds(1)));
+    }
+  }
+
+  // Republishing the same table changes nothing.
+  ASSERT_TRUE(publisher->Publish(*old_));
+  EXPECT_EQ(reader->generation(), 1);
+
+  // Readers see a newer table as soon as it is published.
+  const absl::Time utc = Noon(1975, 6, 1);
+  EXPECT_EQ(reader->Unsmear(utc), absl::nullopt);
+  ASSERT_TRUE(publisher->Publish(*new_));
+  EXPECT_EQ(reader->generation(), 2);
+  EXPECT_EQ(reader->expiration(), new_->expiration());
+  EXPECT_EQ(reader->Unsmear(utc),
+            TaiEpoch() + 6360 * Hours(24) + Hours(12) + Seconds(13));
+}
+
+TEST_F(SharedLeapTableTest, PublisherRestarts) {
+  auto publisher = SharedLeapTablePublisher::Create(name_);
+  ASSERT_TRUE(publisher != nullptr);
+  ASSERT_TRUE(publisher->Publish(*old_));
+  auto reader = SharedLeapTableReader::Open(name_);
+  ASSERT_TRUE(reader != nullptr);
+
+  // There is one publisher at a time.
+  EXPECT_EQ(SharedLeapTablePublisher::Create(name_), nullptr);
+
+  // Readers keep the published table while there is no publisher, and new
+  // readers can still open it.
+  publisher.reset();
+  EXPECT_EQ(reader->expiration(), old_->expiration());
+  auto other = SharedLeapTableReader::Open(name_);
+  ASSERT_TRUE(other != nullptr);
+  EXPECT_EQ(other->expiration(), old_->expiration());
+
+  // A new publisher continues from the published table.
+  publisher = SharedLeapTablePublisher::Create(name_);
+  ASSERT_TRUE(publisher != nullptr);
+  EXPECT_EQ(reader->expiration(), old_->expiration());
+  ASSERT_TRUE(publisher->Publish(*new_));
+  EXPECT_EQ(reader->generation(), 2);
+  EXPECT_EQ(other->expiration(), new_->expiration());
+}
+
+TEST_F(SharedLeapTableTest, Errors) {
+  EXPECT_EQ(SharedLeapTableReader::Open(name_), nullptr);
+  EXPECT_EQ(SharedLeapTablePublisher::Create("no/slashes"), nullptr);
+
+  // Tables too large to share are not published.
+  auto publisher = SharedLeapTablePublisher::Create(name_);
+  ASSERT_TRUE(publisher != nullptr);
+  ASSERT_TRUE(publisher->Publish(*old_));
+  LeapTableBuilder builder;
+  // Leap seconds at the end of every June and December from 1972 to 2008.
+  const absl::CivilDay jdn0(-4713, 11, 24);
+  for (int y = 1972; y <= 2008; ++y) {
+    builder.AddPositiveLeap(absl::CivilDay(y, 6, 30) - jdn0);
+    builder.AddPositiveLeap(absl::CivilDay(y, 12, 31) - jdn0);
+  }
+  builder.SetEndJdn(absl::CivilDay(2009, 6, 29) - jdn0);
+  auto large = builder.Build();
+  ASSERT_TRUE(large != nullptr);
+  EXPECT_FALSE(publisher->Publish(*large));
+  auto reader = SharedLeapTableReader::Open(name_);
+  ASSERT_TRUE(reader != nullptr);
+  EXPECT_EQ(reader->generation(), 1);
+  EXPECT_EQ(reader->expiration(), old_->expiration());
+}
+
+TEST_F(SharedLeapTableTest, UpdatesAreAtomic) {
+  auto publisher = SharedLeapTablePublisher::Create(name_);
+  ASSERT_TRUE(publisher != nullptr);
+  ASSERT_TRUE(publisher->Publish(*old_));
+  auto reader = SharedLeapTableReader::Open(name_);
+  ASSERT_TRUE(reader != nullptr);
+
+  // Each conversion during the smear of the new leap second sees one table or
+  // the other, never a mix.
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      uint64_t n = 0;
+      while (!done.load(std::memory_order_relaxed) || n < 1000) {
+        const absl::Time t = Noon(1974, 12, 31) + absl::Seconds(n++ % 86400);
+        const auto tai = reader->Unsmear(t);
+        ASSERT_TRUE(tai == old_->Unsmear(t) || tai == new_->Unsmear(t));
+      }
+    });
+  }
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(publisher->Publish(i % 2 == 0 ? *new_ : *old_));
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(reader->generation(), 1001);
+}
+
+}  // namespace
+}  // namespace unsmear
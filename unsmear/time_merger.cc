@@ -0,0 +1,107 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/time_merger.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace unsmear {
+
+TimeMerger::TimeMerger(const LeapTable& lt, Order order)
+    : lt_(lt), order_(order) {}
+
+size_t TimeMerger::AddInput(absl::Span<const absl::Time> utc) {
+  Input input(Timescale::kUtc, utc.size(), lt_);
+  input.utc = utc;
+  return Add(std::move(input));
+}
+
+size_t TimeMerger::AddInput(absl::Span<const TaiTime> tai) {
+  Input input(Timescale::kTai, tai.size(), lt_);
+  input.tai = tai;
+  return Add(std::move(input));
+}
+
+size_t TimeMerger::AddInput(absl::Span<const GpsTime> gps) {
+  Input input(Timescale::kGps, gps.size(), lt_);
+  input.gps = gps;
+  return Add(std::move(input));
+}
+
+size_t TimeMerger::Add(Input input) {
+  const size_t n = inputs_.size();
+  input.head.input = n;
+  input.head.index = 0;
+  inputs_.push_back(std::move(input));
+  if (inputs_.back().size > 0) {
+    Load(&inputs_.back());
+    heap_.push_back(n);
+    std::push_heap(heap_.begin(), heap_.end(),
+                   [this](size_t a, size_t b) { return After(a, b); });
+  }
+  return n;
+}
+
+void TimeMerger::Load(Input* input) {
+  Element& e = input->head;
+  const size_t i = e.index;
+  if (input->timescale == Timescale::kUtc) {
+    e.utc = input->utc[i];
+    const absl::optional<TaiTime> tai = input->cursor.Unsmear(e.utc);
+    e.precise = tai.has_value();
+    e.tai = e.precise ? *tai : lt_.FutureProofUnsmear(e.utc).first;
+    return;
+  }
+  absl::optional<absl::Time> utc;
+  if (input->timescale == Timescale::kTai) {
+    e.tai = input->tai[i];
+    utc = input->cursor.Smear(e.tai);
+  } else {
+    e.tai = ToTaiTime(input->gps[i]);
+    utc = input->cursor.Smear(input->gps[i]);
+  }
+  e.precise = utc.has_value();
+  e.utc = e.precise ? *utc : lt_.FutureProofSmear(e.tai).first;
+}
+
+bool TimeMerger::After(size_t a, size_t b) const {
+  const Element& x = inputs_[a].head;
+  const Element& y = inputs_[b].head;
+  if (order_ == Order::kTai) {
+    if (x.tai != y.tai) return y.tai < x.tai;
+  } else {
+    if (x.utc != y.utc) return y.utc < x.utc;
+  }
+  return a > b;
+}
+
+bool TimeMerger::Next(Element* e) {
+  if (heap_.empty()) {
+    return false;
+  }
+  const auto after = [this](size_t a, size_t b) { return After(a, b); };
+  std::pop_heap(heap_.begin(), heap_.end(), after);
+  Input& input = inputs_[heap_.back()];
+  *e = input.head;
+  if (++input.head.index < input.size) {
+    Load(&input);
+    std::push_heap(heap_.begin(), heap_.end(), after);
+  } else {
+    heap_.pop_back();
+  }
+  return true;
+}
+
+}  // namespace unsmear
@@ -0,0 +1,123 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_TIME_MERGER_H
+#define UNSMEAR_TIME_MERGER_H
+
+#include <cstddef>
+#include <vector>
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "unsmear/unsmear.h"
+
+namespace unsmear {
+
+// Merges streams of times from sources in different timescales, such as
+// smeared servers, GPS receivers and PTP devices, into one stream in TAI order
+// or in smeared order.  Each input must be sorted in its own timescale.  The
+// merge is lazy: Next() returns one element at a time, converting it with a
+// LeapTable::Cursor per input and choosing among the inputs with a heap, so
+// nothing is copied or sorted and each element costs O(log inputs).
+//
+// Every element is output in both TAI and smeared time.  Elements that the
+// leap table cannot convert precisely, such as times past its expiration, are
+// ordered by their earliest possible conversion, as from FutureProofUnsmear()
+// and FutureProofSmear(), and output with precise set to false.  Smeared times
+// before 1972 have a TAI time of the infinite past, and TAI and GPST times
+// before 1972 a smeared time of the infinite past.  Ties are output in the
+// order the inputs were added, and then in input order.
+//
+// The inputs and the leap table must outlive the TimeMerger.  A TimeMerger is
+// not thread-safe.
+//
+// Example:
+//   TimeMerger merger(lt);
+//   merger.AddInput(server_times);    // absl::Time
+//   merger.AddInput(receiver_times);  // GpsTime
+//   merger.AddInput(ptp_times);       // TaiTime
+//   TimeMerger::Element e;
+//   while (merger.Next(&e)) {
+//     Correlate(e.input, e.index, e.tai);
+//   }
+class TimeMerger {
+ public:
+  enum class Order {
+    kTai,
+    kSmeared,
+  };
+
+  struct Element {
+    TaiTime tai;
+    absl::Time utc;
+    // Whether tai and utc are precise conversions of each other.
+    bool precise;
+    // The input, numbered in the order added, and the index within it.
+    size_t input;
+    size_t index;
+  };
+
+  explicit TimeMerger(const LeapTable& lt, Order order = Order::kTai);
+
+  TimeMerger(const TimeMerger&) = delete;
+  TimeMerger& operator=(const TimeMerger&) = delete;
+
+  // Adds a sorted input, returning its number.  Inputs added after Next() has
+  // been called are merged with the elements not yet output.
+  size_t AddInput(absl::Span<const absl::Time> utc);
+  size_t AddInput(absl::Span<const TaiTime> tai);
+  size_t AddInput(absl::Span<const GpsTime> gps);
+
+  // Sets e to the next element in order and returns true, or returns false if
+  // every input has been output.
+  bool Next(Element* e);
+
+ private:
+  enum class Timescale {
+    kUtc,
+    kTai,
+    kGps,
+  };
+
+  struct Input {
+    Input(Timescale timescale, size_t size, const LeapTable& lt)
+        : timescale(timescale), size(size), cursor(lt) {}
+
+    Timescale timescale;
+    // One of these is the input, per timescale.
+    absl::Span<const absl::Time> utc;
+    absl::Span<const TaiTime> tai;
+    absl::Span<const GpsTime> gps;
+    size_t size;
+    // The next element, converted, if head.index < size.
+    Element head;
+    LeapTable::Cursor cursor;
+  };
+
+  // Adds the input and pushes its first element, if any, onto the heap.
+  size_t Add(Input input);
+  // Converts the element at head.index of the input into head.
+  void Load(Input* input);
+  // Returns whether the head of input a comes after that of input b.
+  bool After(size_t a, size_t b) const;
+
+  const LeapTable& lt_;
+  Order order_;
+  std::vector<Input> inputs_;
+  // A min-heap of the numbers of inputs with elements left, by their heads.
+  std::vector<size_t> heap_;
+};
+
+}  // namespace unsmear
+
+#endif  // UNSMEAR_TIME_MERGER_H
@@ -0,0 +1,172 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/time_merger.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "unsmear/unsmear_proto.h"
+
+namespace unsmear {
+namespace {
+
+class TimeMergerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    LeapTableProto proto;
+    proto.add_positive_leaps(2441499);  // 1972-06-30 12:00:00 UTC
+    proto.add_positive_leaps(2441864);  // 1973-06-30 12:00:00 UTC
+    proto.add_negative_leaps(2442048);  // 1973-12-31 12:00:00 UTC, negative
+    proto.add_positive_leaps(2444239);  // 1979-12-31 12:00:00 UTC
+    proto.set_end_jdn(2446065);         // 1984-12-30 12:00:00 UTC
+    lt_ = NewLeapTableFromProto(proto);
+    ASSERT_TRUE(lt_ != nullptr);
+
+    // Times in each timescale at different intervals, so that they interleave,
+    // through the smears and past the expiration.
+    for (absl::Time t = ModernUtcEpoch() + absl::Hours(3);
+         t < lt_->expiration() + absl::Hours(72); t += absl::Hours(7)) {
+      utc_.push_back(t);
+    }
+    for (TaiTime t = TaiModernUtcEpoch(); t < ToTaiTime(GpsEpoch());
+         t += Hours(5) + Nanoseconds(1)) {
+      tai_.push_back(t);
+    }
+    for (GpsTime t = GpsEpoch(); t < GpsEpoch() + 6 * 365 * Hours(24);
+         t += Hours(11)) {
+      gps_.push_back(t);
+    }
+  }
+
+  std::unique_ptr<LeapTable> lt_;
+  std::vector<absl::Time> utc_;
+  std::vector<TaiTime> tai_;
+  std::vector<GpsTime> gps_;
+};
+
+TEST_F(TimeMergerTest, TaiOrder) {
+  TimeMerger merger(*lt_);
+  EXPECT_EQ(merger.AddInput(utc_), 0u);
+  EXPECT_EQ(merger.AddInput(tai_), 1u);
+  EXPECT_EQ(merger.AddInput(gps_), 2u);
+
+  std::vector<size_t> next(3, 0);
+  TaiTime last = TaiInfinitePast();
+  TimeMerger::Element e;
+  while (merger.Next(&e)) {
+    ASSERT_LT(e.input, 3u);
+    // Each input is output in its own order.
+    EXPECT_EQ(e.index, next[e.input]++);
+    EXPECT_FALSE(e.tai < last) << e.tai;
+    last = e.tai;
+    SCOPED_TRACE(e.tai);
+    if (e.input == 0) {
+      EXPECT_EQ(e.utc, utc_[e.index]);
+      const auto tai = lt_->Unsmear(e.utc);
+      EXPECT_EQ(e.precise, tai.has_value());
+      EXPECT_EQ(e.tai, tai.value_or(lt_->FutureProofUnsmear(e.utc).first));
+    } else {
+      EXPECT_EQ(e.tai, e.input == 1 ? tai_[e.index]
+                                    : ToTaiTime(gps_[e.index]));
+      const auto utc = lt_->Smear(e.tai);
+      EXPECT_EQ(e.precise, utc.has_value());
+      EXPECT_EQ(e.utc, utc.value_or(lt_->FutureProofSmear(e.tai).first));
+    }
+  }
+  EXPECT_EQ(next,
+            std::vector<size_t>({utc_.size(), tai_.size(), gps_.size()}));
+  EXPECT_FALSE(merger.Next(&e));
+}
+
+TEST_F(TimeMergerTest, SmearedOrder) {
+  TimeMerger merger(*lt_, TimeMerger::Order::kSmeared);
+  merger.AddInput(gps_);
+  merger.AddInput(utc_);
+  merger.AddInput(tai_);
+
+  size_t count = 0;
+  absl::Time last = absl::InfinitePast();
+  TimeMerger::Element e;
+  while (merger.Next(&e)) {
+    EXPECT_FALSE(e.utc < last) << e.utc;
+    last = e.utc;
+    ++count;
+  }
+  EXPECT_EQ(count, utc_.size() + tai_.size() + gps_.size());
+}
+
+TEST_F(TimeMergerTest, Ties) {
+  // Equal times are output in the order the inputs were added.
+  const std::vector<TaiTime> tai = {TaiModernUtcEpoch(), TaiModernUtcEpoch()};
+  const std::vector<absl::Time> utc = {ModernUtcEpoch()};
+  TimeMerger merger(*lt_);
+  merger.AddInput(tai);
+  merger.AddInput(utc);
+  std::vector<std::pair<size_t, size_t>> order;
+  TimeMerger::Element e;
+  while (merger.Next(&e)) {
+    EXPECT_EQ(e.tai, TaiModernUtcEpoch());
+    EXPECT_EQ(e.utc, ModernUtcEpoch());
+    EXPECT_TRUE(e.precise);
+    order.emplace_back(e.input, e.index);
+  }
+  EXPECT_EQ(order, (std::vector<std::pair<size_t, size_t>>{
+                       {0, 0}, {0, 1}, {1, 0}}));
+}
+
+TEST_F(TimeMergerTest, AddInputs) {
+  TimeMerger merger(*lt_);
+  TimeMerger::Element e;
+  EXPECT_FALSE(merger.Next(&e));
+  EXPECT_EQ(merger.AddInput(absl::Span<const TaiTime>()), 0u);
+  EXPECT_FALSE(merger.Next(&e));
+
+  // Inputs added later merge with what is left.
+  const std::vector<absl::Time> utc = {ModernUtcEpoch(),
+                                       ModernUtcEpoch() + absl::Hours(2)};
+  const std::vector<TaiTime> tai = {TaiModernUtcEpoch() + Hours(1)};
+  merger.AddInput(utc);
+  ASSERT_TRUE(merger.Next(&e));
+  EXPECT_EQ(std::make_tuple(e.input, e.index), std::make_tuple(1u, 0u));
+  merger.AddInput(tai);
+  ASSERT_TRUE(merger.Next(&e));
+  EXPECT_EQ(std::make_tuple(e.input, e.index), std::make_tuple(2u, 0u));
+  ASSERT_TRUE(merger.Next(&e));
+  EXPECT_EQ(std::make_tuple(e.input, e.index), std::make_tuple(1u, 1u));
+  EXPECT_FALSE(merger.Next(&e));
+}
+
+TEST_F(TimeMergerTest, Unconvertible) {
+  // Times before 1972 cannot be converted, and come first.
+  const std::vector<absl::Time> utc = {ModernUtcEpoch() - absl::Seconds(1)};
+  const std::vector<TaiTime> tai = {TaiEpoch()};
+  TimeMerger merger(*lt_);
+  merger.AddInput(utc);
+  merger.AddInput(tai);
+  TimeMerger::Element e;
+  ASSERT_TRUE(merger.Next(&e));
+  EXPECT_EQ(e.input, 0u);
+  EXPECT_EQ(e.tai, TaiInfinitePast());
+  EXPECT_FALSE(e.precise);
+  ASSERT_TRUE(merger.Next(&e));
+  EXPECT_EQ(e.input, 1u);
+  EXPECT_EQ(e.utc, absl::InfinitePast());
+  EXPECT_FALSE(e.precise);
+}
+
+}  // namespace
+}  // namespace unsmear
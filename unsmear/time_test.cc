@@ -12,6 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "unsmear/unsmear.h"
 
@@ -72,5 +77,500 @@ TEST(TimeTest, Conversions) {
   EXPECT_EQ(gps, ToGpsTime(ToTaiTime(gps)));
 }
 
+TEST(TimeTest, NanosConversions) {
+  auto tai = TaiEpoch() + 12345 * Hours(24) + Seconds(19) + Nanoseconds(7);
+  const int64_t tai_ns = ToInt64Nanoseconds(tai - TaiEpoch());
+  const int64_t gps_ns = ToInt64Nanoseconds(ToGpsTime(tai) - GpsEpoch());
+  int64_t ns = 0;
+  ASSERT_TRUE(TaiNanosToGpsNanos(tai_ns, &ns));
+  EXPECT_EQ(ns, gps_ns);
+  ASSERT_TRUE(GpsNanosToTaiNanos(gps_ns, &ns));
+  EXPECT_EQ(ns, tai_ns);
+
+  // Times before the GPST epoch are proleptic, as with GpsTime.
+  ASSERT_TRUE(TaiNanosToGpsNanos(0, &ns));
+  EXPECT_EQ(ns, ToInt64Nanoseconds(ToGpsTime(TaiEpoch()) - GpsEpoch()));
+
+  // Results that overflow are not converted.
+  ns = 42;
+  EXPECT_FALSE(TaiNanosToGpsNanos(std::numeric_limits<int64_t>::min(), &ns));
+  EXPECT_FALSE(GpsNanosToTaiNanos(std::numeric_limits<int64_t>::max(), &ns));
+  EXPECT_EQ(ns, 42);
+}
+
+TEST(TimeTest, GpsWeekTime) {
+  // The second rollover of 10-bit week numbers, at 2019-04-07 00:00:00 GPST.
+  GpsWeekTime w;
+  w.week = 2048;
+  w.tow_nanos = 3 * 86400 * int64_t{1000000000} + 7;
+  const GpsTime gps = GpsEpoch() + 14339 * Hours(24) + Nanoseconds(7);
+  EXPECT_EQ(FromGpsWeekTime(w), gps);
+  GpsWeekTime back = ToGpsWeekTime(gps + Nanoseconds(0.25));
+  EXPECT_EQ(back.week, w.week);
+  EXPECT_EQ(back.tow_nanos, w.tow_nanos);
+
+  int64_t ns = 0;
+  ASSERT_TRUE(GpsWeekTimeToNanos(w, &ns));
+  EXPECT_EQ(ns, ToInt64Nanoseconds(gps - GpsEpoch()));
+  back = GpsNanosToWeekTime(ns);
+  EXPECT_EQ(back.week, w.week);
+  EXPECT_EQ(back.tow_nanos, w.tow_nanos);
+
+  // Times of week outside the week and times before the epoch are normalized.
+  w.week = 0;
+  w.tow_nanos = -1;
+  EXPECT_EQ(FromGpsWeekTime(w), GpsEpoch() - Nanoseconds(1));
+  ASSERT_TRUE(GpsWeekTimeToNanos(w, &ns));
+  EXPECT_EQ(ns, -1);
+  for (GpsWeekTime t : {GpsNanosToWeekTime(-1),
+                        ToGpsWeekTime(GpsEpoch() - Nanoseconds(0.25))}) {
+    EXPECT_EQ(t.week, -1);
+    EXPECT_EQ(t.tow_nanos, kGpsWeekNanos - 1);
+  }
+
+  // Infinities map to the week the batch conversions use for errors.
+  for (GpsTime t : {GpsInfiniteFuture(), GpsInfinitePast()}) {
+    back = ToGpsWeekTime(t);
+    EXPECT_EQ(back.week, std::numeric_limits<int64_t>::min());
+    EXPECT_EQ(back.tow_nanos, 0);
+  }
+  EXPECT_EQ(FromGpsWeekTime(back), GpsInfinitePast());
+  const GpsTime latest = GpsEpoch() + internal::MakeDuration(absl::Seconds(
+                                          std::numeric_limits<int64_t>::max()));
+  EXPECT_EQ(FromGpsWeekTime(ToGpsWeekTime(latest)), latest);
+
+  // Results that overflow are not converted.
+  ns = 42;
+  w.week = std::numeric_limits<int64_t>::max() / kGpsWeekNanos;
+  w.tow_nanos = kGpsWeekNanos;
+  EXPECT_FALSE(GpsWeekTimeToNanos(w, &ns));
+  w.week = 1 - w.week;
+  w.tow_nanos = -2 * kGpsWeekNanos;
+  EXPECT_FALSE(GpsWeekTimeToNanos(w, &ns));
+  EXPECT_EQ(ns, 42);
+}
+
+TEST(TimeTest, UnwrapGpsWeek) {
+  // A 10-bit week number received in 2019, before and after the rollover,
+  // with a reference week from 2018.
+  EXPECT_EQ(UnwrapGpsWeek(1023, kGpsLegacyWeekBits, 2000), 2047);
+  EXPECT_EQ(UnwrapGpsWeek(0, kGpsLegacyWeekBits, 2000), 2048);
+  EXPECT_EQ(UnwrapGpsWeek(2048 + 1023, kGpsLegacyWeekBits, 2000), 2047);
+
+  // The nearest week is chosen on either side of the reference, or the earlier
+  // one if both are half a rollover away.
+  EXPECT_EQ(UnwrapGpsWeek(2000 % 1024 + 511, kGpsLegacyWeekBits, 2000), 2511);
+  EXPECT_EQ(UnwrapGpsWeek(2000 % 1024 + 512, kGpsLegacyWeekBits, 2000), 1488);
+  EXPECT_EQ(UnwrapGpsWeek(2000 % 1024 - 512, kGpsLegacyWeekBits, 2000), 1488);
+
+  // 13-bit week numbers have not yet rolled over, and do so in 2137.
+  EXPECT_EQ(UnwrapGpsWeek(2048, kGpsCnavWeekBits, 2000), 2048);
+  EXPECT_EQ(UnwrapGpsWeek(5, kGpsCnavWeekBits, 8190), 8197);
+  EXPECT_EQ(UnwrapGpsWeek(8190, kGpsCnavWeekBits, 3), -2);
+}
+
+TEST(TimeTest, Ntp) {
+  // The start of NTP era 1, 2036-02-07 06:28:16 UTC, and half a second later.
+  const int64_t era1 = absl::ToUnixNanos(
+      absl::FromDateTime(2036, 2, 7, 6, 28, 16, absl::UTCTimeZone()));
+  int64_t ns = 0;
+  ASSERT_TRUE(NtpToUnixNanos(uint64_t{1} << 31, 1, &ns));
+  EXPECT_EQ(ns, era1 + 500000000);
+  ASSERT_TRUE(NtpToUnixNanos(~uint64_t{0}, 0, &ns));
+  EXPECT_EQ(ns, era1 - 1);
+  uint64_t ntp = 0;
+  int era = -1;
+  UnixNanosToNtp(era1 + 500000000, &ntp, &era);
+  EXPECT_EQ(ntp, uint64_t{1} << 31);
+  EXPECT_EQ(era, 1);
+  UnixNanosToNtp(0, &ntp, &era);
+  EXPECT_EQ(ntp, uint64_t{2208988800} << 32);
+  EXPECT_EQ(era, 0);
+
+  // Round trips from nanoseconds are exact, including before the NTP epoch.
+  for (int64_t t : {int64_t{-1}, int64_t{1}, int64_t{999999999}, era1 - 1,
+                    std::numeric_limits<int64_t>::min(),
+                    std::numeric_limits<int64_t>::max()}) {
+    SCOPED_TRACE(t);
+    UnixNanosToNtp(t, &ntp, &era);
+    ASSERT_TRUE(NtpToUnixNanos(ntp, era, &ns));
+    EXPECT_EQ(ns, t);
+  }
+  UnixNanosToNtp(-int64_t{2208988801} * 1000000000, &ntp, &era);
+  EXPECT_EQ(era, -1);
+
+  // Results that overflow are not converted.
+  ns = 42;
+  EXPECT_FALSE(NtpToUnixNanos(~uint64_t{0}, 2, &ns));
+  EXPECT_FALSE(NtpToUnixNanos(0, -2, &ns));
+  EXPECT_FALSE(NtpToUnixNanos(0, std::numeric_limits<int>::min(), &ns));
+  EXPECT_EQ(ns, 42);
+
+  // Eras are chosen nearest to the reference.
+  const absl::Time now =
+      absl::FromDateTime(2030, 1, 1, 0, 0, 0, absl::UTCTimeZone());
+  EXPECT_EQ(UnwrapNtpEra(uint64_t{1} << 31, now), 1);
+  EXPECT_EQ(UnwrapNtpEra(~uint64_t{0}, now), 0);
+  EXPECT_EQ(UnwrapNtpEra(0, absl::UnixEpoch()), 1);
+  const absl::Time past =
+      absl::FromDateTime(1950, 1, 1, 0, 0, 0, absl::UTCTimeZone());
+  EXPECT_EQ(UnwrapNtpEra(0, past), 0);
+  EXPECT_EQ(UnwrapNtpEra(~uint64_t{0}, past), -1);
+}
+
+TEST(TimeTest, Ptp) {
+  PtpTimestamp ptp;
+  ptp.seconds = 1234567890;
+  ptp.nanoseconds = 123456789;
+  const int64_t tai_ns = ToInt64Nanoseconds(
+      TaiEpoch() + 4383 * Hours(24) + Seconds(1234567890) +
+      Nanoseconds(123456789) - TaiEpoch());
+  int64_t ns = 0;
+  ASSERT_TRUE(PtpToTaiNanos(ptp, &ns));
+  EXPECT_EQ(ns, tai_ns);
+  PtpTimestamp back;
+  ASSERT_TRUE(TaiNanosToPtp(tai_ns, &back));
+  EXPECT_EQ(back.seconds, ptp.seconds);
+  EXPECT_EQ(back.nanoseconds, ptp.nanoseconds);
+
+  // Invalid timestamps, results that overflow, and times before the PTP epoch
+  // are not converted.
+  ns = 42;
+  ptp.nanoseconds = 1000000000;
+  EXPECT_FALSE(PtpToTaiNanos(ptp, &ns));
+  ptp.nanoseconds = 0;
+  ptp.seconds = uint64_t{1} << 48;
+  EXPECT_FALSE(PtpToTaiNanos(ptp, &ns));
+  ptp.seconds = 9223372037 - 4383 * 86400;
+  EXPECT_FALSE(PtpToTaiNanos(ptp, &ns));
+  EXPECT_EQ(ns, 42);
+  EXPECT_FALSE(TaiNanosToPtp(4383 * 86400 * int64_t{1000000000} - 1, &back));
+  EXPECT_FALSE(TaiNanosToPtp(std::numeric_limits<int64_t>::min(), &back));
+  EXPECT_EQ(back.seconds, 1234567890);
+}
+
+TEST(TimeTest, Compact) {
+  static_assert(sizeof(GpsTime64) == 8, "");
+  auto tai = TaiEpoch() + 12345 * Hours(24) + Seconds(19) + Nanoseconds(7);
+  auto gps = ToGpsTime(tai);
+
+  TaiTime64 tai64;
+  GpsTime64 gps64;
+  ASSERT_TRUE(ToTaiTime64(tai, &tai64));
+  ASSERT_TRUE(ToGpsTime64(tai, &gps64));
+  EXPECT_EQ(tai64.nanoseconds(), ToInt64Nanoseconds(tai - TaiEpoch()));
+  EXPECT_EQ(gps64.nanoseconds(), ToInt64Nanoseconds(gps - GpsEpoch()));
+  EXPECT_EQ(ToTaiTime(tai64), tai);
+  EXPECT_EQ(ToTaiTime(gps64), tai);
+  EXPECT_EQ(ToGpsTime(tai64), gps);
+  EXPECT_EQ(ToGpsTime(gps64), gps);
+
+  TaiTime64 tai64_from_gps;
+  GpsTime64 gps64_from_tai;
+  ASSERT_TRUE(ToTaiTime64(gps64, &tai64_from_gps));
+  ASSERT_TRUE(ToGpsTime64(tai64, &gps64_from_tai));
+  EXPECT_EQ(tai64_from_gps, tai64);
+  EXPECT_EQ(gps64_from_tai, gps64);
+
+  // Relational operators and differences.
+  TaiTime64 later = TaiTime64::FromNanoseconds(tai64.nanoseconds() + 1);
+  EXPECT_LT(tai64, later);
+  EXPECT_LE(tai64, later);
+  EXPECT_GT(later, tai64);
+  EXPECT_GE(later, tai64);
+  EXPECT_NE(later, tai64);
+  EXPECT_EQ(later - tai64, Nanoseconds(1));
+  EXPECT_EQ(TaiTime64::FromNanoseconds(std::numeric_limits<int64_t>::max()) -
+                TaiTime64::FromNanoseconds(std::numeric_limits<int64_t>::min()),
+            Nanoseconds(std::numeric_limits<int64_t>::max()) * 2 +
+                Nanoseconds(1));
+
+  // Sub-nanosecond times are floored.
+  ASSERT_TRUE(ToTaiTime64(tai + Nanoseconds(0.75), &tai64));
+  EXPECT_EQ(ToTaiTime(tai64), tai);
+  ASSERT_TRUE(ToTaiTime64(TaiEpoch() - Nanoseconds(0.25), &tai64));
+  EXPECT_EQ(tai64.nanoseconds(), -1);
+
+  // The range ends where nanoseconds since the epoch overflow.
+  TaiTime max = TaiEpoch() + Nanoseconds(std::numeric_limits<int64_t>::max());
+  TaiTime min = TaiEpoch() + Nanoseconds(std::numeric_limits<int64_t>::min());
+  EXPECT_EQ(FormatTime(max), "2250-04-11 23:47:16.854775807 TAI");
+  EXPECT_EQ(FormatTime(min), "1665-09-21 00:12:43.145224192 TAI");
+  ASSERT_TRUE(ToTaiTime64(max + Nanoseconds(0.75), &tai64));
+  EXPECT_EQ(ToTaiTime(tai64), max);
+  ASSERT_TRUE(ToTaiTime64(min, &tai64));
+  EXPECT_EQ(ToTaiTime(tai64), min);
+
+  TaiTime64 unchanged = TaiTime64::FromNanoseconds(42);
+  for (TaiTime t : {max + Nanoseconds(1), min - Nanoseconds(0.25),
+                    TaiInfiniteFuture(), TaiInfinitePast()}) {
+    EXPECT_FALSE(ToTaiTime64(t, &unchanged)) << FormatTime(t);
+  }
+  EXPECT_FALSE(ToGpsTime64(min, &gps64));
+  EXPECT_FALSE(ToTaiTime64(
+      GpsTime64::FromNanoseconds(std::numeric_limits<int64_t>::max()),
+      &unchanged));
+  EXPECT_EQ(unchanged.nanoseconds(), 42);
+}
+
+TEST(TimeTest, TimeFormat) {
+  const TimeFormat default_format;
+  const std::string format = "%Y-%m-%d %H:%M:%E*S %Z";
+  EXPECT_EQ(default_format.Format(TaiModernUtcEpoch()),
+            "1972-01-01 00:00:10 TAI");
+  EXPECT_EQ(default_format.Format(GpsEpoch() + Nanoseconds(1)),
+            "1980-01-06 00:00:00.000000001 GPST");
+  EXPECT_EQ(default_format.Format(ModernUtcEpoch() + absl::Milliseconds(120)),
+            "1972-01-01 00:00:00.12 UTC");
+  EXPECT_EQ(default_format.Format(TaiInfiniteFuture()), "tai-infinite-future");
+  EXPECT_EQ(default_format.Format(GpsInfinitePast()), "gpst-infinite-past");
+  EXPECT_EQ(default_format.Format(absl::InfiniteFuture()), "infinite-future");
+  EXPECT_EQ(default_format.Format(absl::InfinitePast()), "infinite-past");
+
+  // Finite times at the limits of absl::Time fall back to FormatTime() too.
+  for (absl::Time utc :
+       {absl::FromUnixSeconds(std::numeric_limits<int64_t>::min()),
+        absl::FromUnixSeconds(std::numeric_limits<int64_t>::max()),
+        absl::FromUnixSeconds(std::numeric_limits<int64_t>::min()) +
+            absl::Nanoseconds(1),
+        absl::FromUnixSeconds(std::numeric_limits<int64_t>::max()) +
+            absl::Seconds(1) - absl::Nanoseconds(1)}) {
+    EXPECT_EQ(default_format.Format(utc), ::unsmear::FormatTime(format, utc));
+  }
+
+  // Formatting matches FormatTime(), including outside the fast path, for
+  // years of other than four digits and fractions of nanoseconds.
+  std::vector<absl::Duration> offsets = {
+      absl::ZeroDuration(),        absl::Nanoseconds(1),
+      -absl::Nanoseconds(1),       absl::Nanoseconds(999999999),
+      absl::Seconds(1),            -absl::Hours(24),
+      absl::Nanoseconds(1) / 4,    -absl::Hours(24 * 366 * 1000),
+      absl::Seconds(253402300799), absl::Seconds(253402300800)};
+  for (int64_t i = 0; i < 1000; ++i) {
+    offsets.push_back(absl::Nanoseconds(i * 4876543210987651 + i % 7 * 100000));
+  }
+  for (absl::Duration offset : offsets) {
+    TaiTime tai = TaiEpoch() + internal::MakeDuration(offset);
+    GpsTime gps = GpsEpoch() + internal::MakeDuration(offset);
+    absl::Time utc = absl::UnixEpoch() + offset;
+    EXPECT_EQ(default_format.Format(tai), FormatTime(format, tai));
+    EXPECT_EQ(default_format.Format(gps), FormatTime(format, gps));
+    EXPECT_EQ(default_format.Format(utc), ::unsmear::FormatTime(format, utc));
+  }
+
+  // Other formats.
+  const TimeFormat custom("%Y %V %Z %% %%% %%Z %");
+  EXPECT_EQ(custom.Format(TaiModernUtcEpoch()), "1972 52 TAI % %% %Z %");
+  EXPECT_EQ(custom.Format(ModernUtcEpoch()), "1972 52 UTC % %% %Z %");
+  const TimeFormat fast_custom("%Y-%m-%d %H:%M:%E*S (%Z)");
+  EXPECT_EQ(fast_custom.Format(GpsEpoch()), "1980-01-06 00:00:00 (GPST)");
+}
+
+TEST(TimeTest, TimeFormatToBuffers) {
+  const TimeFormat format;
+  const TaiTime tai = TaiModernUtcEpoch() + Milliseconds(5);
+  const std::string expected = "1972-01-01 00:00:10.005 TAI";
+
+  std::string s = "at ";
+  format.AppendTo(tai, &s);
+  format.AppendTo(ModernUtcEpoch(), &s);
+  EXPECT_EQ(s, "at " + expected + "1972-01-01 00:00:00 UTC");
+
+  char buf[TimeFormat::kMaxDefaultSize];
+  EXPECT_EQ(format.FormatTo(tai, buf, sizeof(buf)), expected.size());
+  EXPECT_EQ(std::string(buf), expected);
+  EXPECT_EQ(format.FormatTo(tai, buf, 5), expected.size());
+  EXPECT_EQ(std::string(buf), "1972");
+  EXPECT_EQ(format.FormatTo(tai, buf, 0), expected.size());
+  EXPECT_EQ(format.FormatTo(TaiInfinitePast(), buf, sizeof(buf)),
+            strlen("tai-infinite-past"));
+  EXPECT_EQ(std::string(buf), "tai-infinite-past");
+  EXPECT_EQ(format.FormatTo(absl::InfinitePast(), buf, sizeof(buf)),
+            strlen("infinite-past"));
+  EXPECT_EQ(std::string(buf), "infinite-past");
+  EXPECT_EQ(format.FormatTo(absl::InfiniteFuture(), buf, sizeof(buf)),
+            strlen("infinite-future"));
+  EXPECT_EQ(std::string(buf), "infinite-future");
+  const absl::Time min = absl::FromUnixSeconds(
+      std::numeric_limits<int64_t>::min());
+  const std::string min_str = ::unsmear::FormatTime(min);
+  EXPECT_EQ(format.FormatTo(min, buf, sizeof(buf)), min_str.size());
+  EXPECT_EQ(std::string(buf), min_str);
+
+  const TimeFormat custom("%Y week %V");
+  EXPECT_EQ(custom.FormatTo(absl::UnixEpoch(), buf, sizeof(buf)), 12u);
+  EXPECT_EQ(std::string(buf), "1970 week 01");
+}
+
+TEST(TimeTest, FixedWidthTimeFormat) {
+  const FixedWidthTimeFormat millis(3);
+  const std::vector<TaiTime> tai = {
+      TaiModernUtcEpoch(), TaiModernUtcEpoch() + Nanoseconds(1999999),
+      TaiInfiniteFuture(), TaiModernUtcEpoch() + Hours(24) - Nanoseconds(1)};
+  const std::string expected =
+      "1972-01-01 00:00:10.000 TAI,"
+      "1972-01-01 00:00:10.001 TAI,"
+      "                           ,"
+      "1972-01-02 00:00:09.999 TAI,";
+  ASSERT_EQ(millis.width(TaiTime()), 27u);
+  std::string buf(expected.size(), ',');
+  std::vector<bool> valid;
+  EXPECT_EQ(millis.FormatAll(tai, &buf[0], 28, &valid), 3u);
+  EXPECT_EQ(buf, expected);
+  EXPECT_EQ(valid, std::vector<bool>({true, true, false, true}));
+
+  const FixedWidthTimeFormat seconds(0);
+  const std::vector<GpsTime> gps = {GpsEpoch() + Milliseconds(999)};
+  buf.assign(seconds.width(GpsTime()), '.');
+  EXPECT_EQ(seconds.FormatAll(gps, &buf[0], 0), 1u);
+  EXPECT_EQ(buf, "1980-01-06 00:00:00 GPST");
+
+  // The years 0 and 9999 are formatted, and the years around them are not.
+  const std::vector<absl::Time> utc = {
+      absl::FromCivil(absl::CivilSecond(0, 1, 1, 0, 0, 0), absl::UTCTimeZone()),
+      absl::FromCivil(absl::CivilSecond(9999, 12, 31, 23, 59, 59),
+                      absl::UTCTimeZone()),
+      absl::FromCivil(absl::CivilSecond(-1, 12, 31, 23, 59, 59),
+                      absl::UTCTimeZone()),
+      absl::FromCivil(absl::CivilSecond(10000, 1, 1, 0, 0, 0),
+                      absl::UTCTimeZone()),
+      absl::InfinitePast(),
+      absl::InfiniteFuture(),
+      absl::FromUnixSeconds(std::numeric_limits<int64_t>::min()),
+      absl::FromUnixSeconds(std::numeric_limits<int64_t>::max())};
+  const FixedWidthTimeFormat nanos;
+  const size_t width = nanos.width(absl::Time());
+  buf.assign(utc.size() * width, '.');
+  EXPECT_EQ(nanos.FormatAll(utc, &buf[0], width, &valid), 2u);
+  EXPECT_EQ(buf.substr(0, 2 * width),
+            "0000-01-01 00:00:00.000000000 UTC"
+            "9999-12-31 23:59:59.000000000 UTC");
+  EXPECT_EQ(buf.substr(2 * width), std::string(6 * width, ' '));
+  EXPECT_EQ(valid, std::vector<bool>(
+                       {true, true, false, false, false, false, false, false}));
+
+  // So are the infinities and limits of TaiTime and GpsTime.
+  const std::vector<GpsTime> gps_limits = {
+      GpsInfinitePast(), GpsInfiniteFuture(),
+      GpsEpoch() + internal::MakeDuration(
+                       absl::Seconds(std::numeric_limits<int64_t>::min())),
+      GpsEpoch() + internal::MakeDuration(
+                       absl::Seconds(std::numeric_limits<int64_t>::max()))};
+  const size_t gps_width = nanos.width(GpsTime());
+  buf.assign(gps_limits.size() * gps_width, '.');
+  EXPECT_EQ(nanos.FormatAll(gps_limits, &buf[0], gps_width, &valid), 0u);
+  EXPECT_EQ(buf, std::string(gps_limits.size() * gps_width, ' '));
+  const std::vector<TaiTime> tai_limits = {TaiInfinitePast(),
+                                           TaiInfiniteFuture()};
+  const size_t tai_width = nanos.width(TaiTime());
+  buf.assign(tai_limits.size() * tai_width, '.');
+  EXPECT_EQ(nanos.FormatAll(tai_limits, &buf[0], tai_width, &valid), 0u);
+  EXPECT_EQ(buf, std::string(tai_limits.size() * tai_width, ' '));
+
+  // Unlike FormatTime(), years before 1000 are zero-padded to four digits.
+  const absl::Time year999 = absl::FromCivil(
+      absl::CivilSecond(999, 12, 31, 23, 59, 59), absl::UTCTimeZone());
+  EXPECT_EQ(unsmear::FormatTime(year999), "999-12-31 23:59:59 UTC");
+  buf.assign(seconds.width(year999), '.');
+  EXPECT_EQ(seconds.FormatAll(absl::MakeConstSpan(&year999, 1), &buf[0],
+                              buf.size()),
+            1u);
+  EXPECT_EQ(buf, "0999-12-31 23:59:59 UTC");
+
+  // Records match absl::FormatTime() with the same number of digits, which
+  // also truncates.
+  for (int digits = 0; digits <= 9; ++digits) {
+    const FixedWidthTimeFormat format(digits);
+    const std::string absl_format =
+        "%Y-%m-%d %H:%M:%E" + std::to_string(digits) + "S %Z";
+    std::vector<TaiTime> times;
+    for (int64_t i = 0; i < 1000; ++i) {
+      times.push_back(TaiEpoch() +
+                      Nanoseconds(i * 4876543210987651 + i % 7 * 100000));
+    }
+    const size_t stride = format.width(TaiTime());
+    buf.assign(times.size() * stride, '.');
+    ASSERT_EQ(format.FormatAll(times, &buf[0], stride), times.size());
+    for (size_t i = 0; i < times.size(); ++i) {
+      EXPECT_EQ(buf.substr(i * stride, stride),
+                FormatTime(absl_format, times[i]));
+    }
+  }
+}
+
+TEST(TimeTest, ParseTime) {
+  TaiTime tai;
+  GpsTime gps;
+  absl::Time utc;
+  std::string err;
+  EXPECT_TRUE(ParseTime("1972-01-01 00:00:10 TAI", &tai, &err)) << err;
+  EXPECT_EQ(tai, TaiModernUtcEpoch());
+  EXPECT_TRUE(ParseTime("1980-01-06 00:00:00.000000001 GPST", &gps, &err))
+      << err;
+  EXPECT_EQ(gps, GpsEpoch() + Nanoseconds(1));
+  EXPECT_TRUE(ParseTime("1972-01-01 00:00:00.12 UTC", &utc, &err)) << err;
+  EXPECT_EQ(utc, ModernUtcEpoch() + absl::Milliseconds(120));
+  EXPECT_TRUE(ParseTime("tai-infinite-future", &tai, &err)) << err;
+  EXPECT_EQ(tai, TaiInfiniteFuture());
+  EXPECT_TRUE(ParseTime("gpst-infinite-past", &gps, &err)) << err;
+  EXPECT_EQ(gps, GpsInfinitePast());
+
+  // Other formats.
+  EXPECT_TRUE(ParseTime("%Y-%m-%dT%H:%M:%E6S %Z", "1958-01-01T00:00:01.5 TAI",
+                        &tai, &err))
+      << err;
+  EXPECT_EQ(tai, TaiEpoch() + Milliseconds(1500));
+  EXPECT_TRUE(
+      ParseTime("%d %b %Y %H:%M:%S (%Z)", "6 Jan 1980 00:00:00 (GPST)", &gps,
+                &err))
+      << err;
+  EXPECT_EQ(gps, GpsEpoch());
+
+  // Errors.
+  const std::vector<std::string> invalid = {
+      "",
+      "1972-01-01 00:00:10",
+      "1972-01-01 00:00:10 UTC",
+      "1972-02-30 00:00:10 TAI",
+      "1972-01-01 24:00:10 TAI",
+      "1972-01-01 00:00:10. TAI",
+      "1972-01-01 00:00:10.x TAI",
+      "gpst-infinite-past",
+  };
+  for (const auto& s : invalid) {
+    err.clear();
+    EXPECT_FALSE(ParseTime(s, &tai, &err)) << s;
+    EXPECT_FALSE(err.empty()) << s;
+  }
+  EXPECT_FALSE(ParseTime("1972-01-01 00:00:10 TAI", &gps, nullptr));
+}
+
+TEST(TimeTest, ParseTimeRoundTrip) {
+  // The fast path gives the same results as absl::ParseTime(), which is used
+  // for the equivalent format without %Z.
+  for (int64_t i = 0; i < 1000; ++i) {
+    TaiTime tai =
+        TaiEpoch() + Nanoseconds(i * 4876543210987651 + i % 7 * 100000);
+    GpsTime gps = ToGpsTime(tai);
+    absl::Time utc = absl::UnixEpoch() + internal::GetRep(tai - TaiEpoch());
+    SCOPED_TRACE(tai);
+
+    TaiTime parsed_tai;
+    ASSERT_TRUE(ParseTime(FormatTime(tai), &parsed_tai, nullptr));
+    EXPECT_EQ(parsed_tai, tai);
+    ASSERT_TRUE(ParseTime("%Y-%m-%d %H:%M:%E*S TAI", FormatTime(tai),
+                          &parsed_tai, nullptr));
+    EXPECT_EQ(parsed_tai, tai);
+
+    GpsTime parsed_gps;
+    ASSERT_TRUE(ParseTime(FormatTime(gps), &parsed_gps, nullptr));
+    EXPECT_EQ(parsed_gps, gps);
+
+    absl::Time parsed_utc;
+    ASSERT_TRUE(ParseTime(::unsmear::FormatTime(utc), &parsed_utc, nullptr));
+    EXPECT_EQ(parsed_utc, utc);
+  }
+}
+
 }  // namespace
 }  // namespace unsmear
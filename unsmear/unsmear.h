@@ -16,12 +16,17 @@
 #define UNSMEAR_UNSMEAR_H
 
 #include <cstdint>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
-#include "unsmear/leap_table.pb.h"
+#include "absl/types/span.h"
 
 namespace unsmear {
 
@@ -431,6 +436,366 @@ inline GpsTime ToGpsTime(internal::TtBasedTime<timescale> t) {
   return GpsEpoch() - TaiOffset(GpsTime()) + (ToTaiTime(t) - TaiEpoch());
 }
 
+namespace internal {
+// The offset between the TAI and GPS epochs, TaiOffset(GpsTime()).
+constexpr int64_t kTaiGpsOffsetNanos = (8040 * 86400 + 19) * 1000000000LL;
+}  // namespace internal
+
+// Converts between nanoseconds since the TAI epoch and nanoseconds since the
+// GPS epoch, for times stored as integers.  Returns false, leaving the output
+// unchanged, if the result cannot be represented.
+inline bool TaiNanosToGpsNanos(int64_t tai, int64_t* gps) {
+  if (tai <
+      std::numeric_limits<int64_t>::min() + internal::kTaiGpsOffsetNanos) {
+    return false;
+  }
+  *gps = tai - internal::kTaiGpsOffsetNanos;
+  return true;
+}
+inline bool GpsNanosToTaiNanos(int64_t gps, int64_t* tai) {
+  if (gps >
+      std::numeric_limits<int64_t>::max() - internal::kTaiGpsOffsetNanos) {
+    return false;
+  }
+  *tai = gps + internal::kTaiGpsOffsetNanos;
+  return true;
+}
+
+// A GPST time as a week number and time of week, as broadcast by GNSS
+// satellites and output by receivers.  Weeks count from the GPS epoch, and
+// start at midnight GPST between Saturday and Sunday.
+struct GpsWeekTime {
+  int64_t week = 0;
+  int64_t tow_nanos = 0;  // Nanoseconds since the start of the week.
+};
+
+constexpr int64_t kGpsWeekNanos = int64_t{7 * 86400} * 1000000000;
+
+// Converts between GpsTime and week numbers and times of week.  The time of
+// week is normally in [0, kGpsWeekNanos), but others are accepted.
+// ToGpsWeekTime() floors to whole nanoseconds, and maps both infinities to the
+// week std::numeric_limits<int64_t>::min() and time of week 0, like the batch
+// conversions of LeapTable; FromGpsWeekTime() maps that to the infinite past.
+inline GpsTime FromGpsWeekTime(GpsWeekTime t) {
+  return GpsEpoch() + t.week * Hours(7 * 24) + Nanoseconds(t.tow_nanos);
+}
+inline GpsWeekTime ToGpsWeekTime(GpsTime t) {
+  GpsWeekTime w;
+  if (t == GpsTime::InfiniteFuture() || t == GpsTime::InfinitePast()) {
+    w.week = std::numeric_limits<int64_t>::min();
+    return w;
+  }
+  Duration tow;
+  w.week = IDivDuration(t - GpsEpoch(), Hours(7 * 24), &tow);
+  if (tow < ZeroDuration()) {
+    --w.week;
+    tow += Hours(7 * 24);
+  }
+  w.tow_nanos = ToInt64Nanoseconds(tow);
+  return w;
+}
+
+// Converts between week numbers and times of week and nanoseconds since the
+// GPS epoch, for use with LeapTable::SmearGpsNanos() and UnsmearToGpsNanos().
+// GpsWeekTimeToNanos() returns false, leaving the output unchanged, if the
+// result cannot be represented.
+inline bool GpsWeekTimeToNanos(GpsWeekTime t, int64_t* gps) {
+  constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+  constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+  if (t.week > kMax / kGpsWeekNanos || t.week < kMin / kGpsWeekNanos) {
+    return false;
+  }
+  const int64_t start = t.week * kGpsWeekNanos;
+  if ((t.tow_nanos > 0 && start > kMax - t.tow_nanos) ||
+      (t.tow_nanos < 0 && start < kMin - t.tow_nanos)) {
+    return false;
+  }
+  *gps = start + t.tow_nanos;
+  return true;
+}
+inline GpsWeekTime GpsNanosToWeekTime(int64_t gps) {
+  GpsWeekTime w;
+  w.week = gps / kGpsWeekNanos;
+  w.tow_nanos = gps % kGpsWeekNanos;
+  if (w.tow_nanos < 0) {
+    --w.week;
+    w.tow_nanos += kGpsWeekNanos;
+  }
+  return w;
+}
+
+// The widths of the week numbers in GPS navigation messages: 10 bits in the
+// legacy L1 C/A message, which rolls over every 1024 weeks (about 19.6 years),
+// and 13 bits in the CNAV and CNAV-2 messages, every 8192 weeks (about 157
+// years).
+constexpr int kGpsLegacyWeekBits = 10;
+constexpr int kGpsCnavWeekBits = 13;
+
+// Returns the full week number whose low week_bits bits are those of
+// truncated_week, nearest to reference_week, or the earlier of two equally
+// near.  The reference is usually a week known to within half a rollover
+// period, such as that of the receiver's build date or of a recent fix.
+inline int64_t UnwrapGpsWeek(int64_t truncated_week, int week_bits,
+                             int64_t reference_week) {
+  const int64_t period = int64_t{1} << week_bits;
+  const int64_t half = period / 2;
+  int64_t d = (truncated_week - reference_week + half) % period;
+  if (d < 0) {
+    d += period;
+  }
+  return reference_week + d - half;
+}
+
+namespace internal {
+// Seconds from the NTP epoch, 1900-01-01 00:00:00 UTC, to the Unix epoch.
+constexpr int64_t kNtpUnixOffsetSeconds = 2208988800;
+// Seconds from the TAI epoch to the PTP epoch, 1970-01-01 00:00:00 TAI.
+constexpr int64_t kTaiPtpOffsetSeconds = 4383 * 86400;
+}  // namespace internal
+
+// Converts between 64-bit NTP timestamps and nanoseconds since the Unix epoch,
+// for times stored as integers.  NTP timestamps are 32.32 fixed point seconds
+// since the start of an NTP era, in host byte order; era 0 began at the NTP
+// epoch, 1900-01-01 00:00:00, and era 1 begins in 2036.  Fractions of
+// nanoseconds are floored, and nanoseconds rounded up to the next fraction, so
+// round trips from nanoseconds are exact.  NtpToUnixNanos() returns false,
+// leaving the output unchanged, if the result cannot be represented.
+inline bool NtpToUnixNanos(uint64_t ntp, int era, int64_t* utc) {
+  constexpr int64_t kNanosPerSecond = 1000000000;
+  // Only eras -2 to 2 overlap the range of nanoseconds since the Unix epoch.
+  if (era < -2 || era > 2) {
+    return false;
+  }
+  const int64_t seconds = era * (int64_t{1} << 32) +
+                          static_cast<int64_t>(ntp >> 32) -
+                          internal::kNtpUnixOffsetSeconds;
+  const int64_t nanos =
+      static_cast<int64_t>(((ntp & 0xffffffff) * kNanosPerSecond) >> 32);
+  // The earliest representable times are in the second before the quotient
+  // of the minimum, so they are counted back from the next second.
+  constexpr int64_t kMinSeconds =
+      std::numeric_limits<int64_t>::min() / kNanosPerSecond;
+  if (seconds >
+          (std::numeric_limits<int64_t>::max() - nanos) / kNanosPerSecond ||
+      seconds < kMinSeconds - 1) {
+    return false;
+  }
+  if (seconds < kMinSeconds) {
+    if (kNanosPerSecond - nanos > kMinSeconds * kNanosPerSecond -
+                                      std::numeric_limits<int64_t>::min()) {
+      return false;
+    }
+    *utc = kMinSeconds * kNanosPerSecond - (kNanosPerSecond - nanos);
+    return true;
+  }
+  *utc = seconds * kNanosPerSecond + nanos;
+  return true;
+}
+inline void UnixNanosToNtp(int64_t utc, uint64_t* ntp, int* era) {
+  constexpr int64_t kNanosPerSecond = 1000000000;
+  int64_t seconds = utc / kNanosPerSecond;
+  int64_t nanos = utc % kNanosPerSecond;
+  if (nanos < 0) {
+    --seconds;
+    nanos += kNanosPerSecond;
+  }
+  seconds += internal::kNtpUnixOffsetSeconds;
+  int64_t e = seconds / (int64_t{1} << 32);
+  if (seconds < e * (int64_t{1} << 32)) {
+    --e;
+  }
+  *era = static_cast<int>(e);
+  const uint64_t fraction =
+      ((static_cast<uint64_t>(nanos) << 32) + kNanosPerSecond - 1) /
+      kNanosPerSecond;
+  *ntp = (static_cast<uint64_t>(seconds - e * (int64_t{1} << 32)) << 32) |
+         fraction;
+}
+
+// Returns the era of the NTP timestamp nearest to the reference time, or the
+// earlier of two equally near.  NTP eras are about 136 years long, so any
+// reference within a few decades, such as the build date, suffices.
+inline int UnwrapNtpEra(uint64_t ntp, absl::Time reference) {
+  const int64_t period = int64_t{1} << 32;
+  const int64_t offset = absl::ToUnixSeconds(reference) +
+                         internal::kNtpUnixOffsetSeconds -
+                         static_cast<int64_t>(ntp >> 32) + period / 2;
+  int64_t era = offset / period;
+  if (offset < era * period) {
+    --era;
+  }
+  return static_cast<int>(era);
+}
+
+// A PTP timestamp, as in IEEE 1588: 48 bits of TAI seconds since the PTP epoch,
+// 1970-01-01 00:00:00 TAI, and nanoseconds within the second.
+struct PtpTimestamp {
+  uint64_t seconds = 0;
+  uint32_t nanoseconds = 0;
+};
+
+// Converts between PTP timestamps and nanoseconds since the TAI epoch, for
+// times stored as integers.  PtpToTaiNanos() returns false, leaving the output
+// unchanged, if the timestamp is invalid or the result cannot be represented,
+// and TaiNanosToPtp() if the time is before the PTP epoch.
+inline bool PtpToTaiNanos(PtpTimestamp t, int64_t* tai) {
+  constexpr int64_t kNanosPerSecond = 1000000000;
+  if (t.seconds >= (uint64_t{1} << 48) || t.nanoseconds >= kNanosPerSecond) {
+    return false;
+  }
+  const int64_t seconds =
+      static_cast<int64_t>(t.seconds) + internal::kTaiPtpOffsetSeconds;
+  if (seconds > (std::numeric_limits<int64_t>::max() - t.nanoseconds) /
+                    kNanosPerSecond) {
+    return false;
+  }
+  *tai = seconds * kNanosPerSecond + t.nanoseconds;
+  return true;
+}
+inline bool TaiNanosToPtp(int64_t tai, PtpTimestamp* t) {
+  constexpr int64_t kNanosPerSecond = 1000000000;
+  if (tai < internal::kTaiPtpOffsetSeconds * kNanosPerSecond) {
+    return false;
+  }
+  const int64_t d = tai - internal::kTaiPtpOffsetSeconds * kNanosPerSecond;
+  t->seconds = d / kNanosPerSecond;
+  t->nanoseconds = d % kNanosPerSecond;
+  return true;
+}
+
+namespace internal {
+
+// An unsmear::internal::TtBasedTime64 is a compact TtBasedTime, for storing
+// many times.  It counts whole nanoseconds since the epoch of its timescale in
+// an int64_t, so it is 8 bytes and trivially copyable, and its range is about
+// 292 years either side of the epoch.  It has no infinities.  Convert it to
+// and from the full-range TtBasedTime for arithmetic and for conversions to
+// UTC.
+template <TtBasedTimescale timescale>
+class TtBasedTime64 {
+ public:
+  // Returns a time at the epoch of this timescale.
+  constexpr TtBasedTime64() {}
+
+  // Converts from and to nanoseconds since the epoch of this timescale.
+  static constexpr TtBasedTime64 FromNanoseconds(int64_t ns) {
+    return TtBasedTime64(ns);
+  }
+  constexpr int64_t nanoseconds() const { return ns_; }
+
+ private:
+  constexpr explicit TtBasedTime64(int64_t ns) : ns_(ns) {}
+
+  friend constexpr bool operator<(TtBasedTime64 lhs, TtBasedTime64 rhs) {
+    return lhs.ns_ < rhs.ns_;
+  }
+  friend constexpr bool operator==(TtBasedTime64 lhs, TtBasedTime64 rhs) {
+    return lhs.ns_ == rhs.ns_;
+  }
+  // The difference of any two times is exact, even where it would overflow
+  // an int64_t count of nanoseconds.
+  friend Duration operator-(TtBasedTime64 lhs, TtBasedTime64 rhs) {
+    return Nanoseconds(lhs.ns_) - Nanoseconds(rhs.ns_);
+  }
+
+  int64_t ns_ = 0;
+};
+
+// Relational operators.
+template <TtBasedTimescale timescale>
+constexpr bool operator>(TtBasedTime64<timescale> lhs,
+                         TtBasedTime64<timescale> rhs) {
+  return rhs < lhs;
+}
+template <TtBasedTimescale timescale>
+constexpr bool operator>=(TtBasedTime64<timescale> lhs,
+                          TtBasedTime64<timescale> rhs) {
+  return !(lhs < rhs);
+}
+template <TtBasedTimescale timescale>
+constexpr bool operator<=(TtBasedTime64<timescale> lhs,
+                          TtBasedTime64<timescale> rhs) {
+  return !(rhs < lhs);
+}
+template <TtBasedTimescale timescale>
+constexpr bool operator!=(TtBasedTime64<timescale> lhs,
+                          TtBasedTime64<timescale> rhs) {
+  return !(lhs == rhs);
+}
+
+// Floors d to whole nanoseconds in ns, if they fit in an int64_t.
+inline bool ToInt64NanosecondsFloor(Duration d, int64_t* ns) {
+  if (d < Nanoseconds(std::numeric_limits<int64_t>::min()) ||
+      d >= Nanoseconds(std::numeric_limits<int64_t>::max()) + Nanoseconds(1)) {
+    return false;
+  }
+  Duration rem;
+  int64_t q = IDivDuration(d, Nanoseconds(1), &rem);
+  *ns = rem < ZeroDuration() ? q - 1 : q;
+  return true;
+}
+
+}  // namespace internal
+
+// Compact versions of TaiTime and GpsTime.  TaiTime64 ranges from 1665-09-21
+// to 2250-04-11, and GpsTime64 from 1687-09-26 to 2272-04-15.
+using TaiTime64 = internal::TtBasedTime64<internal::TAI>;
+using GpsTime64 = internal::TtBasedTime64<internal::GPST>;
+
+static_assert(sizeof(TaiTime64) == 8, "TaiTime64 must be compact");
+static_assert(std::is_trivially_copyable<TaiTime64>::value,
+              "TaiTime64 must be trivially copyable");
+
+// Converts compact times to full-range times, which is always exact.
+template <internal::TtBasedTimescale timescale>
+inline TaiTime ToTaiTime(internal::TtBasedTime64<timescale> t) {
+  return ToTaiTime(internal::TtBasedTime<timescale>() +
+                   Nanoseconds(t.nanoseconds()));
+}
+template <internal::TtBasedTimescale timescale>
+inline GpsTime ToGpsTime(internal::TtBasedTime64<timescale> t) {
+  return ToGpsTime(internal::TtBasedTime<timescale>() +
+                   Nanoseconds(t.nanoseconds()));
+}
+
+// Converts times to compact times, flooring them to whole nanoseconds.
+// Returns false, leaving the output unchanged, if the time is infinite or out
+// of the range of the compact type.
+template <internal::TtBasedTimescale timescale>
+inline bool ToTaiTime64(internal::TtBasedTime<timescale> t, TaiTime64* out) {
+  int64_t ns;
+  if (!internal::ToInt64NanosecondsFloor(ToTaiTime(t) - TaiEpoch(), &ns)) {
+    return false;
+  }
+  *out = TaiTime64::FromNanoseconds(ns);
+  return true;
+}
+template <internal::TtBasedTimescale timescale>
+inline bool ToGpsTime64(internal::TtBasedTime<timescale> t, GpsTime64* out) {
+  int64_t ns;
+  if (!internal::ToInt64NanosecondsFloor(ToGpsTime(t) - GpsEpoch(), &ns)) {
+    return false;
+  }
+  *out = GpsTime64::FromNanoseconds(ns);
+  return true;
+}
+inline bool ToTaiTime64(GpsTime64 t, TaiTime64* out) {
+  int64_t ns;
+  if (!GpsNanosToTaiNanos(t.nanoseconds(), &ns)) {
+    return false;
+  }
+  *out = TaiTime64::FromNanoseconds(ns);
+  return true;
+}
+inline bool ToGpsTime64(TaiTime64 t, GpsTime64* out) {
+  int64_t ns;
+  if (!TaiNanosToGpsNanos(t.nanoseconds(), &ns)) {
+    return false;
+  }
+  *out = GpsTime64::FromNanoseconds(ns);
+  return true;
+}
+
 // Times in the infinite future and past.
 inline TaiTime TaiInfiniteFuture() { return TaiTime::InfiniteFuture(); }
 inline TaiTime TaiInfinitePast() { return TaiTime::InfinitePast(); }
@@ -466,6 +831,134 @@ std::string FormatTime(const std::string& format,
                        internal::TtBasedTime<timescale> t);
 std::string FormatTime(const std::string& format, absl::Time t);
 
+// A format string for formatting or parsing many times, prepared once.  The
+// output is the same as FormatTime(), but the format is not processed again
+// for every time, and times can be formatted into existing buffers.  The
+// default format, and others consisting of "%Y-%m-%d %H:%M:%E*S" followed by
+// only literal text or %Z, are formatted and parsed directly, without
+// absl::FormatTime() or absl::ParseTime(), and formatted without allocating.
+//
+// Example:
+//   static const TimeFormat* format = new TimeFormat();
+//   std::string line = "Logged at ";
+//   format->AppendTo(tai, &line);
+class TimeFormat {
+ public:
+  // The default format, as in FormatTime(t).
+  TimeFormat();
+  // A user-specified format, as in FormatTime(format, t).
+  explicit TimeFormat(absl::string_view format);
+
+  // Returns the formatted time.
+  template <internal::TtBasedTimescale timescale>
+  std::string Format(internal::TtBasedTime<timescale> t) const;
+  std::string Format(absl::Time t) const;
+
+  // Appends the formatted time to s.
+  template <internal::TtBasedTimescale timescale>
+  void AppendTo(internal::TtBasedTime<timescale> t, std::string* s) const;
+  void AppendTo(absl::Time t, std::string* s) const;
+
+  // Writes the formatted time, truncated if necessary, and a terminating NUL
+  // to buf, which has room for n characters.  Like snprintf(), returns the
+  // length of the whole formatted time, excluding the NUL.  A buffer of
+  // kMaxDefaultSize characters is always enough for the default format.
+  template <internal::TtBasedTimescale timescale>
+  size_t FormatTo(internal::TtBasedTime<timescale> t, char* buf,
+                  size_t n) const;
+  size_t FormatTo(absl::Time t, char* buf, size_t n) const;
+
+  // Parses a time in this format, as described for ParseTime().
+  template <internal::TtBasedTimescale timescale>
+  bool Parse(absl::string_view input, internal::TtBasedTime<timescale>* t,
+             std::string* err) const;
+  bool Parse(absl::string_view input, absl::Time* t, std::string* err) const;
+
+  static constexpr size_t kMaxDefaultSize = 64;
+
+ private:
+  const std::string& format(TaiTime t) const { return tai_format_; }
+  const std::string& format(GpsTime t) const { return gps_format_; }
+  const std::string& format(absl::Time t) const { return utc_format_; }
+
+  // The format for each timescale, with %Z replaced by the zone name.
+  std::string utc_format_;
+  std::string tai_format_;
+  std::string gps_format_;
+
+  // Whether the formats consist of "%Y-%m-%d %H:%M:%E*S" followed by literal
+  // text, which is formatted without absl::FormatTime().
+  bool fast_;
+};
+
+// Formats arrays of times into fixed-width records in one caller-provided
+// buffer, for bulk text export such as CSV.  Each record is the default format
+// of FormatTime() with exactly fraction_digits digits of fraction, truncated,
+// e.g. "2006-01-02 15:04:05.123 TAI" for 3, or "2006-01-02 15:04:05 TAI" for
+// 0.  Unlike FormatTime(), years are always four digits, so years 0 to 999
+// are zero-padded, e.g. "0999-12-31 23:59:59 TAI" where FormatTime() gives
+// "999-12-31 23:59:59 TAI".  The calendar date is computed only when the day
+// changes, and the digits are generated several at a time, so sorted times
+// format many times faster than with TimeFormat.
+//
+// Example:
+//   const FixedWidthTimeFormat format(3);
+//   const size_t stride = format.width(TaiTime()) + 1;
+//   std::string csv(times.size() * stride, '\n');
+//   format.FormatAll(times, &csv[0], stride);
+class FixedWidthTimeFormat {
+ public:
+  // Formats with fraction_digits digits of fraction, clamped to 0 to 9.
+  explicit FixedWidthTimeFormat(int fraction_digits = 9);
+
+  // Returns the width of the records for times of the same type as t.
+  size_t width(TaiTime t) const { return width_ + 3; }
+  size_t width(GpsTime t) const { return width_ + 4; }
+  size_t width(absl::Time t) const { return width_ + 3; }
+
+  // Writes a record for each element of times, with the record for times[i]
+  // in the width() characters starting at buf + i * stride.  The characters
+  // between records are left unchanged, so they can hold separators.  Times
+  // that cannot be formatted in fixed width, which are infinities and times
+  // outside the years 0 to 9999, are written as spaces.  If valid is not null,
+  // it is resized to the size of the input and set to whether each element was
+  // formatted.  Returns the number of elements formatted.
+  size_t FormatAll(absl::Span<const TaiTime> times, char* buf, size_t stride,
+                   std::vector<bool>* valid = nullptr) const;
+  size_t FormatAll(absl::Span<const GpsTime> times, char* buf, size_t stride,
+                   std::vector<bool>* valid = nullptr) const;
+  size_t FormatAll(absl::Span<const absl::Time> times, char* buf,
+                   size_t stride, std::vector<bool>* valid = nullptr) const;
+
+ private:
+  template <typename Time>
+  size_t FormatAllImpl(absl::Span<const Time> times, char* buf, size_t stride,
+                       std::vector<bool>* valid) const;
+
+  int fraction_digits_;
+  // The width of the records before the zone name.
+  size_t width_;
+};
+
+// Parses a time in a format accepted by absl::ParseTime(), with %Z matching
+// the name of the timescale, e.g. "TAI".  On failure, returns false and, if err
+// is not null, sets it to an explanation.  The strings output by FormatTime()
+// for infinite times, e.g. "tai-infinite-future", are also accepted.
+//
+// The default format, as output by FormatTime(t), is parsed directly, several
+// times faster than other formats.  absl::Time is parsed in UTC.
+bool ParseTime(absl::string_view format, absl::string_view input, TaiTime* t,
+               std::string* err);
+bool ParseTime(absl::string_view format, absl::string_view input, GpsTime* t,
+               std::string* err);
+bool ParseTime(absl::string_view format, absl::string_view input,
+               absl::Time* t, std::string* err);
+
+// Parses a time in the default format, as output by FormatTime(t).
+bool ParseTime(absl::string_view input, TaiTime* t, std::string* err);
+bool ParseTime(absl::string_view input, GpsTime* t, std::string* err);
+bool ParseTime(absl::string_view input, absl::Time* t, std::string* err);
+
 namespace internal {
 
 // Outputs to a stream.
@@ -474,6 +967,30 @@ inline std::ostream& operator<<(std::ostream& os, TtBasedTime<timescale> t) {
   return os << FormatTime(t);
 }
 
+// The contents of a LeapTable, as parallel arrays of a reverse-ordered (i.e.,
+// latest-first) series of times at which the smear changed.  There will be an
+// even number of entries: the expiration, one each for the start and end of
+// each smear, and finally the smear epoch.  Every entry falls on a whole second
+// in both timescales.
+//
+// The day indexes give the entry at the end of the segment of the table
+// containing each 86,400-second day since the smear epoch, to find the segment
+// for a time in constant time.  Entries are given by their position counting
+// from the smear epoch, i.e., size - 1 - their index in the arrays, so that
+// extending a table leaves the indexes of its days unchanged.  UTC days are
+// Julian days, from noon to noon, starting with the one containing the smear
+// epoch; since all other entries are at noon UTC, each such day is entirely
+// within one segment.  The TAI days start 12 hours before the smear epoch, and
+// each index entry is for the segment containing the start of its day.  A TAI
+// day may contain the ends of up to two segments.
+struct LeapTableData {
+  absl::Span<const int64_t> utc_seconds;  // Since the Unix epoch.
+  absl::Span<const int64_t> tai_seconds;  // Since the TAI epoch.
+  absl::Span<const int8_t> smears;        // See LeapTableEntry::smear.
+  absl::Span<const uint32_t> utc_day_index;
+  absl::Span<const uint32_t> tai_day_index;
+};
+
 struct LeapTableEntry {
   // Because we construct the table from timestamps specified as JDNs, UTC times
   // will always fall at noon.
@@ -488,12 +1005,30 @@ struct LeapTableEntry {
 
 }  // namespace internal
 
+class LeapTable;
+
+namespace internal {
+
+// For use by leap_table_tool and by the code it generates only.  These return
+// the contents of a LeapTable, and a LeapTable referring to contents that must
+// have been returned by GetLeapTableData() and be stored statically.  The
+// contents are not validated.
+LeapTableData GetLeapTableData(const LeapTable& lt);
+LeapTable LeapTableFromStaticData(LeapTableData data);
+
+}  // namespace internal
+
 // A LeapTable represents conversions between timescales with leap seconds,
 // smeared or unsmeared, and timescales based on continuous seconds of
 // Terrestrial Time.  It is immutable after construction, and can therefore be
 // freely shared between threads.
 class LeapTable {
  public:
+  class Cursor;
+  class Segment;
+  template <typename Time>
+  struct RangePart;
+
   // Converts between smeared and unsmeared times, if the time is within the
   // validity range of this leap table.
   template <internal::TtBasedTimescale timescale>
@@ -511,14 +1046,206 @@ class LeapTable {
   std::pair<TaiTime, TaiTime> FutureProofUnsmear(absl::Time utc) const;
   std::pair<GpsTime, GpsTime> FutureProofUnsmearToGps(absl::Time utc) const;
 
+  // The closed intervals of times that Smear(), Unsmear() and UnsmearToGps()
+  // convert precisely.  Times in [utc_begin, utc_end] unsmear to times in
+  // [tai_begin, tai_end], and vice versa.  GPST starts later, at the GPST
+  // epoch, so times in [gps_begin, gps_end] smear to times in [UtcGpsEpoch(),
+  // utc_end]; that interval is empty if the table expires before then.
+  struct PreciseBounds {
+    absl::Time utc_begin;
+    absl::Time utc_end;
+    TaiTime tai_begin;
+    TaiTime tai_end;
+    GpsTime gps_begin;
+    GpsTime gps_end;
+  };
+  PreciseBounds PreciseRange() const;
+
+  // Versions of Smear(), Unsmear() and UnsmearToGps() for times already known
+  // to be within PreciseRange(), such as batches checked against its bounds.
+  // They skip the checks for infinities, times before the epoch and times
+  // past the expiration, and go straight to the segment lookup and the
+  // interpolation.  The results for other times are undefined; debug builds
+  // assert that the times are within range.
+  template <internal::TtBasedTimescale timescale>
+  absl::Time SmearUnchecked(internal::TtBasedTime<timescale> t) const;
+  TaiTime UnsmearUnchecked(absl::Time utc) const;
+  GpsTime UnsmearToGpsUnchecked(absl::Time utc) const;
+
+  // Returns the elapsed TAI (and so TT) time from the smeared time a to b,
+  // *Unsmear(b) - *Unsmear(a), or nullopt if either cannot be unsmeared.  The
+  // segment of the leap table is looked up once for a, and b needs no lookup if
+  // it is in the same segment, as nearly all pairs of nearby times are.
+  // Outside of smears, the result is simply b - a.
+  absl::optional<Duration> ElapsedTT(absl::Time a, absl::Time b) const;
+
+  // Returns the earliest and latest possible elapsed TAI time from a to b, for
+  // times past the expiration of the table.  These are the elapsed times if
+  // every possible leap second after the expiration is negative, and if every
+  // one is positive.  They are equal if ElapsedTT(a, b) has a value.  If
+  // either time cannot be converted at all, returns the negative and positive
+  // infinite durations.
+  std::pair<Duration, Duration> FutureProofElapsedTT(absl::Time a,
+                                                     absl::Time b) const;
+
+  // Batch version of ElapsedTT(), from each element of a to the corresponding
+  // element of b, which must be the same size as a and elapsed.  The segment
+  // of the previous pair is tried first, so pairs sorted by a are fastest.
+  // Elements that cannot be converted are output as InfiniteDuration().  If
+  // valid is not null, it is resized to the size of the input and set to
+  // whether each element was converted.  Returns the number of elements
+  // converted.
+  size_t ElapsedTT(absl::Span<const absl::Time> a,
+                   absl::Span<const absl::Time> b, absl::Span<Duration> elapsed,
+                   std::vector<bool>* valid = nullptr) const;
+
+  // Batch versions of Smear(), Unsmear(), and UnsmearToGps().  Each element of
+  // the input is converted to the corresponding element of the output, which
+  // must be the same size.  The conversion uses a Cursor, so sorted or nearly
+  // sorted inputs are fastest.  Elements that cannot be converted precisely are
+  // output as the infinite past.  If valid is not null, it is resized to the
+  // size of the input and set to whether each element was converted.  Returns
+  // the number of elements converted.
+  size_t Smear(absl::Span<const TaiTime> tai, absl::Span<absl::Time> utc,
+               std::vector<bool>* valid = nullptr) const;
+  size_t Smear(absl::Span<const GpsTime> gps, absl::Span<absl::Time> utc,
+               std::vector<bool>* valid = nullptr) const;
+  size_t Unsmear(absl::Span<const absl::Time> utc, absl::Span<TaiTime> tai,
+                 std::vector<bool>* valid = nullptr) const;
+  size_t UnsmearToGps(absl::Span<const absl::Time> utc,
+                      absl::Span<GpsTime> gps,
+                      std::vector<bool>* valid = nullptr) const;
+
+  // Runs task(i) for each i in [0, n), possibly concurrently, such as on a
+  // thread pool, and returns once every task has finished.
+  using Executor =
+      std::function<void(size_t n, const std::function<void(size_t)>& task)>;
+
+  // Parallel versions of the batch conversions, for very large inputs.  The
+  // input is split into chunks small enough to stay in cache, which the
+  // executor converts independently, each with its own Cursor, so sorted
+  // inputs still need only one lookup per segment in each chunk.  Results are
+  // identical to the batch versions.  An empty executor converts the chunks in
+  // order on the calling thread.
+  size_t ParallelSmear(const Executor& executor,
+                       absl::Span<const TaiTime> tai,
+                       absl::Span<absl::Time> utc,
+                       std::vector<bool>* valid = nullptr) const;
+  size_t ParallelSmear(const Executor& executor,
+                       absl::Span<const GpsTime> gps,
+                       absl::Span<absl::Time> utc,
+                       std::vector<bool>* valid = nullptr) const;
+  size_t ParallelUnsmear(const Executor& executor,
+                         absl::Span<const absl::Time> utc,
+                         absl::Span<TaiTime> tai,
+                         std::vector<bool>* valid = nullptr) const;
+  size_t ParallelUnsmearToGps(const Executor& executor,
+                              absl::Span<const absl::Time> utc,
+                              absl::Span<GpsTime> gps,
+                              std::vector<bool>* valid = nullptr) const;
+
+  // Versions of Unsmear(), UnsmearToGps() and Smear() on integer counts of
+  // nanoseconds, for times that are stored that way: smeared times since the
+  // Unix epoch, as from absl::ToUnixNanos(), TAI times since the TAI epoch, and
+  // GPST times since the GPS epoch.  They give identical results without the
+  // cost of converting to and from absl::Time and Duration.  Each returns
+  // false, leaving the output unchanged, if the time is not within the validity
+  // range of this leap table or the result cannot be represented.  Nanoseconds
+  // since the TAI epoch overflow in 2250.
+  bool UnsmearNanos(int64_t utc, int64_t* tai) const;
+  bool UnsmearToGpsNanos(int64_t utc, int64_t* gps) const;
+  bool SmearTaiNanos(int64_t tai, int64_t* utc) const;
+  bool SmearGpsNanos(int64_t gps, int64_t* utc) const;
+
+  // Batch conversions between smeared times and GPST weeks and times of week,
+  // for GNSS receivers.  Like the other batch versions, they remember the
+  // segment of the previous element, so sorted inputs need one lookup per
+  // segment, and set valid and return the number converted if it is not null.
+  // They use the integer arithmetic of SmearGpsNanos() and
+  // UnsmearToGpsNanos(), with identical results; smeared times are first
+  // floored to whole nanoseconds, as by absl::ToUnixNanos().  Elements that
+  // cannot be converted are output as the infinite past, or as the week
+  // std::numeric_limits<int64_t>::min().
+  size_t SmearGpsWeeks(absl::Span<const GpsWeekTime> gps,
+                       absl::Span<absl::Time> utc,
+                       std::vector<bool>* valid = nullptr) const;
+  size_t UnsmearToGpsWeeks(absl::Span<const absl::Time> utc,
+                           absl::Span<GpsWeekTime> gps,
+                           std::vector<bool>* valid = nullptr) const;
+
+  // Converts between smeared NTP timestamps, as served by Google Public NTP,
+  // and PTP timestamps, which count TAI, as needed to bridge the two
+  // protocols.  They use the integer arithmetic of UnsmearNanos() and
+  // SmearTaiNanos() on the wire formats, with NTP timestamps rounded as for
+  // NtpToUnixNanos() and UnixNanosToNtp().  Each returns false, leaving the
+  // outputs unchanged, if the time is not within the validity range of this
+  // leap table or the result cannot be represented.
+  bool NtpToPtp(uint64_t ntp, int era, PtpTimestamp* ptp) const;
+  bool PtpToNtp(PtpTimestamp ptp, uint64_t* ntp, int* era) const;
+
+  // Returns a copy of this leap table that also holds the hypothetical segments
+  // of the earliest and latest possible future leap seconds, from its
+  // expiration to the end of the month containing until, or the start of the
+  // possible smear on the last day of the month if until is before it.  Within
+  // that horizon, FutureProofSmear(), FutureProofUnsmear() and
+  // FutureProofUnsmearToGps() are then lookups like conversions within the
+  // table, rather than computing the segments for each call, with identical
+  // results.  The horizon costs about 500 bytes per month.  Logs an error and
+  // returns null if until is after the latest accepted expiration, in 9999.
+  std::unique_ptr<LeapTable> WithFutureHorizon(absl::Time until) const;
+
+  // Returns a copy of this leap table with its expiration moved to the end of
+  // the Julian day end_jdn, as when IERS Bulletin C announces no leap second,
+  // and with a leap second on the Julian day leap_jdn, positive if sign is +1
+  // or negative if -1, as when it announces one.  The new expiration must be at
+  // the end of a month and no earlier than the current one, and the leap
+  // second must span the end of a month between the two expirations.  Only
+  // the new entries and the days after the current expiration are computed;
+  // the rest of the table is not validated or derived again.  The day indexes,
+  // which make up nearly all of a table, are shared with this table: the new
+  // days are filled in after its days, in arrays with room for ten years of
+  // extensions.  The first extension of a table built otherwise, and any
+  // extension of a table that has already been extended differently, copies
+  // its days into new arrays instead.  The entries, a few dozen, are copied.
+  // The result equals the table LeapTableBuilder would build, without any
+  // future horizon.  If the extension is invalid, logs an error and returns
+  // null.  Extend() may be called concurrently with any other method,
+  // including Extend() itself, on this table or on others.
+  std::unique_ptr<LeapTable> Extend(int32_t end_jdn) const;
+  std::unique_ptr<LeapTable> Extend(int32_t end_jdn, int32_t leap_jdn,
+                                    int sign) const;
+
+  // Returns the segment of the leap table containing the time, if it is within
+  // the validity range of this leap table.  A time at the boundary of two
+  // segments is in the later one, except at the expiration.  Callers can cache
+  // the segment and convert the times within it themselves.
+  absl::optional<Segment> SegmentAt(absl::Time utc) const;
+  absl::optional<Segment> SegmentAt(TaiTime tai) const;
+
+  // Returns the segments of the leap table that convert the half-open range
+  // [begin, end), in order.  This describes the conversion of the whole range
+  // at once, such as for a query planner finding the times in another
+  // timescale that a range covers.  Times before the start of modern UTC cannot
+  // be converted and have no parts.  Past the expiration of the table, the
+  // parts are bounded by the earliest and latest possible future leap seconds.
+  // These bounds are those of FutureProofUnsmear() and FutureProofSmear().
+  // There are two parts per month there, so the end of the range must be
+  // finite; otherwise, logs an error and returns no parts.
+  std::vector<RangePart<absl::Time>> UnsmearRange(absl::Time begin,
+                                                  absl::Time end) const;
+  std::vector<RangePart<TaiTime>> SmearRange(TaiTime begin, TaiTime end) const;
+
   // Returns the latest time that can be unambiguously converted.  The earliest
   // convertible time is always ModernUtcEpoch(), 1972-01-01 00:00:00 UTC.
   absl::Time expiration() const;
 
-  // Writes the leap table data to a LeapTableProto, which can be serialized.
-  // Calling NewLeapTableFromProto() on this protobuf will result in an
-  // equivalent LeapTable.
-  void ToProto(LeapTableProto* proto) const;
+  // Writes the leap table data in a flat binary format that
+  // NewLeapTableFromFlat() and NewLeapTableFromFlatFile() use in place, without
+  // parsing or copying.  The format is the expanded table itself, so files in
+  // it are larger than serialized protobufs.  It is in the byte order of this
+  // machine, and should be generated on the machines that will use it rather
+  // than distributed more broadly.
+  void ToFlat(std::string* flat) const;
 
   // A human-readable string describing the contents of the leap table.  For
   // debugging only and subject to change.  Do not attempt to parse this.
@@ -528,20 +1255,287 @@ class LeapTable {
   bool operator!=(const LeapTable& other) const { return !(*this == other); }
 
  private:
-  explicit LeapTable(size_t size) noexcept : entries_(size) {}
+  struct FutureHorizon;
+  struct DayIndexes;
+
+  LeapTable(internal::LeapTableData data, std::shared_ptr<const void> storage,
+            std::shared_ptr<DayIndexes> day_indexes = nullptr)
+      : data_(data),
+        storage_(std::move(storage)),
+        day_indexes_(std::move(day_indexes)) {}
+
+  friend class LeapTableBuilder;
+  friend std::unique_ptr<LeapTable> NewLeapTableFromFlat(
+      absl::string_view flat);
+  friend std::unique_ptr<LeapTable> NewLeapTableFromFlatFile(
+      const std::string& path);
+  friend internal::LeapTableData internal::GetLeapTableData(
+      const LeapTable& lt);
+  friend LeapTable internal::LeapTableFromStaticData(
+      internal::LeapTableData data);
+
+  size_t size() const { return data_.smears.size(); }
+  internal::LeapTableEntry entry(size_t i) const {
+    return {absl::FromUnixSeconds(data_.utc_seconds[i]),
+            TaiEpoch() + Seconds(data_.tai_seconds[i]), data_.smears[i]};
+  }
+
+  // Returns the index of the entry at the end of the segment containing the
+  // given time, in whole seconds since the epoch of its timescale.  The time
+  // must be within the precise range of the table.
+  size_t UtcSegmentEnd(int64_t utc_seconds) const;
+  size_t TaiSegmentEnd(int64_t tai_seconds) const;
 
-  friend std::unique_ptr<LeapTable> NewLeapTableFromProto(
-      const LeapTableProto& proto);
+  // ElapsedTT(), trying the segment ending at entry *hint for a first, and
+  // setting *hint to the segment of a if it is in the precise range.
+  absl::optional<Duration> ElapsedTTNear(size_t* hint, absl::Time a,
+                                         absl::Time b) const;
+
+  // The arithmetic of UnsmearNanos() and SmearTaiNanos() within the segment
+  // ending at entry i, which must contain the time.
+  bool UnsmearNanosIn(size_t i, int64_t utc, int64_t* tai) const;
+  int64_t SmearTaiNanosIn(size_t i, int64_t tai) const;
+
+  internal::LeapTableData data_;
+
+  // Owns the arrays that data_ refers to, other than those of day_indexes_, or
+  // null if they are static.  Copies of a LeapTable share the same arrays.
+  std::shared_ptr<const void> storage_;
+
+  // The day indexes of a table built at runtime, which the tables extended from
+  // it may share, or null if storage_ owns them or they are static.
+  std::shared_ptr<DayIndexes> day_indexes_;
+
+  // The segments of WithFutureHorizon(), or null.
+  std::shared_ptr<const FutureHorizon> horizon_;
+};
 
-  // A reverse-ordered (i.e., latest-first) series of times at which the smear
-  // changed.  There will be an even number of entries: the expiration, one each
-  // for the start and end of each smear, and finally the smear epoch.
-  std::vector<internal::LeapTableEntry> entries_;
+// A LeapTable::Cursor converts a stream of times, remembering the segment of
+// the leap table between consecutive smear changes that contained the previous
+// time.  While the following times stay in the same segment, each conversion
+// is a bounds check and an interpolation, without searching the table.  This
+// makes converting sorted or nearly-sorted times, such as from logs or traces,
+// take amortized constant time.  Results are identical to those of the
+// LeapTable methods of the same names.
+//
+// Smearing and unsmearing remember their segments separately, so a Cursor may
+// be used for both directions at once.  A Cursor must not outlive its
+// LeapTable, and is not thread-safe; use one Cursor per thread.
+class LeapTable::Cursor {
+ public:
+  explicit Cursor(const LeapTable& lt) : lt_(&lt) {}
+
+  template <internal::TtBasedTimescale timescale>
+  absl::optional<absl::Time> Smear(internal::TtBasedTime<timescale> t);
+  absl::optional<TaiTime> Unsmear(absl::Time utc);
+  absl::optional<GpsTime> UnsmearToGps(absl::Time utc);
+
+ private:
+  // Sets the current segment to the one containing the time, which must be
+  // within the precise range of the table.
+  void SeekUtc(absl::Time utc);
+  void SeekTai(TaiTime tai);
+
+  const LeapTable* lt_;
+
+  // The current segments are the closed intervals from the begin times to the
+  // entries at their ends, at index utc_index_ and tai_index_ of the
+  // LeapTable.  They start empty.
+  absl::Time utc_begin_ = absl::InfiniteFuture();
+  internal::LeapTableEntry utc_end_{absl::InfinitePast(), TaiTime(), 0};
+  size_t utc_index_ = 0;
+  TaiTime tai_begin_ = TaiInfiniteFuture();
+  internal::LeapTableEntry tai_end_{absl::Time(), TaiInfinitePast(), 0};
+  size_t tai_index_ = 0;
+};
+
+// A LeapTable::Segment is a closed interval of time between consecutive
+// changes of smear, over which conversions are linear.  Outside of smears, TAI
+// and UTC advance at the same rate; within a smear, 86400 + smear() TAI seconds
+// take 86400 UTC seconds.  Conversions of times within the segment give
+// results identical to those of the LeapTable.
+//
+// Conversions are computed in whole nanoseconds back from the end of the
+// segment, so code converting times itself, such as in a GPU kernel, can
+// reproduce them exactly.  With utc, tai, utc_end and tai_end in integer
+// nanoseconds and d the nanoseconds before the end,
+//   d = utc_end - utc
+//   tai = tai_end - d - smear * (d / 86400)
+// and
+//   d = tai_end - tai
+//   utc = utc_end - d + (smear > 0 ? d / 86401 : smear < 0 ? -(d / 86399) : 0)
+// in truncating integer division.  Fractions of nanoseconds are carried
+// through unscaled.
+class LeapTable::Segment {
+ public:
+  // For use by LeapTable only.  The segment is from the time in begin to the
+  // time and smear in end.
+  Segment(internal::LeapTableEntry begin, internal::LeapTableEntry end)
+      : begin_(begin), end_(end) {}
+
+  absl::Time utc_begin() const { return begin_.utc; }
+  absl::Time utc_end() const { return end_.utc; }
+  TaiTime tai_begin() const { return begin_.tai; }
+  TaiTime tai_end() const { return end_.tai; }
+
+  // Returns 0 outside of smears, 1 within the smear of a positive leap second,
+  // and -1 within the smear of a negative leap second.
+  int smear() const { return end_.smear; }
+
+  // Returns TAI - UTC at the end of the segment, such as 37 seconds in 2017.
+  Duration offset() const;
+
+  // Converts a time within the segment.
+  TaiTime Convert(absl::Time utc) const;
+  absl::Time Convert(TaiTime tai) const;
+
+  bool operator==(const Segment& other) const {
+    return begin_.utc == other.begin_.utc && begin_.tai == other.begin_.tai &&
+           end_.utc == other.end_.utc && end_.tai == other.end_.tai &&
+           end_.smear == other.end_.smear;
+  }
+  bool operator!=(const Segment& other) const { return !(*this == other); }
+
+ private:
+  internal::LeapTableEntry begin_;
+  internal::LeapTableEntry end_;
+};
+
+// A LeapTable::RangePart is the part of a range from LeapTable::UnsmearRange()
+// or LeapTable::SmearRange() within one segment, as the half-open interval
+// [begin, end) in the timescale converted from.  Converting a time in the part
+// with the earliest and latest segments gives its earliest and latest possible
+// conversions.  Within the validity range of the leap table they are the same
+// segment.
+template <typename Time>
+struct LeapTable::RangePart {
+  Time begin;
+  Time end;
+  Segment earliest;
+  Segment latest;
+};
+
+// An InlineLeapTable is a copy of the precise conversions of a LeapTable in a
+// fixed-capacity value type, with no heap storage or pointers.  It can be
+// built on the stack, embedded in per-thread or per-shard structures, or
+// copied with memcpy into caller-provided memory aligned to 64 bytes, since it
+// is trivially copyable.  Results are identical to those of the LeapTable
+// methods of the same names, but times past the expiration are not convertible
+// at all.
+//
+// Each entry packs the UTC and TAI boundaries and the smear into 16 aligned
+// bytes, so a table of today's size fits in 15 cache lines.  The size and the
+// entries of the latest segment share the first cache line, so converting a
+// recent time touches only that line even when the cache is cold; older times
+// take a binary search of the entries.
+class alignas(64) InlineLeapTable {
+ public:
+  // The number of entries an InlineLeapTable can hold: the expiration, the
+  // smear epoch, and the start and end of each of up to 62 leap seconds.  With
+  // the size, they fit in 2 KiB.
+  static constexpr size_t kCapacity = 126;
+
+  // Constructs an empty table, which converts no times.
+  InlineLeapTable() = default;
+
+  // Replaces the contents of this table with those of lt.  Logs an error and
+  // returns false, leaving this table unchanged, if lt has more than
+  // kCapacity entries.
+  bool Assign(const LeapTable& lt);
+
+  // As for LeapTable.
+  template <internal::TtBasedTimescale timescale>
+  absl::optional<absl::Time> Smear(internal::TtBasedTime<timescale> t) const;
+  absl::optional<TaiTime> Unsmear(absl::Time utc) const;
+  absl::optional<GpsTime> UnsmearToGps(absl::Time utc) const;
+
+  // Returns the latest time that can be converted, or the infinite past if
+  // the table is empty.
+  absl::Time expiration() const;
+
+ private:
+  struct alignas(16) Entry {
+    int64_t utc_seconds;         // Since the Unix epoch.
+    int32_t tai_offset_seconds;  // TAI seconds since the TAI epoch, less UTC.
+    int32_t smear;               // See internal::LeapTableEntry::smear.
+
+    int64_t tai_seconds() const { return utc_seconds + tai_offset_seconds; }
+  };
+
+  internal::LeapTableEntry entry(size_t i) const {
+    return {absl::FromUnixSeconds(entries_[i].utc_seconds),
+            TaiEpoch() + Seconds(entries_[i].tai_seconds()),
+            entries_[i].smear};
+  }
+
+  // As for LeapTable.
+  size_t UtcSegmentEnd(int64_t utc_seconds) const;
+  size_t TaiSegmentEnd(int64_t tai_seconds) const;
+
+  // The entries, latest-first as in internal::LeapTableData.  Only the first
+  // size_ are initialized.
+  uint32_t size_ = 0;
+  Entry entries_[kCapacity];
+};
+
+// A LeapTableBuilder constructs a LeapTable from its leap seconds and
+// expiration, as Julian Day Numbers with the same meanings as the fields of
+// LeapTableProto.  It does not depend on protobuf; NewLeapTableFromProto() in
+// unsmear/unsmear_proto.h uses it.
+//
+//   LeapTableBuilder builder;
+//   builder.AddPositiveLeap(2457754);  // 2016-12-31
+//   builder.SetEndJdn(2460856);        // 2025-06-29
+//   std::unique_ptr<LeapTable> lt = builder.Build();
+class LeapTableBuilder {
+ public:
+  // Starts with no leap seconds and no expiration.
+  LeapTableBuilder() = default;
+
+  // Starts with the leap seconds and expiration of lt, in increasing order.
+  explicit LeapTableBuilder(const LeapTable& lt);
+
+  // Adds a leap second on the Julian day jdn, whose 24-hour noon-to-noon
+  // interval must span the end of a month.  Positive leap seconds are inserted
+  // into UTC, and negative ones deleted.
+  void AddPositiveLeap(int32_t jdn) { positive_leaps_.push_back(jdn); }
+  void AddNegativeLeap(int32_t jdn) { negative_leaps_.push_back(jdn); }
+
+  // Sets the last full day of validity of the table, which must be the last
+  // full day of a calendar month.  This is required.
+  void SetEndJdn(int32_t jdn) { end_jdn_ = jdn; }
+
+  const std::vector<int32_t>& positive_leaps() const { return positive_leaps_; }
+  const std::vector<int32_t>& negative_leaps() const { return negative_leaps_; }
+  int32_t end_jdn() const { return end_jdn_; }
+
+  // Constructs a LeapTable, if the leap seconds and expiration are valid.
+  // Otherwise, logs an error and returns null.
+  std::unique_ptr<LeapTable> Build() const;
+
+ private:
+  std::vector<int32_t> positive_leaps_;
+  std::vector<int32_t> negative_leaps_;
+  int32_t end_jdn_ = 0;
 };
 
-// Constructs a LeapTable from a protobuf with the leap second data, if it is
-// valid.
-std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto);
+// Constructs a LeapTable that refers directly to data written by
+// LeapTable::ToFlat(), if it is valid and its checksum matches.  The data must
+// be 8-byte aligned, and must outlive the LeapTable and all copies of it.
+std::unique_ptr<LeapTable> NewLeapTableFromFlat(absl::string_view flat);
+
+// Maps a file written by LeapTable::ToFlat() into memory, and constructs a
+// LeapTable that refers directly to it, if it is valid.  Processes mapping the
+// same file share one copy of it in the page cache.  The file is unmapped when
+// the LeapTable and all copies of it are destroyed, and must not be modified
+// while mapped; replace it by renaming a new file over it instead.
+std::unique_ptr<LeapTable> NewLeapTableFromFlatFile(const std::string& path);
+
+// Parses a smeared time in the default format, as output by
+// FormatTime(absl::Time), and unsmears it.  Returns an empty optional if the
+// string cannot be parsed, or if the time is not within the validity range of
+// the leap table.
+absl::optional<TaiTime> UnsmearString(const LeapTable& lt, absl::string_view s);
 
 }  // namespace unsmear
 
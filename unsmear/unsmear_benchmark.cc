@@ -0,0 +1,888 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for conversions, leap table construction, and formatting, using
+// the current leap table in leap_table/leap_table.textpb.
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "google/protobuf/text_format.h"
+#include "unsmear/clock.h"
+#include "unsmear/shared_leap_table.h"
+#include "unsmear/time_merger.h"
+#include "unsmear/unsmear.h"
+#include "unsmear/unsmear_proto.h"
+
+namespace unsmear {
+namespace {
+
+// Each benchmark cycles through this many precomputed inputs, which is enough
+// to defeat branch prediction on random inputs while fitting in L1 cache.
+constexpr int kNumInputs = 1024;
+
+const LeapTableProto& CurrentLeapTableProto() {
+  static const auto* pb = [] {
+    std::ifstream input("leap_table/leap_table.textpb");
+    std::stringstream contents;
+    contents << input.rdbuf();
+    auto* pb = new LeapTableProto;
+    if (!google::protobuf::TextFormat::ParseFromString(contents.str(), pb)) {
+      std::cerr << "Couldn't parse leap_table/leap_table.textpb\n";
+      std::abort();
+    }
+    return pb;
+  }();
+  return *pb;
+}
+
+const LeapTable& CurrentLeapTable() {
+  static const auto* lt = [] {
+    auto lt = NewLeapTableFromProto(CurrentLeapTableProto());
+    if (lt == nullptr) {
+      std::cerr << "Couldn't construct leap table\n";
+      std::abort();
+    }
+    return lt.release();
+  }();
+  return *lt;
+}
+
+enum class Inputs {
+  // Uniformly distributed over the validity range of the leap table.
+  kRandom,
+  // The same, in increasing order.
+  kSorted,
+  // Within the smear of the 2016-12-31 leap second.
+  kSmearDay,
+  // Within the first year of modern UTC, at the end of the leap table.
+  kNear1972,
+  // Within five years after the expiration of the leap table.
+  kPastExpiration,
+};
+
+// Returns kNumInputs smeared times of the given kind.
+std::vector<absl::Time> UtcInputs(Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  absl::Time begin = ModernUtcEpoch();
+  absl::Time end = lt.expiration();
+  switch (kind) {
+    case Inputs::kRandom:
+    case Inputs::kSorted:
+      break;
+    case Inputs::kSmearDay:
+      begin = absl::FromDateTime(2016, 12, 31, 12, 0, 0, absl::UTCTimeZone());
+      end = begin + absl::Hours(24);
+      break;
+    case Inputs::kNear1972:
+      end = begin + 365 * absl::Hours(24);
+      break;
+    case Inputs::kPastExpiration:
+      begin = lt.expiration();
+      end = begin + 5 * 365 * absl::Hours(24);
+      break;
+  }
+
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<int64_t> dist(
+      0, absl::ToInt64Nanoseconds(end - begin));
+  std::vector<absl::Time> v(kNumInputs);
+  for (auto& t : v) {
+    t = begin + absl::Nanoseconds(dist(gen));
+  }
+  if (kind == Inputs::kSorted) {
+    std::sort(v.begin(), v.end());
+  }
+  return v;
+}
+
+// Returns the unsmeared equivalents of UtcInputs(kind).  Past the expiration
+// of the leap table, this is the earliest possible time.
+std::vector<TaiTime> TaiInputs(Inputs kind) {
+  std::vector<TaiTime> v;
+  for (absl::Time t : UtcInputs(kind)) {
+    v.push_back(CurrentLeapTable().FutureProofUnsmear(t).first);
+  }
+  return v;
+}
+
+std::vector<GpsTime> GpsInputs(Inputs kind) {
+  std::vector<GpsTime> v;
+  for (TaiTime t : TaiInputs(kind)) {
+    v.push_back(ToGpsTime(t));
+  }
+  return v;
+}
+
+void BM_Unsmear(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Unsmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_Unsmear, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_Unsmear, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_Unsmear, smear_day, Inputs::kSmearDay);
+BENCHMARK_CAPTURE(BM_Unsmear, near_1972, Inputs::kNear1972);
+
+void BM_UnsmearUnchecked(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.UnsmearUnchecked(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_UnsmearUnchecked, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_UnsmearUnchecked, smear_day, Inputs::kSmearDay);
+
+void BM_SmearTaiUnchecked(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = TaiInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.SmearUnchecked(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_SmearTaiUnchecked, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SmearTaiUnchecked, smear_day, Inputs::kSmearDay);
+
+// Pairs of start and end times 10 ms apart, as from latency measurements.
+void BM_ElapsedTTTwoUnsmears(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    const absl::Time t = inputs[i++ % kNumInputs];
+    benchmark::DoNotOptimize(*lt.Unsmear(t + absl::Milliseconds(10)) -
+                             *lt.Unsmear(t));
+  }
+}
+BENCHMARK_CAPTURE(BM_ElapsedTTTwoUnsmears, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_ElapsedTTTwoUnsmears, smear_day, Inputs::kSmearDay);
+
+void BM_ElapsedTT(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    const absl::Time t = inputs[i++ % kNumInputs];
+    benchmark::DoNotOptimize(lt.ElapsedTT(t, t + absl::Milliseconds(10)));
+  }
+}
+BENCHMARK_CAPTURE(BM_ElapsedTT, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_ElapsedTT, smear_day, Inputs::kSmearDay);
+
+void BM_ElapsedTTBatch(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto starts = UtcInputs(kind);
+  std::vector<absl::Time> ends;
+  for (absl::Time t : starts) {
+    ends.push_back(t + absl::Milliseconds(10));
+  }
+  std::vector<Duration> elapsed(starts.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        lt.ElapsedTT(starts, ends, absl::MakeSpan(elapsed)));
+  }
+  state.SetItemsProcessed(state.iterations() * starts.size());
+}
+BENCHMARK_CAPTURE(BM_ElapsedTTBatch, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_ElapsedTTBatch, sorted, Inputs::kSorted);
+
+// Merges sorted inputs in three timescales, interleaved.
+void BM_TimeMerger(benchmark::State& state) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto utc = UtcInputs(Inputs::kSorted);
+  const auto tai = TaiInputs(Inputs::kSorted);
+  std::vector<GpsTime> gps;
+  for (TaiTime t : tai) {
+    gps.push_back(ToGpsTime(t + Seconds(1)));
+  }
+  for (auto _ : state) {
+    TimeMerger merger(lt);
+    merger.AddInput(utc);
+    merger.AddInput(tai);
+    merger.AddInput(gps);
+    TimeMerger::Element e;
+    while (merger.Next(&e)) {
+      benchmark::DoNotOptimize(e);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 3 * kNumInputs);
+}
+BENCHMARK(BM_TimeMerger);
+
+// The same as BM_TimeMerger, by converting to TAI and sorting.
+void BM_TimeMergerBySorting(benchmark::State& state) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto utc = UtcInputs(Inputs::kSorted);
+  const auto tai = TaiInputs(Inputs::kSorted);
+  std::vector<GpsTime> gps;
+  for (TaiTime t : tai) {
+    gps.push_back(ToGpsTime(t + Seconds(1)));
+  }
+  for (auto _ : state) {
+    std::vector<TaiTime> merged(utc.size());
+    lt.Unsmear(utc, absl::MakeSpan(merged));
+    merged.insert(merged.end(), tai.begin(), tai.end());
+    for (GpsTime t : gps) {
+      merged.push_back(ToTaiTime(t));
+    }
+    std::sort(merged.begin(), merged.end());
+    benchmark::DoNotOptimize(merged.data());
+  }
+  state.SetItemsProcessed(state.iterations() * 3 * kNumInputs);
+}
+BENCHMARK(BM_TimeMergerBySorting);
+
+void BM_UnsmearNanos(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  std::vector<int64_t> inputs;
+  for (absl::Time t : UtcInputs(kind)) {
+    inputs.push_back(absl::ToUnixNanos(t));
+  }
+  size_t i = 0;
+  int64_t tai;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.UnsmearNanos(inputs[i++ % kNumInputs], &tai));
+    benchmark::DoNotOptimize(tai);
+  }
+}
+BENCHMARK_CAPTURE(BM_UnsmearNanos, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_UnsmearNanos, smear_day, Inputs::kSmearDay);
+
+void BM_UnsmearToGps(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.UnsmearToGps(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_UnsmearToGps, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_UnsmearToGps, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_UnsmearToGps, smear_day, Inputs::kSmearDay);
+
+void BM_SmearTai(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = TaiInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Smear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_SmearTai, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SmearTai, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_SmearTai, smear_day, Inputs::kSmearDay);
+BENCHMARK_CAPTURE(BM_SmearTai, near_1972, Inputs::kNear1972);
+
+void BM_SmearTaiNanos(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  std::vector<int64_t> inputs;
+  for (TaiTime t : TaiInputs(kind)) {
+    inputs.push_back(ToInt64Nanoseconds(t - TaiEpoch()));
+  }
+  size_t i = 0;
+  int64_t utc;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.SmearTaiNanos(inputs[i++ % kNumInputs], &utc));
+    benchmark::DoNotOptimize(utc);
+  }
+}
+BENCHMARK_CAPTURE(BM_SmearTaiNanos, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SmearTaiNanos, smear_day, Inputs::kSmearDay);
+
+void BM_SmearGps(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = GpsInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Smear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_SmearGps, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SmearGps, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_SmearGps, smear_day, Inputs::kSmearDay);
+
+void BM_FutureProofUnsmear(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.FutureProofUnsmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_FutureProofUnsmear, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_FutureProofUnsmear, past_expiration,
+                  Inputs::kPastExpiration);
+
+// The current leap table with a horizon covering kPastExpiration inputs.
+const LeapTable& HorizonLeapTable() {
+  static const LeapTable* lt =
+      CurrentLeapTable()
+          .WithFutureHorizon(CurrentLeapTable().expiration() +
+                             5 * 365 * absl::Hours(24))
+          .release();
+  return *lt;
+}
+
+void BM_FutureProofUnsmearHorizon(benchmark::State& state) {
+  const LeapTable& lt = HorizonLeapTable();
+  const auto inputs = UtcInputs(Inputs::kPastExpiration);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.FutureProofUnsmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_FutureProofUnsmearHorizon);
+
+void BM_FutureProofUnsmearToGps(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        lt.FutureProofUnsmearToGps(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_FutureProofUnsmearToGps, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_FutureProofUnsmearToGps, past_expiration,
+                  Inputs::kPastExpiration);
+
+void BM_FutureProofSmear(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = TaiInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.FutureProofSmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_FutureProofSmear, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_FutureProofSmear, past_expiration,
+                  Inputs::kPastExpiration);
+
+void BM_FutureProofSmearHorizon(benchmark::State& state) {
+  const LeapTable& lt = HorizonLeapTable();
+  const auto inputs = TaiInputs(Inputs::kPastExpiration);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.FutureProofSmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_FutureProofSmearHorizon);
+
+void BM_CursorUnsmear(benchmark::State& state, Inputs kind) {
+  LeapTable::Cursor cursor(CurrentLeapTable());
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cursor.Unsmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_CursorUnsmear, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_CursorUnsmear, sorted, Inputs::kSorted);
+
+const InlineLeapTable& CurrentInlineLeapTable() {
+  static const auto* table = [] {
+    auto* table = new InlineLeapTable;
+    if (!table->Assign(CurrentLeapTable())) {
+      std::abort();
+    }
+    return table;
+  }();
+  return *table;
+}
+
+void BM_InlineUnsmear(benchmark::State& state, Inputs kind) {
+  const InlineLeapTable& table = CurrentInlineLeapTable();
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table.Unsmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_InlineUnsmear, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_InlineUnsmear, smear_day, Inputs::kSmearDay);
+BENCHMARK_CAPTURE(BM_InlineUnsmear, near_1972, Inputs::kNear1972);
+
+void BM_InlineSmearTai(benchmark::State& state, Inputs kind) {
+  const InlineLeapTable& table = CurrentInlineLeapTable();
+  const auto inputs = TaiInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table.Smear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_InlineSmearTai, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_InlineSmearTai, smear_day, Inputs::kSmearDay);
+
+void BM_SharedUnsmear(benchmark::State& state, Inputs kind) {
+  const std::string name = absl::StrCat("/unsmear_benchmark_", getpid());
+  auto publisher = SharedLeapTablePublisher::Create(name);
+  if (publisher == nullptr || !publisher->Publish(CurrentLeapTable())) {
+    std::abort();
+  }
+  auto reader = SharedLeapTableReader::Open(name);
+  shm_unlink(name.c_str());
+  if (reader == nullptr) {
+    std::abort();
+  }
+  const auto inputs = UtcInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(reader->Unsmear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_SharedUnsmear, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SharedUnsmear, smear_day, Inputs::kSmearDay);
+
+void BM_CursorSmearTai(benchmark::State& state, Inputs kind) {
+  LeapTable::Cursor cursor(CurrentLeapTable());
+  const auto inputs = TaiInputs(kind);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cursor.Smear(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK_CAPTURE(BM_CursorSmearTai, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_CursorSmearTai, sorted, Inputs::kSorted);
+
+// The current leap table, extended to expire long after the current time, so
+// that the clock benchmarks convert the current time precisely.
+const LeapTable& ExtendedLeapTable() {
+  static const auto* lt = [] {
+    LeapTableProto pb = CurrentLeapTableProto();
+    pb.set_end_jdn(2488068);  // 2099-12-30 12:00:00 UTC
+    return NewLeapTableFromProto(pb).release();
+  }();
+  return *lt;
+}
+
+void BM_AbslNow(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(absl::Now());
+  }
+}
+BENCHMARK(BM_AbslNow);
+
+void BM_UnsmearNow(benchmark::State& state) {
+  const LeapTable& lt = ExtendedLeapTable();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Unsmear(absl::Now()));
+  }
+}
+BENCHMARK(BM_UnsmearNow);
+
+void BM_ClockNowTai(benchmark::State& state) {
+  // Threads share a clock, as they would in a process.
+  static const Clock* clock = new Clock(ExtendedLeapTable());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(clock->NowTai());
+  }
+}
+BENCHMARK(BM_ClockNowTai)->ThreadRange(1, 4);
+
+void BM_ClockNowTaiInterval(benchmark::State& state) {
+  Clock clock(ExtendedLeapTable());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(clock.NowTaiInterval());
+  }
+}
+BENCHMARK(BM_ClockNowTaiInterval);
+
+void BM_UnsmearRange(benchmark::State& state) {
+  // The whole validity range of the table, and five years past it.
+  const LeapTable& lt = CurrentLeapTable();
+  const absl::Time end = lt.expiration() + absl::Hours(5 * 365 * 24);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.UnsmearRange(ModernUtcEpoch(), end));
+  }
+}
+BENCHMARK(BM_UnsmearRange);
+
+void BM_UnsmearBatch(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  std::vector<TaiTime> outputs(inputs.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Unsmear(inputs, absl::MakeSpan(outputs)));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_UnsmearBatch, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_UnsmearBatch, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_UnsmearBatch, smear_day, Inputs::kSmearDay);
+
+void BM_SmearTaiBatch(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = TaiInputs(kind);
+  std::vector<absl::Time> outputs(inputs.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Smear(inputs, absl::MakeSpan(outputs)));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_SmearTaiBatch, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SmearTaiBatch, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_SmearTaiBatch, smear_day, Inputs::kSmearDay);
+
+std::vector<GpsWeekTime> GpsWeekInputs(Inputs kind) {
+  std::vector<GpsWeekTime> v;
+  for (GpsTime t : GpsInputs(kind)) {
+    v.push_back(ToGpsWeekTime(t));
+  }
+  return v;
+}
+
+void BM_SmearGpsWeeksGeneric(benchmark::State& state, Inputs kind) {
+  // The chain of generic conversions that SmearGpsWeeks() replaces.
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = GpsWeekInputs(kind);
+  std::vector<absl::Time> outputs(inputs.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      outputs[i] = lt.Smear(FromGpsWeekTime(inputs[i]))
+                       .value_or(absl::InfinitePast());
+    }
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_SmearGpsWeeksGeneric, sorted, Inputs::kSorted);
+
+void BM_SmearGpsWeeks(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = GpsWeekInputs(kind);
+  std::vector<absl::Time> outputs(inputs.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.SmearGpsWeeks(inputs, absl::MakeSpan(outputs)));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_SmearGpsWeeks, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_SmearGpsWeeks, sorted, Inputs::kSorted);
+BENCHMARK_CAPTURE(BM_SmearGpsWeeks, smear_day, Inputs::kSmearDay);
+
+void BM_UnsmearToGpsWeeks(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = UtcInputs(kind);
+  std::vector<GpsWeekTime> outputs(inputs.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        lt.UnsmearToGpsWeeks(inputs, absl::MakeSpan(outputs)));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_UnsmearToGpsWeeks, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_UnsmearToGpsWeeks, sorted, Inputs::kSorted);
+
+std::vector<uint64_t> NtpInputs(Inputs kind) {
+  std::vector<uint64_t> v;
+  for (absl::Time t : UtcInputs(kind)) {
+    uint64_t ntp;
+    int era;
+    UnixNanosToNtp(absl::ToUnixNanos(t), &ntp, &era);
+    v.push_back(ntp);
+  }
+  return v;
+}
+
+void BM_NtpToPtpGeneric(benchmark::State& state, Inputs kind) {
+  // The same conversion through absl::Time and TaiTime.
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = NtpInputs(kind);
+  std::vector<PtpTimestamp> outputs(inputs.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      const absl::Time utc =
+          absl::UnixEpoch() - absl::Seconds(internal::kNtpUnixOffsetSeconds) +
+          absl::Seconds(inputs[i] >> 32) +
+          absl::Nanoseconds(((inputs[i] & 0xffffffff) * 1000000000) >> 32);
+      const auto tai = lt.Unsmear(utc);
+      if (!tai.has_value()) continue;
+      const absl::Duration d = internal::GetRep(*tai - TaiEpoch()) -
+                               absl::Seconds(internal::kTaiPtpOffsetSeconds);
+      absl::Duration rem;
+      outputs[i].seconds = absl::IDivDuration(d, absl::Seconds(1), &rem);
+      outputs[i].nanoseconds = absl::ToInt64Nanoseconds(rem);
+    }
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_NtpToPtpGeneric, sorted, Inputs::kSorted);
+
+void BM_NtpToPtp(benchmark::State& state, Inputs kind) {
+  const LeapTable& lt = CurrentLeapTable();
+  const auto inputs = NtpInputs(kind);
+  std::vector<PtpTimestamp> outputs(inputs.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      lt.NtpToPtp(inputs[i], 0, &outputs[i]);
+    }
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_NtpToPtp, random, Inputs::kRandom);
+BENCHMARK_CAPTURE(BM_NtpToPtp, sorted, Inputs::kSorted);
+
+void BM_ParallelUnsmear(benchmark::State& state) {
+  // Sorted inputs repeated to millions of elements, converted on state.range(0)
+  // threads started for each batch.
+  const LeapTable& lt = CurrentLeapTable();
+  const auto sorted = UtcInputs(Inputs::kSorted);
+  std::vector<absl::Time> inputs;
+  for (int i = 0; i < 4096; ++i) {
+    inputs.insert(inputs.end(), sorted.begin(), sorted.end());
+  }
+  std::vector<TaiTime> outputs(inputs.size());
+  const size_t num_threads = state.range(0);
+  const LeapTable::Executor executor =
+      [num_threads](size_t n, const std::function<void(size_t)>& task) {
+        std::vector<std::thread> threads;
+        for (size_t k = 0; k < num_threads; ++k) {
+          threads.emplace_back([n, &task, k, num_threads] {
+            for (size_t i = k; i < n; i += num_threads) task(i);
+          });
+        }
+        for (auto& thread : threads) {
+          thread.join();
+        }
+      };
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        lt.ParallelUnsmear(executor, inputs, absl::MakeSpan(outputs)));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK(BM_ParallelUnsmear)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+void BM_NewLeapTableFromProto(benchmark::State& state) {
+  const LeapTableProto& pb = CurrentLeapTableProto();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(NewLeapTableFromProto(pb));
+  }
+}
+BENCHMARK(BM_NewLeapTableFromProto);
+
+// Extends the table from June to December, as after a Bulletin C announcing no
+// leap second, compared with building the extended table from a protobuf.
+void BM_LeapTableExtend(benchmark::State& state) {
+  const LeapTable& lt = CurrentLeapTable();
+  const int32_t end_jdn = CurrentLeapTableProto().end_jdn() + 184;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lt.Extend(end_jdn));
+  }
+}
+BENCHMARK(BM_LeapTableExtend);
+
+// Extends a table every six months, as after each Bulletin C announcing no leap
+// second.  Each extension fills in its days after those of the table before,
+// in place, other than for a copy of the day indexes every ten years.  The
+// table is started over after a century.
+void BM_LeapTableExtendEverySixMonths(benchmark::State& state) {
+  const int32_t start_jdn = CurrentLeapTableProto().end_jdn();
+  const absl::CivilMonth start_month(
+      absl::ToCivilDay(JdnToTime(start_jdn + 1), absl::UTCTimeZone()));
+  std::unique_ptr<LeapTable> lt;
+  absl::CivilMonth month;
+  for (auto _ : state) {
+    if (lt == nullptr || month - start_month >= 1200) {
+      state.PauseTiming();
+      lt = CurrentLeapTable().Extend(start_jdn);
+      month = start_month;
+      state.ResumeTiming();
+    }
+    month += 6;
+    // The Julian day before the last day of the month, from noon to noon.
+    const absl::CivilDay last_day = absl::CivilDay(month + 1) - 1;
+    lt = lt->Extend(last_day - absl::CivilDay(1970, 1, 1) + 2440587);
+  }
+}
+BENCHMARK(BM_LeapTableExtendEverySixMonths);
+
+void BM_NewLeapTableFromExtendedProto(benchmark::State& state) {
+  LeapTableProto pb = CurrentLeapTableProto();
+  pb.set_end_jdn(pb.end_jdn() + 184);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(NewLeapTableFromProto(pb));
+  }
+}
+BENCHMARK(BM_NewLeapTableFromExtendedProto);
+
+void BM_NewLeapTableFromFlat(benchmark::State& state) {
+  std::string flat;
+  CurrentLeapTable().ToFlat(&flat);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(NewLeapTableFromFlat(flat));
+  }
+}
+BENCHMARK(BM_NewLeapTableFromFlat);
+
+void BM_FormatTimeTai(benchmark::State& state) {
+  const auto inputs = TaiInputs(Inputs::kRandom);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FormatTime(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_FormatTimeTai);
+
+void BM_FormatTimeTaiWithFormat(benchmark::State& state) {
+  const auto inputs = TaiInputs(Inputs::kRandom);
+  const std::string format = "%Y-%m-%dT%H:%M:%E6S %Z";
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FormatTime(format, inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_FormatTimeTaiWithFormat);
+
+void BM_FormatTimeUtc(benchmark::State& state) {
+  const auto inputs = UtcInputs(Inputs::kRandom);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(::unsmear::FormatTime(inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_FormatTimeUtc);
+
+void BM_FormatTimeUtcWithFormat(benchmark::State& state) {
+  const auto inputs = UtcInputs(Inputs::kRandom);
+  const std::string format = "%Y-%m-%dT%H:%M:%E6S %Z";
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        ::unsmear::FormatTime(format, inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_FormatTimeUtcWithFormat);
+
+void BM_TimeFormatToTai(benchmark::State& state) {
+  const auto inputs = TaiInputs(Inputs::kRandom);
+  const TimeFormat format;
+  char buf[TimeFormat::kMaxDefaultSize];
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        format.FormatTo(inputs[i++ % kNumInputs], buf, sizeof(buf)));
+  }
+}
+BENCHMARK(BM_TimeFormatToTai);
+
+void BM_TimeFormatAppendTai(benchmark::State& state) {
+  const auto inputs = TaiInputs(Inputs::kRandom);
+  const TimeFormat format;
+  std::string s;
+  size_t i = 0;
+  for (auto _ : state) {
+    s.clear();
+    format.AppendTo(inputs[i++ % kNumInputs], &s);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_TimeFormatAppendTai);
+
+void BM_TimeFormatToTaiWithFormat(benchmark::State& state) {
+  const auto inputs = TaiInputs(Inputs::kRandom);
+  const TimeFormat format("%Y-%m-%dT%H:%M:%E6S %Z");
+  char buf[TimeFormat::kMaxDefaultSize];
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        format.FormatTo(inputs[i++ % kNumInputs], buf, sizeof(buf)));
+  }
+}
+BENCHMARK(BM_TimeFormatToTaiWithFormat);
+
+void BM_FixedWidthFormatAllTai(benchmark::State& state, Inputs kind) {
+  const auto inputs = TaiInputs(kind);
+  const FixedWidthTimeFormat format(state.range(0));
+  const size_t stride = format.width(TaiTime()) + 1;
+  std::string buf(inputs.size() * stride, '\n');
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(format.FormatAll(inputs, &buf[0], stride));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK_CAPTURE(BM_FixedWidthFormatAllTai, random, Inputs::kRandom)
+    ->Arg(0)
+    ->Arg(9);
+BENCHMARK_CAPTURE(BM_FixedWidthFormatAllTai, sorted, Inputs::kSorted)
+    ->Arg(0)
+    ->Arg(9);
+BENCHMARK_CAPTURE(BM_FixedWidthFormatAllTai, smear_day, Inputs::kSmearDay)
+    ->Arg(9);
+
+std::vector<std::string> FormattedTai(const std::string& format) {
+  std::vector<std::string> strings;
+  for (TaiTime t : TaiInputs(Inputs::kRandom)) {
+    strings.push_back(FormatTime(format, t));
+  }
+  return strings;
+}
+
+void BM_ParseTimeTai(benchmark::State& state) {
+  const auto inputs = FormattedTai("%Y-%m-%d %H:%M:%E*S %Z");
+  TaiTime t;
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ParseTime(inputs[i++ % kNumInputs], &t, nullptr));
+  }
+}
+BENCHMARK(BM_ParseTimeTai);
+
+void BM_ParseTimeTaiWithFormat(benchmark::State& state) {
+  const std::string format = "%Y-%m-%dT%H:%M:%E6S %Z";
+  const auto inputs = FormattedTai(format);
+  TaiTime t;
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        ParseTime(format, inputs[i++ % kNumInputs], &t, nullptr));
+  }
+}
+BENCHMARK(BM_ParseTimeTaiWithFormat);
+
+void BM_UnsmearString(benchmark::State& state) {
+  std::vector<std::string> inputs;
+  for (absl::Time t : UtcInputs(Inputs::kRandom)) {
+    inputs.push_back(::unsmear::FormatTime(t));
+  }
+  const LeapTable& lt = CurrentLeapTable();
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(UnsmearString(lt, inputs[i++ % kNumInputs]));
+  }
+}
+BENCHMARK(BM_UnsmearString);
+
+}  // namespace
+}  // namespace unsmear
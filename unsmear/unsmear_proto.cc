@@ -0,0 +1,43 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "unsmear/unsmear_proto.h"
+
+namespace unsmear {
+
+std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto) {
+  LeapTableBuilder builder;
+  for (int32_t jdn : proto.positive_leaps()) {
+    builder.AddPositiveLeap(jdn);
+  }
+  for (int32_t jdn : proto.negative_leaps()) {
+    builder.AddNegativeLeap(jdn);
+  }
+  builder.SetEndJdn(proto.end_jdn());
+  return builder.Build();
+}
+
+void LeapTableToProto(const LeapTable& lt, LeapTableProto* proto) {
+  LeapTableBuilder builder(lt);
+  proto->Clear();
+  for (int32_t jdn : builder.positive_leaps()) {
+    proto->add_positive_leaps(jdn);
+  }
+  for (int32_t jdn : builder.negative_leaps()) {
+    proto->add_negative_leaps(jdn);
+  }
+  proto->set_end_jdn(builder.end_jdn());
+}
+
+}  // namespace unsmear
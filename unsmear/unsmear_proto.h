@@ -0,0 +1,38 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UNSMEAR_UNSMEAR_PROTO_H
+#define UNSMEAR_UNSMEAR_PROTO_H
+
+#include <memory>
+#include "unsmear/leap_table.pb.h"
+#include "unsmear/unsmear.h"
+
+namespace unsmear {
+
+// Conversions between LeapTable and LeapTableProto, in a separate library so
+// that the core conversions do not depend on protobuf.
+
+// Constructs a LeapTable from a protobuf with the leap second data, if it is
+// valid.  Otherwise, logs an error and returns null.
+std::unique_ptr<LeapTable> NewLeapTableFromProto(const LeapTableProto& proto);
+
+// Writes the leap table data to a LeapTableProto, which can be serialized.
+// Calling NewLeapTableFromProto() on this protobuf will result in an
+// equivalent LeapTable.
+void LeapTableToProto(const LeapTable& lt, LeapTableProto* proto);
+
+}  // namespace unsmear
+
+#endif  // UNSMEAR_UNSMEAR_PROTO_H